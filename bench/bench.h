@@ -0,0 +1,78 @@
+/**
+ * @file bench.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 性能测试的公共函数。每个测试提供一个入口，由bench_main.c按名称调用，
+ *        只在打开BLIVE_QUEUE_BENCH时编译，不属于blive_queue本身。
+ * @version 0.1
+ * @date 2023-03-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __BENCH_BENCH_H__
+#define __BENCH_BENCH_H__
+
+#include <stdio.h>
+#include <time.h>
+#include "utils.h"
+
+
+#define NS_PER_SEC      1000000000ULL
+
+/**
+ * @brief 单调时钟，单位ns
+ */
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec     now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * NS_PER_SEC + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief xorshift64伪随机数，每个线程使用自己的状态，不能为0
+ */
+static inline uint64_t bench_rand(uint64_t* state)
+{
+    uint64_t    x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief 防止编译器优化掉结果未被使用的计算
+ */
+static inline void bench_sink(const void* value)
+{
+    __asm__ __volatile__("" : : "r"(value) : "memory");
+}
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 并发优先级队列与加锁的pri_queue在1、4、16个生产者时的对比
+ */
+int bench_cpri_queue(void);
+
+/**
+ * @brief PRI_QUEUE_DEFINE生成的d叉堆与通用pri_queue在1k、100k、1M个元素时的对比
+ */
+int bench_heap(void);
+
+/**
+ * @brief 整数键的哈希表与hash_t在1k、100k、10M个元素时的对比
+ */
+int bench_hash_int(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,169 @@
+/**
+ * @file bench_cpri_queue.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 多个生产者同时入队、一个消费者同时出队时，cpri_queue与加锁的pri_queue的
+ *        对比。每轮入队的节点总数固定，平分给各个生产者，统计生产者每次入队的平均
+ *        耗时以及全部节点出队完成的总耗时。
+ * @version 0.1
+ * @date 2023-03-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <pthread.h>
+#include <sched.h>
+#include "bench.h"
+#include "pri_queue.h"
+#include "cpri_queue.h"
+
+
+#define BENCH_CPQ_TOTAL     (1U << 21)      /* 每轮入队的节点总数 */
+
+static const uint32_t bench_cpq_producers[] = {1, 4, 16};
+
+typedef struct {
+    Bool                concurrent;     /* True时使用cpri_queue，否则使用pri_queue */
+    cpri_queue_t*       cpq;
+    pri_queue_t*        pq;
+    int                 start;          /* 所有生产者就绪后由消费者置位，原子操作 */
+} bench_cpq_ctx_t;
+
+typedef struct {
+    bench_cpq_ctx_t*    ctx;
+    cpri_queue_node_t*  nodes;
+    uint32_t            num;
+    uint64_t            seed;
+    uint64_t            elapsed;        /* 全部入队的耗时(ns) */
+    pthread_t           thread;
+} bench_cpq_producer_t;
+
+
+static uint64_t __bench_cpq_key(const void* elem)
+{
+    return ((const cpri_queue_node_t*)elem)->key;
+}
+
+static void* __bench_cpq_produce(void* arg)
+{
+    bench_cpq_producer_t*   producer = (bench_cpq_producer_t*)arg;
+    bench_cpq_ctx_t*        ctx = producer->ctx;
+    uint64_t                begin = 0;
+
+    while (!__atomic_load_n(&ctx->start, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+
+    begin = bench_now_ns();
+    for (uint32_t i = 0; i < producer->num; i++) {
+        /* 键模拟定时器的到期时间，大致递增但有抖动 */
+        uint64_t    key = i * 64 + bench_rand(&producer->seed) % 4096;
+
+        if (ctx->concurrent) {
+            cpri_queue_push(ctx->cpq, &producer->nodes[i], key);
+        } else {
+            producer->nodes[i].key = key;
+            pri_queue_push(ctx->pq, &producer->nodes[i]);
+        }
+    }
+    producer->elapsed = bench_now_ns() - begin;
+
+    return NULL;
+}
+
+/**
+ * @brief 执行一轮测试，当前线程作为消费者
+ *
+ * @param [in] concurrent 是否使用cpri_queue
+ * @param [in] producer_num 生产者线程数
+ * @param [in] nodes 节点数组，至少BENCH_CPQ_TOTAL个
+ * @return int
+ */
+static int __bench_cpq_round(Bool concurrent, uint32_t producer_num, cpri_queue_node_t* nodes)
+{
+    bench_cpq_ctx_t         ctx = {.concurrent = concurrent};
+    bench_cpq_producer_t*   producers = NULL;
+    cpri_queue_node_t*      node = NULL;
+    void*                   data = NULL;
+    uint32_t                per_producer = BENCH_CPQ_TOTAL / producer_num;
+    uint32_t                total = per_producer * producer_num;
+    uint32_t                popped = 0;
+    uint64_t                push_ns = 0;
+    uint64_t                begin = 0;
+    uint64_t                elapsed = 0;
+    int                     retval = BLIVE_ERR_OK;
+
+    if (concurrent) {
+        retval = cpri_queue_create(&ctx.cpq);
+    } else {
+        ctx.pq = pri_queue_create_keyed(1024, True, __bench_cpq_key);
+        retval = (ctx.pq == NULL) ? BLIVE_ERR_OUTOFMEM : BLIVE_ERR_OK;
+    }
+    producers = zero_alloc(sizeof(bench_cpq_producer_t) * producer_num);
+    if (retval != BLIVE_ERR_OK || producers == NULL) {
+        retval = BLIVE_ERR_OUTOFMEM;
+        goto _out;
+    }
+
+    for (uint32_t i = 0; i < producer_num; i++) {
+        producers[i].ctx = &ctx;
+        producers[i].nodes = nodes + i * per_producer;
+        producers[i].num = per_producer;
+        producers[i].seed = 0x9E3779B97F4A7C15ULL * (i + 1);
+        pthread_create(&producers[i].thread, NULL, __bench_cpq_produce, &producers[i]);
+    }
+
+    begin = bench_now_ns();
+    __atomic_store_n(&ctx.start, 1, __ATOMIC_RELEASE);
+    while (popped < total) {
+        if (concurrent) {
+            retval = cpri_queue_pop(ctx.cpq, &node);
+        } else {
+            retval = pri_queue_pop_trywait(ctx.pq, &data);
+        }
+        if (retval == BLIVE_ERR_OK) {
+            popped++;
+        }
+    }
+    elapsed = bench_now_ns() - begin;
+    retval = BLIVE_ERR_OK;
+
+    for (uint32_t i = 0; i < producer_num; i++) {
+        pthread_join(producers[i].thread, NULL);
+        push_ns += producers[i].elapsed;
+    }
+    printf("%-10u%-12s%14.1f%12.1f%10.2f\n", producer_num, concurrent ? "cpri_queue" : "pri_queue",
+           (double)push_ns / total, (double)elapsed / 1e6, (double)total * 1e3 / elapsed);
+
+_out:
+    free(producers);
+    if (ctx.cpq != NULL) {
+        cpri_queue_destroy(ctx.cpq);
+    }
+    if (ctx.pq != NULL) {
+        pri_queue_destroy(ctx.pq);
+    }
+    return retval;
+}
+
+int bench_cpri_queue(void)
+{
+    cpri_queue_node_t*      nodes = NULL;
+    int                     retval = BLIVE_ERR_OK;
+
+    nodes = zero_alloc(sizeof(cpri_queue_node_t) * BENCH_CPQ_TOTAL);
+    if (nodes == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+
+    printf("%u nodes per round, one consumer popping concurrently\n", BENCH_CPQ_TOTAL);
+    printf("%-10s%-12s%14s%12s%10s\n", "producers", "queue", "push ns/op", "total ms", "Mops/s");
+    for (uint32_t i = 0; i < sizeof(bench_cpq_producers) / sizeof(bench_cpq_producers[0]) && retval == BLIVE_ERR_OK; i++) {
+        retval = __bench_cpq_round(False, bench_cpq_producers[i], nodes);
+        if (retval == BLIVE_ERR_OK) {
+            retval = __bench_cpq_round(True, bench_cpq_producers[i], nodes);
+        }
+    }
+
+    free(nodes);
+    return retval;
+}
@@ -0,0 +1,236 @@
+/**
+ * @file bench_hash_int.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 整数键的hash_u32/hash_u64与字符串键的hash_t的对比。键是互不相同的随机uid，
+ *        hash_t使用uid的十进制字符串，与原来的用法相同，字符串预先生成，不计入耗时。
+ *        依次统计插入、命中查找、未命中查找与删除的平均耗时。
+ * @version 0.1
+ * @date 2023-03-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "bench.h"
+#include "hash.h"
+#include "hash_int.h"
+
+
+#define BENCH_HASH_OPS      (1U << 22)      /* 每种规模的总插入次数，规模较小时重复多轮 */
+#define BENCH_HASH_KEY_SIZE 12              /* uint32_t的十进制字符串 */
+
+static const uint32_t bench_hash_sizes[] = {1000, 100000, 10000000};
+
+typedef enum {
+    BENCH_HASH_STR,
+    BENCH_HASH_U32,
+    BENCH_HASH_U64,
+    BENCH_HASH_KIND_NUM,
+} bench_hash_kind_t;
+
+static const char* bench_hash_names[BENCH_HASH_KIND_NUM] = {"hash_t", "hash_u32", "hash_u64"};
+
+typedef enum {
+    BENCH_HASH_INSERT,
+    BENCH_HASH_HIT,
+    BENCH_HASH_MISS,
+    BENCH_HASH_DELETE,
+    BENCH_HASH_OP_NUM,
+} bench_hash_op_t;
+
+typedef struct {
+    uint32_t*       keys;       /* 前num个插入，后num个用于未命中的查找 */
+    char*           strs;       /* keys对应的字符串，每个BENCH_HASH_KEY_SIZE字节 */
+    uint32_t*       order;      /* 查找与删除的顺序，与插入顺序不同 */
+    uint32_t        num;
+} bench_hash_data_t;
+
+
+#define BENCH_HASH_STR_AT(data, index)  ((data)->strs + (size_t)(index) * BENCH_HASH_KEY_SIZE)
+
+static inline void* __bench_hash_value(uint32_t index)
+{
+    return (void*)(uintptr_t)(index + 1);
+}
+
+/**
+ * @brief 对一种实现执行一轮插入、查找与删除
+ *
+ * @param [in] kind 实现
+ * @param [in] data 测试数据
+ * @param [out] elapsed 传出参数，累加每种操作的耗时
+ * @return int 查找结果错误时返回BLIVE_ERR_UNKNOWN
+ */
+static int __bench_hash_round(bench_hash_kind_t kind, const bench_hash_data_t* data, uint64_t elapsed[BENCH_HASH_OP_NUM])
+{
+    hash_t*         str_table = NULL;
+    hash_u32_t*     u32_table = NULL;
+    hash_u64_t*     u64_table = NULL;
+    uint32_t        num = data->num;
+    uint32_t        index = 0;
+    void*           value = NULL;
+    uint64_t        begin = 0;
+    int             retval = BLIVE_ERR_OK;
+
+    switch (kind) {
+    case BENCH_HASH_STR:
+        retval = hash_create(&str_table, num, NULL);
+        break;
+    case BENCH_HASH_U32:
+        retval = hash_u32_create(&u32_table, num);
+        break;
+    default:
+        retval = hash_u64_create(&u64_table, num);
+        break;
+    }
+    if (retval != BLIVE_ERR_OK) {
+        return retval;
+    }
+
+    begin = bench_now_ns();
+    for (uint32_t i = 0; i < num; i++) {
+        if (kind == BENCH_HASH_STR) {
+            hash_push(str_table, BENCH_HASH_STR_AT(data, i), __bench_hash_value(i));
+        } else if (kind == BENCH_HASH_U32) {
+            hash_u32_push(u32_table, data->keys[i], __bench_hash_value(i), NULL);
+        } else {
+            hash_u64_push(u64_table, data->keys[i], __bench_hash_value(i), NULL);
+        }
+    }
+    elapsed[BENCH_HASH_INSERT] += bench_now_ns() - begin;
+
+    begin = bench_now_ns();
+    for (uint32_t i = 0; i < num && retval == BLIVE_ERR_OK; i++) {
+        index = data->order[i];
+        if (kind == BENCH_HASH_STR) {
+            value = hash_peek(str_table, BENCH_HASH_STR_AT(data, index));
+        } else if (kind == BENCH_HASH_U32) {
+            value = hash_u32_peek(u32_table, data->keys[index]);
+        } else {
+            value = hash_u64_peek(u64_table, data->keys[index]);
+        }
+        if (value != __bench_hash_value(index)) {
+            retval = BLIVE_ERR_UNKNOWN;
+        }
+    }
+    elapsed[BENCH_HASH_HIT] += bench_now_ns() - begin;
+
+    begin = bench_now_ns();
+    for (uint32_t i = 0; i < num && retval == BLIVE_ERR_OK; i++) {
+        index = num + data->order[i];
+        if (kind == BENCH_HASH_STR) {
+            value = hash_peek(str_table, BENCH_HASH_STR_AT(data, index));
+        } else if (kind == BENCH_HASH_U32) {
+            value = hash_u32_peek(u32_table, data->keys[index]);
+        } else {
+            value = hash_u64_peek(u64_table, data->keys[index]);
+        }
+        if (value != NULL) {
+            retval = BLIVE_ERR_UNKNOWN;
+        }
+    }
+    elapsed[BENCH_HASH_MISS] += bench_now_ns() - begin;
+
+    begin = bench_now_ns();
+    for (uint32_t i = 0; i < num && retval == BLIVE_ERR_OK; i++) {
+        index = data->order[i];
+        if (kind == BENCH_HASH_STR) {
+            value = hash_pop(str_table, BENCH_HASH_STR_AT(data, index));
+        } else if (kind == BENCH_HASH_U32) {
+            value = hash_u32_pop(u32_table, data->keys[index]);
+        } else {
+            value = hash_u64_pop(u64_table, data->keys[index]);
+        }
+        if (value != __bench_hash_value(index)) {
+            retval = BLIVE_ERR_UNKNOWN;
+        }
+    }
+    elapsed[BENCH_HASH_DELETE] += bench_now_ns() - begin;
+
+    if (str_table != NULL) {
+        hash_destroy(str_table);
+    }
+    if (u32_table != NULL) {
+        hash_u32_destroy(u32_table);
+    }
+    if (u64_table != NULL) {
+        hash_u64_destroy(u64_table);
+    }
+    return retval;
+}
+
+/**
+ * @brief 生成互不相同的随机键以及打乱的访问顺序
+ *
+ * @param [out] data 测试数据
+ * @param [in] num 插入的元素个数
+ * @return int
+ */
+static int __bench_hash_prepare(bench_hash_data_t* data, uint32_t num)
+{
+    uint64_t    seed = 0x9E3779B97F4A7C15ULL;
+    uint32_t    salt = (uint32_t)bench_rand(&seed);
+    uint32_t    swap = 0;
+    uint32_t    other = 0;
+
+    data->num = num;
+    data->keys = malloc(sizeof(uint32_t) * num * 2);
+    data->strs = malloc((size_t)BENCH_HASH_KEY_SIZE * num * 2);
+    data->order = malloc(sizeof(uint32_t) * num);
+    if (data->keys == NULL || data->strs == NULL || data->order == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+
+    /* 乘以奇数在模2^32下是一一映射，不同的序号得到不同的键 */
+    for (uint32_t i = 0; i < num * 2; i++) {
+        data->keys[i] = (i * 2654435761U) ^ salt;
+        snprintf(BENCH_HASH_STR_AT(data, i), BENCH_HASH_KEY_SIZE, "%u", data->keys[i]);
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        data->order[i] = i;
+    }
+    for (uint32_t i = num - 1; i > 0; i--) {
+        other = (uint32_t)(bench_rand(&seed) % (i + 1));
+        swap = data->order[i];
+        data->order[i] = data->order[other];
+        data->order[other] = swap;
+    }
+
+    return BLIVE_ERR_OK;
+}
+
+static void __bench_hash_release(bench_hash_data_t* data)
+{
+    free(data->keys);
+    free(data->strs);
+    free(data->order);
+    memset(data, 0, sizeof(bench_hash_data_t));
+}
+
+int bench_hash_int(void)
+{
+    bench_hash_data_t   data = {0};
+    uint64_t            elapsed[BENCH_HASH_OP_NUM] = {0};
+    uint64_t            ops = 0;
+    int                 retval = BLIVE_ERR_OK;
+
+    printf("%-10s%-10s%12s%12s%12s%12s  (ns/op)\n", "size", "table", "insert", "hit", "miss", "delete");
+    for (uint32_t i = 0; i < sizeof(bench_hash_sizes) / sizeof(bench_hash_sizes[0]) && retval == BLIVE_ERR_OK; i++) {
+        uint32_t    num = bench_hash_sizes[i];
+        uint32_t    rounds = max(BENCH_HASH_OPS / num, 1U);
+
+        retval = __bench_hash_prepare(&data, num);
+        for (bench_hash_kind_t kind = 0; kind < BENCH_HASH_KIND_NUM && retval == BLIVE_ERR_OK; kind++) {
+            memset(elapsed, 0, sizeof(elapsed));
+            for (uint32_t round = 0; round < rounds && retval == BLIVE_ERR_OK; round++) {
+                retval = __bench_hash_round(kind, &data, elapsed);
+            }
+            ops = (uint64_t)num * rounds;
+            printf("%-10u%-10s%12.1f%12.1f%12.1f%12.1f\n", num, bench_hash_names[kind],
+                   (double)elapsed[BENCH_HASH_INSERT] / ops, (double)elapsed[BENCH_HASH_HIT] / ops,
+                   (double)elapsed[BENCH_HASH_MISS] / ops, (double)elapsed[BENCH_HASH_DELETE] / ops);
+        }
+        __bench_hash_release(&data);
+    }
+
+    return retval;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file bench_heap.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 单线程下PRI_QUEUE_DEFINE生成的d叉堆与通用pri_queue的对比。通用版本分别使用
+ *        比较函数(按timeval比较，与原来的定时器相同)与键函数，二者每次操作都要加锁。
+ *        每轮先按随机键入队N个元素，再全部出队，统计每次入队与出队的平均耗时。
+ * @version 0.1
+ * @date 2023-03-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <sys/time.h>
+#include "bench.h"
+#include "pri_queue.h"
+#include "dary_heap.h"
+
+
+#define BENCH_HEAP_OPS      (1U << 22)      /* 每种规模的总入队次数，规模较小时重复多轮 */
+
+PRI_QUEUE_DEFINE_KEYED(bench_heap4, 4)
+PRI_QUEUE_DEFINE_KEYED(bench_heap8, 8)
+
+static const uint32_t bench_heap_sizes[] = {1000, 100000, 1000000};
+
+typedef enum {
+    BENCH_HEAP_COMP,        /* pri_queue + 比较函数 */
+    BENCH_HEAP_KEYED,       /* pri_queue + 键函数 */
+    BENCH_HEAP_DARY4,
+    BENCH_HEAP_DARY8,
+    BENCH_HEAP_KIND_NUM,
+} bench_heap_kind_t;
+
+static const char* bench_heap_names[BENCH_HEAP_KIND_NUM] = {
+    "pri_queue(comp)", "pri_queue(keyed)", "dary_heap(4)", "dary_heap(8)",
+};
+
+typedef struct {
+    struct timeval  expire;
+    uint64_t        key;
+} bench_heap_item_t;
+
+
+static Bool __bench_heap_comp(void* elem1, void* elem2)
+{
+    const struct timeval*   a = &((bench_heap_item_t*)elem1)->expire;
+    const struct timeval*   b = &((bench_heap_item_t*)elem2)->expire;
+
+    return ((a->tv_sec - b->tv_sec) * 1000000 + (a->tv_usec - b->tv_usec) < 0) ? True : False;
+}
+
+static uint64_t __bench_heap_key(const void* elem)
+{
+    return ((const bench_heap_item_t*)elem)->key;
+}
+
+/**
+ * @brief 对一种实现执行若干轮先全部入队、再全部出队的测试
+ *
+ * @param [in] kind 实现
+ * @param [in] items 元素数组，已经填好随机的键
+ * @param [in] num 每轮的元素个数
+ * @param [in] rounds 轮数
+ * @param [out] push_ns 传出参数，入队的总耗时
+ * @param [out] pop_ns 传出参数，出队的总耗时
+ * @return int 出队顺序错误时返回BLIVE_ERR_UNKNOWN
+ */
+static int __bench_heap_run(bench_heap_kind_t kind, bench_heap_item_t* items, uint32_t num, uint32_t rounds,
+                            uint64_t* push_ns, uint64_t* pop_ns)
+{
+    pri_queue_t*        pq = NULL;
+    bench_heap4_t       heap4;
+    bench_heap8_t       heap8;
+    dary_heap_key_t     elem;
+    void*               data = NULL;
+    uint64_t            last = 0;
+    uint64_t            begin = 0;
+    int                 retval = BLIVE_ERR_OK;
+
+    *push_ns = 0;
+    *pop_ns = 0;
+    bench_heap4_init(&heap4);
+    bench_heap8_init(&heap8);
+    if (kind == BENCH_HEAP_COMP) {
+        pq = pri_queue_create(num, False, __bench_heap_comp);
+    } else if (kind == BENCH_HEAP_KEYED) {
+        pq = pri_queue_create_keyed(num, False, __bench_heap_key);
+    } else if (bench_heap4_reserve(&heap4, num) != BLIVE_ERR_OK || bench_heap8_reserve(&heap8, num) != BLIVE_ERR_OK) {
+        retval = BLIVE_ERR_OUTOFMEM;
+        goto _out;
+    }
+    if ((kind == BENCH_HEAP_COMP || kind == BENCH_HEAP_KEYED) && pq == NULL) {
+        retval = BLIVE_ERR_OUTOFMEM;
+        goto _out;
+    }
+
+    for (uint32_t round = 0; round < rounds && retval == BLIVE_ERR_OK; round++) {
+        begin = bench_now_ns();
+        for (uint32_t i = 0; i < num; i++) {
+            elem.key = items[i].key;
+            elem.data = &items[i];
+            switch (kind) {
+            case BENCH_HEAP_COMP:
+            case BENCH_HEAP_KEYED:
+                pri_queue_push(pq, &items[i]);
+                break;
+            case BENCH_HEAP_DARY4:
+                bench_heap4_push(&heap4, &elem);
+                break;
+            default:
+                bench_heap8_push(&heap8, &elem);
+                break;
+            }
+        }
+        *push_ns += bench_now_ns() - begin;
+
+        /* 出队的同时检查顺序，保证比较的是正确的实现 */
+        last = 0;
+        begin = bench_now_ns();
+        for (uint32_t i = 0; i < num; i++) {
+            switch (kind) {
+            case BENCH_HEAP_COMP:
+            case BENCH_HEAP_KEYED:
+                pri_queue_pop_trywait(pq, &data);
+                break;
+            case BENCH_HEAP_DARY4:
+                bench_heap4_pop(&heap4, &elem);
+                data = elem.data;
+                break;
+            default:
+                bench_heap8_pop(&heap8, &elem);
+                data = elem.data;
+                break;
+            }
+            if (((bench_heap_item_t*)data)->key < last) {
+                retval = BLIVE_ERR_UNKNOWN;
+                break;
+            }
+            last = ((bench_heap_item_t*)data)->key;
+        }
+        *pop_ns += bench_now_ns() - begin;
+    }
+
+_out:
+    if (pq != NULL) {
+        pri_queue_destroy(pq);
+    }
+    bench_heap4_destroy(&heap4);
+    bench_heap8_destroy(&heap8);
+    return retval;
+}
+
+int bench_heap(void)
+{
+    bench_heap_item_t*  items = NULL;
+    uint32_t            max_num = bench_heap_sizes[sizeof(bench_heap_sizes) / sizeof(bench_heap_sizes[0]) - 1];
+    uint64_t            seed = 0x9E3779B97F4A7C15ULL;
+    uint64_t            push_ns = 0;
+    uint64_t            pop_ns = 0;
+    int                 retval = BLIVE_ERR_OK;
+
+    items = zero_alloc(sizeof(bench_heap_item_t) * max_num);
+    if (items == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    /* 键是以微秒为单位的到期时间，timeval与键表示同一个时刻 */
+    for (uint32_t i = 0; i < max_num; i++) {
+        items[i].key = bench_rand(&seed) % (3600ULL * 1000000);
+        items[i].expire.tv_sec = (time_t)(items[i].key / 1000000);
+        items[i].expire.tv_usec = (suseconds_t)(items[i].key % 1000000);
+    }
+
+    printf("%-10s%-18s%14s%14s\n", "size", "queue", "push ns/op", "pop ns/op");
+    for (uint32_t i = 0; i < sizeof(bench_heap_sizes) / sizeof(bench_heap_sizes[0]) && retval == BLIVE_ERR_OK; i++) {
+        uint32_t    num = bench_heap_sizes[i];
+        uint32_t    rounds = max(BENCH_HEAP_OPS / num, 1U);
+
+        for (bench_heap_kind_t kind = 0; kind < BENCH_HEAP_KIND_NUM && retval == BLIVE_ERR_OK; kind++) {
+            retval = __bench_heap_run(kind, items, num, rounds, &push_ns, &pop_ns);
+            printf("%-10u%-18s%14.1f%14.1f\n", num, bench_heap_names[kind],
+                   (double)push_ns / ((uint64_t)num * rounds), (double)pop_ns / ((uint64_t)num * rounds));
+        }
+    }
+
+    free(items);
+    return retval;
+}
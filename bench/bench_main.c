@@ -0,0 +1,76 @@
+/**
+ * @file bench_main.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 性能测试的入口。不带参数时依次执行所有测试，否则只执行指定名称的测试：
+ *          blive_bench [name ...]
+ * @version 0.1
+ * @date 2023-03-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "bench.h"
+
+
+typedef struct {
+    const char*     name;
+    const char*     desc;
+    int             (*run)(void);
+} bench_case_t;
+
+static const bench_case_t bench_cases[] = {
+    {"cpri_queue",  "并发优先级队列与pri_queue在多个生产者时的对比", bench_cpri_queue},
+    {"heap",        "PRI_QUEUE_DEFINE生成的d叉堆与通用pri_queue的对比", bench_heap},
+    {"hash_int",    "整数键的哈希表与hash_t的对比", bench_hash_int},
+};
+
+#define BENCH_CASE_NUM  (sizeof(bench_cases) / sizeof(bench_cases[0]))
+
+
+static void __bench_usage(const char* prog)
+{
+    printf("usage: %s [name ...]\n", prog);
+    for (uint32_t i = 0; i < BENCH_CASE_NUM; i++) {
+        printf("  %-12s %s\n", bench_cases[i].name, bench_cases[i].desc);
+    }
+}
+
+static int __bench_run(const bench_case_t* bench)
+{
+    int     retval = BLIVE_ERR_OK;
+
+    printf("== %s ==\n", bench->name);
+    retval = bench->run();
+    if (retval != BLIVE_ERR_OK) {
+        printf("%s failed(%d)\n", bench->name, retval);
+    }
+    printf("\n");
+    return retval;
+}
+
+int main(int argc, char** argv)
+{
+    int         retval = BLIVE_ERR_OK;
+    uint32_t    i = 0;
+
+    if (argc == 1) {
+        for (i = 0; i < BENCH_CASE_NUM; i++) {
+            retval |= __bench_run(&bench_cases[i]);
+        }
+        return retval ? 1 : 0;
+    }
+
+    for (int arg = 1; arg < argc; arg++) {
+        for (i = 0; i < BENCH_CASE_NUM; i++) {
+            if (!strcmp(argv[arg], bench_cases[i].name)) {
+                retval |= __bench_run(&bench_cases[i]);
+                break;
+            }
+        }
+        if (i == BENCH_CASE_NUM) {
+            __bench_usage(argv[0]);
+            return 1;
+        }
+    }
+    return retval ? 1 : 0;
+}
@@ -19,6 +19,13 @@
 #include "bliveq_internal.h"
 #include "qlist.h"
 #include "httpd.h"
+#include "json_writer.h"
+
+
+#define API_QUEUE_PATH          "/api/queue"
+#define API_QUEUE_LIMIT         100     /*未指定limit时每页的数量*/
+#define API_QUEUE_LIMIT_MAX     1000    /*每页数量的上限*/
+#define API_QUERY_VALUE_SIZE    256
 
 
 typedef struct {
@@ -31,6 +38,32 @@ typedef struct {
     blive_queue*    queue_entity;
 } foreach_qlist_data;
 
+typedef struct {
+    json_writer*    writer;
+    blive_queue*    queue_entity;
+} foreach_qlist_json;
+
+typedef enum {
+    API_FIELD_RANK = 1 << 0,            /*在队列中的位置，从0开始*/
+    API_FIELD_UID = 1 << 1,
+    API_FIELD_NAME = 1 << 2,            /*昵称*/
+    API_FIELD_WEIGHT = 1 << 3,          /*权重*/
+    API_FIELD_FLEET = 1 << 4,           /*舰队等级*/
+    API_FIELD_MANAGER = 1 << 5,         /*是否是房管*/
+    API_FIELD_FANS_LEVEL = 1 << 6,      /*粉丝牌等级*/
+    API_FIELD_FANS_NAME = 1 << 7,       /*粉丝牌名称*/
+    API_FIELD_FANS_CURRENT = 1 << 8,    /*粉丝牌是否是当前直播间的*/
+    API_FIELD_ALL = (1 << 9) - 1,
+} api_queue_field;
+
+typedef struct {
+    json_writer*    writer;
+    uint32_t        fields;     /*需要输出的字段*/
+    uint32_t        offset;
+    uint32_t        limit;
+    uint32_t        rank;       /*遍历到的位置，遍历结束后为队列的长度*/
+} foreach_qlist_api;
+
 static void liveroom_info_recv(fd_t fd, void* data);
 
 
@@ -81,7 +114,9 @@ static void liveroom_info_recv(fd_t fd, void* data)
 
     /*如果发送取消排队，在qlist中移除*/
     if (info.data.cancel_queue_up) {
-        qlist_subtract(queue_entity->qlist, info.data.danmu_sender_uid);
+        if (qlist_subtract(queue_entity->qlist, info.data.danmu_sender_uid) == BLIVE_ERR_OK) {
+            http_event_notify(queue_entity->httpd);
+        }
         return ;
     }
 
@@ -112,7 +147,9 @@ static void liveroom_info_recv(fd_t fd, void* data)
         }
         info.data.weight = weight;
         blive_logd("qlist_append_update %s:%d", info.data.danmu_sender_name, info.data.weight);
-        qlist_append_update(queue_entity->qlist, info.data.danmu_sender_uid, &info.data);
+        if (qlist_append_update(queue_entity->qlist, info.data.danmu_sender_uid, &info.data) == BLIVE_ERR_OK) {
+            http_event_notify(queue_entity->httpd);
+        }
         break;
     }
     case BLIVE_INFO_SEND_GIFT:
@@ -141,7 +178,9 @@ static void liveroom_info_recv(fd_t fd, void* data)
         }
         info.data.weight = weight;
         // blive_loge("qlist_append_update");
-        qlist_append_update(queue_entity->qlist, info.data.danmu_sender_uid, &info.data);
+        if (qlist_append_update(queue_entity->qlist, info.data.danmu_sender_uid, &info.data) == BLIVE_ERR_OK) {
+            http_event_notify(queue_entity->httpd);
+        }
         break;
     }
     default:
@@ -150,21 +189,30 @@ static void liveroom_info_recv(fd_t fd, void* data)
     return ;
 }
 
-static Bool qlist_foreach_make_text(uint32_t anchorage, const qlist_unit_data* data, void* context)
+/**
+ * @brief 排队用户显示的颜色：舰队成员、当前直播间的粉丝、其他用户
+ * 
+ * @param queue_entity blive_queue对象
+ * @param data 排队用户的数据
+ * @return const char* 
+ */
+static const char* qlist_unit_color(blive_queue* queue_entity, const qlist_unit_data* data)
 {
-    foreach_qlist_data*     fdata = (foreach_qlist_data*)context;
-    int                     prefix_datalen = strlen(fdata->dst);
-    const char*             color_str = NULL;
-
     if (data->fleet_lv != FLEET_LV_NONE) {
-        color_str = fdata->queue_entity->conf.color_config.capt_color;
+        return queue_entity->conf.color_config.capt_color;
     } else if (data->fans_price_is_cur_liveroom) {
-        color_str = fdata->queue_entity->conf.color_config.fans_color;
-    } else {
-        color_str = fdata->queue_entity->conf.color_config.others_color;
+        return queue_entity->conf.color_config.fans_color;
     }
+    return queue_entity->conf.color_config.others_color;
+}
+
+static Bool qlist_foreach_make_text(uint32_t anchorage, const qlist_unit_data* data, void* context)
+{
+    foreach_qlist_data*     fdata = (foreach_qlist_data*)context;
+    int                     prefix_datalen = strlen(fdata->dst);
 
-    sprintf(fdata->dst + prefix_datalen, "<p><font color=\"%s\">%s</font></p>\r\n", color_str, data->danmu_sender_name);
+    sprintf(fdata->dst + prefix_datalen, "<p><font color=\"%s\">%s</font></p>\r\n",
+            qlist_unit_color(fdata->queue_entity, data), data->danmu_sender_name);
     return True;
 }
 
@@ -188,7 +236,289 @@ static void liveroom_qlist_make_text(char* dst, void* context)
 }
 
 /**
- * @brief 定时2秒刷新html页面
+ * @brief 排队列表的版本号，用于判断html页面是否需要重新渲染
+ * 
+ * @param context blive_queue对象
+ * @return uint64_t 
+ */
+static uint64_t liveroom_qlist_version(void* context)
+{
+    return qlist_version(((blive_queue*)context)->qlist);
+}
+
+/**
+ * @brief 写入一个排队用户：{"u":uid,"n":昵称,"w":权重,"l":舰队等级,"c":颜色}
+ * 
+ * @param writer json生成器
+ * @param key 在对象中时为键名，在数组中时为NULL
+ * @param queue_entity blive_queue对象
+ * @param anchorage 用户的uid
+ * @param data 排队用户的数据
+ */
+static void qlist_unit_json(json_writer* writer, const char* key, blive_queue* queue_entity, uint32_t anchorage, const qlist_unit_data* data)
+{
+    json_writer_object_begin(writer, key);
+    json_writer_uint(writer, "u", anchorage);
+    json_writer_string(writer, "n", data->danmu_sender_name);
+    json_writer_uint(writer, "w", data->weight);
+    json_writer_uint(writer, "l", data->fleet_lv);
+    json_writer_string(writer, "c", qlist_unit_color(queue_entity, data));
+    json_writer_object_end(writer);
+}
+
+static Bool qlist_foreach_make_json(uint32_t anchorage, const qlist_unit_data* data, void* context)
+{
+    foreach_qlist_json*     fdata = (foreach_qlist_json*)context;
+
+    qlist_unit_json(fdata->writer, NULL, fdata->queue_entity, anchorage, data);
+    return True;
+}
+
+/**
+ * @brief 生成WebSocket的快照：{"t":"s","v":版本号,"q":[排队用户...]}，之后的增量消息中
+ *        版本号不大于快照版本号的需要由客户端丢弃
+ * 
+ * @param data 传出参数，生成的消息
+ * @param len 传出参数，消息的长度
+ * @param context blive_queue对象
+ * @return blive_errno_t 
+ */
+static blive_errno_t liveroom_qlist_snapshot(char** data, uint32_t* len, void* context)
+{
+    json_writer         writer;
+    foreach_qlist_json  fdata = {.writer = &writer, .queue_entity = (blive_queue*)context};
+    blive_errno_t       err = BLIVE_ERR_OK;
+    uint64_t            version = 0;
+
+    json_writer_init(&writer);
+    json_writer_object_begin(&writer, NULL);
+    json_writer_string(&writer, "t", "s");
+    /*遍历结束前不知道版本号，先写入列表，版本号放在最后*/
+    json_writer_array_begin(&writer, "q");
+    err = qlist_foreach_version(fdata.queue_entity->qlist, False, qlist_foreach_make_json, &fdata, &version);
+    if (err != BLIVE_ERR_OK && err != BLIVE_ERR_RESOURCE) {
+        blive_loge("foreach get qlist snapshot failed!(%d)", err);
+    }
+    json_writer_array_end(&writer);
+    json_writer_uint(&writer, "v", version);
+    json_writer_object_end(&writer);
+
+    *data = json_writer_detach(&writer, len);
+    return *data != NULL ? BLIVE_ERR_OK : BLIVE_ERR_OUTOFMEM;
+}
+
+/**
+ * @brief 将排队列表的每一次变化广播给WebSocket的客户端，rank为从队首的0开始的位置：
+ *          插入  {"t":"i","v":版本号,"r":rank,"d":排队用户}
+ *          移除  {"t":"r","v":版本号,"r":rank}
+ *          移动  {"t":"m","v":版本号,"f":原来的rank,"r":rank,"d":排队用户}
+ *          更新  {"t":"u","v":版本号,"r":rank,"d":排队用户}
+ *        在qlist的锁中调用，广播的顺序与版本号的顺序一致
+ * 
+ * @param change 队列的变化
+ * @param context blive_queue对象
+ */
+static void liveroom_qlist_change(const qlist_change* change, void* context)
+{
+    static const char*  type_str[] = {
+        [QLIST_CHANGE_INSERT] = "i",
+        [QLIST_CHANGE_REMOVE] = "r",
+        [QLIST_CHANGE_MOVE] = "m",
+        [QLIST_CHANGE_UPDATE] = "u",
+    };
+    blive_queue*        queue_entity = (blive_queue*)context;
+    json_writer         writer;
+
+    json_writer_init(&writer);
+    json_writer_object_begin(&writer, NULL);
+    json_writer_string(&writer, "t", type_str[change->type]);
+    json_writer_uint(&writer, "v", change->version);
+    if (change->type == QLIST_CHANGE_MOVE) {
+        json_writer_uint(&writer, "f", change->old_rank);
+    }
+    json_writer_uint(&writer, "r", change->rank);
+    if (change->data != NULL) {
+        qlist_unit_json(&writer, "d", queue_entity, change->anchorage, change->data);
+    }
+    json_writer_object_end(&writer);
+
+    if (json_writer_error(&writer) != BLIVE_ERR_OK ||
+        http_ws_broadcast(queue_entity->httpd, writer.data, writer.len) != BLIVE_ERR_OK) {
+        blive_loge("broadcast qlist change failed, version %llu", (unsigned long long)change->version);
+    }
+    json_writer_release(&writer);
+}
+
+static Bool qlist_foreach_make_api(uint32_t anchorage, const qlist_unit_data* data, void* context)
+{
+    foreach_qlist_api*  fdata = (foreach_qlist_api*)context;
+    json_writer*        writer = fdata->writer;
+    uint32_t            fields = fdata->fields;
+    uint32_t            rank = fdata->rank++;
+
+    /*不在这一页的单元只计数，用于得到队列的总长度*/
+    if (rank < fdata->offset || rank - fdata->offset >= fdata->limit) {
+        return True;
+    }
+    json_writer_object_begin(writer, NULL);
+    if (fields & API_FIELD_RANK) {
+        json_writer_uint(writer, "rank", rank);
+    }
+    if (fields & API_FIELD_UID) {
+        json_writer_uint(writer, "uid", anchorage);
+    }
+    if (fields & API_FIELD_NAME) {
+        json_writer_string(writer, "name", data->danmu_sender_name);
+    }
+    if (fields & API_FIELD_WEIGHT) {
+        json_writer_uint(writer, "weight", data->weight);
+    }
+    if (fields & API_FIELD_FLEET) {
+        json_writer_uint(writer, "fleet", data->fleet_lv);
+    }
+    if (fields & API_FIELD_MANAGER) {
+        json_writer_bool(writer, "manager", data->is_hostoom_manager);
+    }
+    if (fields & API_FIELD_FANS_LEVEL) {
+        json_writer_uint(writer, "fans_level", data->fans_price_level);
+    }
+    if (fields & API_FIELD_FANS_NAME) {
+        json_writer_string(writer, "fans_name", data->fans_price_name);
+    }
+    if (fields & API_FIELD_FANS_CURRENT) {
+        json_writer_bool(writer, "fans_current", data->fans_price_is_cur_liveroom);
+    }
+    json_writer_object_end(writer);
+    return True;
+}
+
+/**
+ * @brief 读取查询参数中的非负整数
+ * 
+ * @param query 查询参数
+ * @param key 参数名
+ * @param value 传出参数，没有该参数时保持不变
+ * @return blive_errno_t 参数不是整数时返回BLIVE_ERR_INVALID
+ */
+static blive_errno_t api_query_uint(const char* query, const char* key, uint32_t* value)
+{
+    char            str[API_QUERY_VALUE_SIZE] = {0};
+    char*           end = NULL;
+    unsigned long   number = 0;
+    blive_errno_t   err = BLIVE_ERR_OK;
+
+    err = http_query_param(query, key, str, sizeof(str));
+    if (err == BLIVE_ERR_NOTEXSIT) {
+        return BLIVE_ERR_OK;
+    }
+    if (err != BLIVE_ERR_OK || str[0] < '0' || str[0] > '9') {
+        return BLIVE_ERR_INVALID;
+    }
+    number = strtoul(str, &end, 10);
+    if (*end != '\0' || number > UINT32_MAX) {
+        return BLIVE_ERR_INVALID;
+    }
+    *value = (uint32_t)number;
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 解析以逗号分隔的字段列表，没有该参数或者为空时输出全部字段
+ * 
+ * @param query 查询参数
+ * @param fields 传出参数，需要输出的字段
+ * @return blive_errno_t 有未知的字段时返回BLIVE_ERR_INVALID
+ */
+static blive_errno_t api_query_fields(const char* query, uint32_t* fields)
+{
+    static const struct {
+        const char*     name;
+        api_queue_field field;
+    } field_map[] = {
+        {"rank",            API_FIELD_RANK},
+        {"uid",             API_FIELD_UID},
+        {"name",            API_FIELD_NAME},
+        {"weight",          API_FIELD_WEIGHT},
+        {"fleet",           API_FIELD_FLEET},
+        {"manager",         API_FIELD_MANAGER},
+        {"fans_level",      API_FIELD_FANS_LEVEL},
+        {"fans_name",       API_FIELD_FANS_NAME},
+        {"fans_current",    API_FIELD_FANS_CURRENT},
+    };
+    char        str[API_QUERY_VALUE_SIZE] = {0};
+    char*       name = NULL;
+    char*       save = NULL;
+    int         index = 0;
+
+    *fields = API_FIELD_ALL;
+    if (http_query_param(query, "fields", str, sizeof(str)) == BLIVE_ERR_RESOURCE) {
+        return BLIVE_ERR_INVALID;
+    }
+    if (!str[0]) {
+        return BLIVE_ERR_OK;
+    }
+
+    *fields = 0;
+    for (name = strtok_r(str, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+        for (index = 0; index < sizeof(field_map) / sizeof(field_map[0]); index++) {
+            if (!strcmp(name, field_map[index].name)) {
+                *fields |= field_map[index].field;
+                break;
+            }
+        }
+        if (index == sizeof(field_map) / sizeof(field_map[0])) {
+            return BLIVE_ERR_INVALID;
+        }
+    }
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 生成/api/queue的响应，参数为offset、limit与fields：
+ *          {"version":版本号,"offset":0,"limit":100,"queue":[{"rank":0,"uid":...},...],"total":队列长度}
+ *        遍历时直接写入json文本，响应由httpd按版本号缓存
+ * 
+ * @param query 查询参数
+ * @param data 传出参数，生成的响应体
+ * @param len 传出参数，响应体的长度
+ * @param context blive_queue对象
+ * @return blive_errno_t 参数不合法时返回BLIVE_ERR_INVALID
+ */
+static blive_errno_t liveroom_api_queue(const char* query, char** data, uint32_t* len, void* context)
+{
+    blive_queue*        queue_entity = (blive_queue*)context;
+    json_writer         writer;
+    foreach_qlist_api   fdata = {.writer = &writer, .limit = API_QUEUE_LIMIT};
+    uint64_t            version = 0;
+    blive_errno_t       err = BLIVE_ERR_OK;
+
+    if (api_query_uint(query, "offset", &fdata.offset) != BLIVE_ERR_OK ||
+        api_query_uint(query, "limit", &fdata.limit) != BLIVE_ERR_OK ||
+        api_query_fields(query, &fdata.fields) != BLIVE_ERR_OK) {
+        return BLIVE_ERR_INVALID;
+    }
+    fdata.limit = min(fdata.limit, (uint32_t)API_QUEUE_LIMIT_MAX);
+
+    json_writer_init(&writer);
+    json_writer_object_begin(&writer, NULL);
+    json_writer_array_begin(&writer, "queue");
+    err = qlist_foreach_version(queue_entity->qlist, False, qlist_foreach_make_api, &fdata, &version);
+    if (err != BLIVE_ERR_OK && err != BLIVE_ERR_RESOURCE) {
+        blive_loge("foreach get qlist api failed!(%d)", err);
+    }
+    json_writer_array_end(&writer);
+    json_writer_uint(&writer, "version", version);
+    json_writer_uint(&writer, "offset", fdata.offset);
+    json_writer_uint(&writer, "limit", fdata.limit);
+    json_writer_uint(&writer, "total", fdata.rank);
+    json_writer_object_end(&writer);
+
+    *data = json_writer_detach(&writer, len);
+    return *data != NULL ? BLIVE_ERR_OK : BLIVE_ERR_OUTOFMEM;
+}
+
+/**
+ * @brief 通过/events的推送刷新排队列表，浏览器不支持时退回到定时2秒刷新html页面
  * 
  * @param dst 目的字符串
  * @param context 不使用
@@ -198,7 +528,9 @@ static void refresh_html(char* dst, void* context)
     if (context != NULL) {
         return ;
     }
-    strcat(dst, "<script>function aoto_refresh(){window.location.reload();};setTimeout('aoto_refresh()',2000);</script>\r\n");
+    strcat(dst, "<script>if(window.EventSource){var es=new EventSource('/events');"
+                "es.onmessage=function(e){document.getElementById('queuelist').innerHTML=e.data;};}"
+                "else{function aoto_refresh(){window.location.reload();};setTimeout('aoto_refresh()',2000);}</script>\r\n");
     return ;
 }
 
@@ -220,6 +552,14 @@ blive_errno_t callbacks_init(blive_queue* queue_entity)
     /*在index.html中添加动态注入的排队列表*/
     http_html_injection(queue_entity->httpd, "__refresh_injection__", refresh_html, NULL);
     http_html_injection(queue_entity->httpd, "__queuelist_injection__", liveroom_qlist_make_text, queue_entity);
+    http_html_version(queue_entity->httpd, liveroom_qlist_version, queue_entity);
+    /*排队列表变化时推送给已打开的页面*/
+    http_event_source(queue_entity->httpd, liveroom_qlist_make_text, queue_entity);
+    /*直播叠加层通过WebSocket接收快照与增量的变化*/
+    http_ws_source(queue_entity->httpd, liveroom_qlist_snapshot, queue_entity);
+    qlist_observe(queue_entity->qlist, liveroom_qlist_change, queue_entity);
+    /*供机器人读取的排队列表，按版本号缓存*/
+    http_api_route(queue_entity->httpd, API_QUEUE_PATH, liveroom_api_queue, liveroom_qlist_version, queue_entity);
 
     return BLIVE_ERR_OK;
 }
@@ -15,6 +15,7 @@
 #include "blive_api/blive_api.h"
 
 #include "select.h"
+#include "select_group.h"
 #include "cJSON.h"
 
 #include "config.h"
@@ -24,26 +25,12 @@
 
 
 #define BLIVE_QUEUE_CFG_PATH        "./config/pdjcfg.json"
+#define BLIVE_QUEUE_LOOP_NUM        0       /* 事件引擎的数量，0表示与CPU核心数相同 */
 
 
 static int schedule_set_func(void *sched_entity, size_t millisec, blive_schedule_cb cb, void* cb_context)
 {
-    return select_engine_schedule_add((select_engine_t*)sched_entity, cb, cb_context, millisec * 1000);
-}
-
-/**
- * @brief 定时器功能模块线程
- * 
- * @param arg 
- * @return void* 
- */
-static void* select_engine_thread(void* arg)
-{
-    select_engine_t*    engine = (select_engine_t*)arg;
-
-    select_engine_perform(engine);
-    blive_loge("select_engine_thread end\n");
-    return NULL;
+    return select_engine_schedule_add((select_engine_t*)sched_entity, cb, cb_context, millisec * 1000, NULL);
 }
 
 /**
@@ -154,7 +141,8 @@ static int parse_config(const char* config_path, blive_ext_cfg* config)
 
 int main(void)
 {
-    pthread_t           timer_pid;
+    select_engine_group_t*  loops = NULL;
+    select_engine_t*    httpd_engine = NULL;
     void*               thrd_ret = NULL;
     blive_queue         queue_entity;
 
@@ -164,12 +152,23 @@ int main(void)
         return ERROR;
     }
 
-    /*启动select_engine来实现定时器功能模块*/
-    select_engine_create(&queue_entity.engine);
-    pthread_create(&timer_pid, NULL, select_engine_thread, queue_entity.engine);
+    /*启动事件引擎组来实现定时器功能模块，直播间按照房间号分配到其中一个引擎*/
+    if (select_engine_group_create(&loops, BLIVE_QUEUE_LOOP_NUM, SELECT_BACKEND_AUTO) != BLIVE_ERR_OK) {
+        blive_loge("事件引擎创建失败！");
+        return ERROR;
+    }
+    if (select_engine_group_start(loops, True) != BLIVE_ERR_OK) {
+        blive_loge("事件引擎线程启动失败！");
+        return ERROR;
+    }
+    queue_entity.engine = select_engine_group_pick(loops, SELECT_GROUP_HASH, queue_entity.conf.room_id);
 
-    /*http服务器初始化*/
-    http_create(&queue_entity.httpd, "127.0.0.1", 9000);
+    /*http服务器初始化，分配到负载最小的引擎，不占用主线程*/
+    httpd_engine = select_engine_group_pick(loops, SELECT_GROUP_LEAST_LOAD, 0);
+    if (http_create(&queue_entity.httpd, httpd_engine, "127.0.0.1", 9000) != BLIVE_ERR_OK) {
+        blive_loge("http服务器创建失败！");
+        return ERROR;
+    }
 
     /*callbacks初始化*/
     if (callbacks_init(&queue_entity)) {
@@ -191,19 +190,23 @@ int main(void)
     /*启动监听*/
     pthread_create(&queue_entity.conf.thread_id, NULL, blive_thread, queue_entity.conf.room_entity);
 
-    http_perform(queue_entity.httpd);
+    /*开始接受http连接，之后主线程等待直播间监听结束*/
+    if (http_perform(queue_entity.httpd) != BLIVE_ERR_OK) {
+        blive_loge("http服务器启动失败！");
+        return ERROR;
+    }
 
     /*结束bilibili直播间解析模块*/
-    blive_force_stop(queue_entity.conf.room_entity);
     pthread_join(queue_entity.conf.thread_id, &thrd_ret);
     blive_close_connection(queue_entity.conf.room_entity);
     blive_destroy(queue_entity.conf.room_entity);
     blive_api_deinit();
 
     /*结束定时器功能模块*/
-    select_engine_stop(queue_entity.engine);
-    pthread_join(timer_pid, &thrd_ret);
-    select_engine_destroy(queue_entity.engine);
+    select_engine_group_stop(loops);
+    http_destroy(queue_entity.httpd);
+    select_engine_group_release(loops, httpd_engine);
+    select_engine_group_destroy(loops);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,242 @@
+/**
+ * @file cpri_queue.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 并发优先级队列。每个生产者线程第一次入队时登记自己的收件队列，之后入队
+ *        只在自己的缓存行上做一次原子交换，生产者之间没有共享的写入；堆只属于消费
+ *        者，消费者每次peek/pop前依次把所有收件队列中的新节点并入堆，因此不需要锁。
+ * @version 0.1
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "cpri_queue.h"
+#include "dary_heap.h"
+
+
+#define CPRI_HEAP_ARITY     4   /* 16字节的元素，一个节点的子节点正好占一个缓存行 */
+#define CPRI_INBOX_ALIGN    64  /* 收件队列按缓存行对齐，不同生产者之间没有伪共享 */
+#define CPRI_TLS_NUM        4   /* 每个线程缓存的收件队列数，即同时入队的队列数量 */
+
+PRI_QUEUE_DEFINE_KEYED(cpri_heap, CPRI_HEAP_ARITY)
+
+/* 一个生产者线程的收件队列，只有所属线程入队，只有消费者出队 */
+typedef struct cpri_inbox {
+    mpsc_queue_t        queue;
+    uint32_t            pushed;     /* 所属线程入队的节点数，原子操作 */
+    const void*         owner;      /* 所属线程的缓存数组，线程退出后由复用该地址的线程继续使用 */
+    struct cpri_inbox*  next;       /* 队列中所有收件队列组成的链表，只增不减 */
+} cpri_inbox_t;
+
+struct cpri_queue {
+    uint64_t        id;         /* 全局唯一，用于线程缓存 */
+    cpri_inbox_t*   inboxes;    /* 原子操作 */
+    cpri_heap_t     heap;       /* 只有消费者访问 */
+    uint32_t        popped;     /* 消费者取出的节点数，原子操作 */
+};
+
+/* 线程缓存的收件队列，按照队列的id查找 */
+typedef struct {
+    uint64_t        queue_id;
+    cpri_inbox_t*   inbox;
+} cpri_tls_t;
+
+
+static uint64_t         cpri_queue_id = 0;
+static __thread cpri_tls_t cpri_tls[CPRI_TLS_NUM];
+
+
+static cpri_inbox_t* __cpri_queue_inbox(cpri_queue_t* queue);
+static int __cpri_queue_collect(cpri_queue_t* queue);
+
+
+int cpri_queue_create(cpri_queue_t** queue)
+{
+    cpri_queue_t*   new_queue = NULL;
+
+    if (queue == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    new_queue = zero_alloc(sizeof(cpri_queue_t));
+    if (new_queue == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    new_queue->id = __atomic_add_fetch(&cpri_queue_id, 1, __ATOMIC_RELAXED);
+    cpri_heap_init(&new_queue->heap);
+    *queue = new_queue;
+
+    return BLIVE_ERR_OK;
+}
+
+int cpri_queue_destroy(cpri_queue_t* queue)
+{
+    cpri_inbox_t*   inbox = NULL;
+    cpri_inbox_t*   next = NULL;
+
+    if (queue == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    /* 其他线程缓存中的id不会再被命中，之后直接覆盖 */
+    for (uint32_t i = 0; i < CPRI_TLS_NUM; i++) {
+        if (cpri_tls[i].queue_id == queue->id) {
+            memset(&cpri_tls[i], 0, sizeof(cpri_tls_t));
+        }
+    }
+    for (inbox = queue->inboxes; inbox != NULL; inbox = next) {
+        next = inbox->next;
+        free(inbox);
+    }
+    cpri_heap_destroy(&queue->heap);
+    free(queue);
+
+    return BLIVE_ERR_OK;
+}
+
+int cpri_queue_push(cpri_queue_t* queue, cpri_queue_node_t* node, uint64_t key)
+{
+    cpri_inbox_t*   inbox = NULL;
+
+    if (queue == NULL || node == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    inbox = __cpri_queue_inbox(queue);
+    if (inbox == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    node->key = key;
+    /* 计数只有所属线程写入，不需要原子加 */
+    __atomic_store_n(&inbox->pushed, inbox->pushed + 1, __ATOMIC_RELAXED);
+    mpsc_queue_push(&inbox->queue, &node->link);
+
+    return BLIVE_ERR_OK;
+}
+
+int cpri_queue_peek(cpri_queue_t* queue, cpri_queue_node_t** node)
+{
+    blive_errno_t       retval = BLIVE_ERR_OK;
+    dary_heap_key_t*    top = NULL;
+
+    if (queue == NULL || node == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    retval = __cpri_queue_collect(queue);
+    top = cpri_heap_peek(&queue->heap);
+    if (top == NULL) {
+        *node = NULL;
+        return (retval != BLIVE_ERR_OK) ? retval : BLIVE_ERR_RESOURCE;
+    }
+    *node = (cpri_queue_node_t*)top->data;
+
+    return BLIVE_ERR_OK;
+}
+
+int cpri_queue_pop(cpri_queue_t* queue, cpri_queue_node_t** node)
+{
+    blive_errno_t       retval = BLIVE_ERR_OK;
+    dary_heap_key_t     top;
+
+    if (queue == NULL || node == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    retval = __cpri_queue_collect(queue);
+    if (cpri_heap_pop(&queue->heap, &top) != BLIVE_ERR_OK) {
+        *node = NULL;
+        return (retval != BLIVE_ERR_OK) ? retval : BLIVE_ERR_RESOURCE;
+    }
+    __atomic_store_n(&queue->popped, queue->popped + 1, __ATOMIC_RELAXED);
+    *node = (cpri_queue_node_t*)top.data;
+
+    return BLIVE_ERR_OK;
+}
+
+uint32_t cpri_queue_size(const cpri_queue_t* queue)
+{
+    cpri_inbox_t*   inbox = NULL;
+    uint32_t        pushed = 0;
+
+    if (queue == NULL) {
+        return 0;
+    }
+
+    for (inbox = __atomic_load_n(&queue->inboxes, __ATOMIC_ACQUIRE); inbox != NULL; inbox = inbox->next) {
+        pushed += __atomic_load_n(&inbox->pushed, __ATOMIC_RELAXED);
+    }
+
+    return pushed - __atomic_load_n(&queue->popped, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * @brief 获取当前线程在队列中的收件队列，第一次入队时登记
+ *
+ * @param [in] queue 队列
+ * @return cpri_inbox_t* 内存不足时返回NULL
+ */
+static cpri_inbox_t* __cpri_queue_inbox(cpri_queue_t* queue)
+{
+    cpri_tls_t*     slot = &cpri_tls[queue->id % CPRI_TLS_NUM];
+    cpri_inbox_t*   inbox = NULL;
+    void*           mem = NULL;
+
+    if (slot->queue_id == queue->id) {
+        return slot->inbox;
+    }
+
+    /* 缓存被其他队列覆盖过时找回原来的收件队列 */
+    for (inbox = __atomic_load_n(&queue->inboxes, __ATOMIC_ACQUIRE); inbox != NULL; inbox = inbox->next) {
+        if (inbox->owner == cpri_tls) {
+            break;
+        }
+    }
+    if (inbox == NULL) {
+        if (posix_memalign(&mem, CPRI_INBOX_ALIGN, (sizeof(cpri_inbox_t) + CPRI_INBOX_ALIGN - 1) / CPRI_INBOX_ALIGN * CPRI_INBOX_ALIGN)) {
+            return NULL;
+        }
+        /* 按整个缓存行申请，与其他内存不共享缓存行 */
+        inbox = (cpri_inbox_t*)mem;
+        memset(inbox, 0, sizeof(cpri_inbox_t));
+        mpsc_queue_init(&inbox->queue);
+        inbox->owner = cpri_tls;
+        inbox->next = __atomic_load_n(&queue->inboxes, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&queue->inboxes, &inbox->next, inbox, True, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            ;
+        }
+    }
+    slot->queue_id = queue->id;
+    slot->inbox = inbox;
+
+    return inbox;
+}
+
+/**
+ * @brief 将所有收件队列中的节点全部并入堆
+ *
+ * @param [in] queue 队列
+ * @return int 堆扩容失败时返回BLIVE_ERR_OUTOFMEM，失败的节点放回原来的收件队列，下次再并入
+ */
+static int __cpri_queue_collect(cpri_queue_t* queue)
+{
+    cpri_inbox_t*       inbox = NULL;
+    mpsc_node_t*        link = NULL;
+    cpri_queue_node_t*  node = NULL;
+    dary_heap_key_t     elem;
+
+    for (inbox = __atomic_load_n(&queue->inboxes, __ATOMIC_ACQUIRE); inbox != NULL; inbox = inbox->next) {
+        while ((link = mpsc_queue_pop(&inbox->queue)) != NULL) {
+            node = list_entry(link, cpri_queue_node_t, link);
+            elem.key = node->key;
+            elem.data = node;
+            if (cpri_heap_push(&queue->heap, &elem) != BLIVE_ERR_OK) {
+                mpsc_queue_push(&inbox->queue, link);
+                return BLIVE_ERR_OUTOFMEM;
+            }
+        }
+    }
+
+    return BLIVE_ERR_OK;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file cpri_queue.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 多生产者单消费者的并发优先级队列。每个生产者线程把节点放入自己的无锁
+ *        收件队列，消费者在peek/pop时取出新节点并并入只有自己访问的d叉堆，生产者
+ *        之间、生产者与消费者之间都不加锁，也不会互相等待。
+ * @attention 任意线程都可以入队，但同一时刻只能有一个线程调用peek/pop。节点内嵌
+ * 在调用者的结构体中，入队后到出队前不能释放或再次入队。每个入队过的线程在队列
+ * 中登记一个收件队列，随队列一起释放。
+ * @version 0.1
+ * @date 2023-03-22
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_CPRI_QUEUE_H__
+#define __UTILS_CPRI_QUEUE_H__
+
+#include "utils.h"
+#include "mpsc_queue.h"
+
+
+/**
+ * @brief 队列节点，内嵌到调用者的结构体中，通过container_of取回
+ *
+ */
+typedef struct {
+    mpsc_node_t     link;       /* 入队时所在的MPSC队列的节点 */
+    uint64_t        key;        /* 优先级键，越小优先级越高 */
+} cpri_queue_node_t;
+
+typedef struct cpri_queue cpri_queue_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 创建并发优先级队列
+ *
+ * @param [out] queue 传出参数，队列
+ * @return int
+ */
+int cpri_queue_create(cpri_queue_t** queue);
+
+/**
+ * @brief 销毁队列，队列中剩余的节点由调用者负责释放
+ *
+ * @param [in] queue 队列
+ * @return int
+ */
+int cpri_queue_destroy(cpri_queue_t* queue);
+
+/**
+ * @brief 入队，任意线程均可调用，不加锁，只有线程第一次入队时申请收件队列
+ *
+ * @param [in] queue 队列
+ * @param [in] node 节点
+ * @param [in] key 优先级键，越小优先级越高
+ * @return int 登记收件队列时内存不足返回BLIVE_ERR_OUTOFMEM
+ */
+int cpri_queue_push(cpri_queue_t* queue, cpri_queue_node_t* node, uint64_t key);
+
+/**
+ * @brief 查看优先级最高的节点，只能由消费者线程调用
+ * @note 正在入队过程中的节点可能暂时不可见
+ *
+ * @param [in] queue 队列
+ * @param [out] node 传出参数，优先级最高的节点
+ * @return int 队列为空时返回BLIVE_ERR_RESOURCE
+ */
+int cpri_queue_peek(cpri_queue_t* queue, cpri_queue_node_t** node);
+
+/**
+ * @brief 取出优先级最高的节点，只能由消费者线程调用
+ *
+ * @param [in] queue 队列
+ * @param [out] node 传出参数，优先级最高的节点
+ * @return int 队列为空时返回BLIVE_ERR_RESOURCE
+ */
+int cpri_queue_pop(cpri_queue_t* queue, cpri_queue_node_t** node);
+
+/**
+ * @brief 获取队列中的节点数量，包括尚未并入堆的节点，并发时只是一个近似值
+ *
+ * @param [in] queue 队列
+ * @return uint32_t 节点数量
+ */
+uint32_t cpri_queue_size(const cpri_queue_t* queue);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,184 @@
+/**
+ * @file dary_heap.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 按类型生成的d叉堆。与pri_queue不同，元素按值直接存放在数组中，比较
+ *        函数在编译期展开为内联代码，不经过函数指针。
+ * @attention 数组整体偏移arity-1个元素，使每个节点的arity个子节点从arity的整数
+ * 倍处开始，数组又按缓存行对齐，因此元素大小为16字节、arity为4时，一个节点的全
+ * 部子节点正好位于同一个缓存行中。堆本身不加锁。
+ * @version 0.1
+ * @date 2023-03-20
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_DARY_HEAP_H__
+#define __UTILS_DARY_HEAP_H__
+
+#include "utils.h"
+
+
+#define DARY_HEAP_ALIGN         64      /* 数组的对齐，与缓存行大小一致 */
+#define DARY_HEAP_MIN_SIZE      16      /* 首次扩容时的容量 */
+
+/* 以64位整数为键的堆元素，键越小优先级越高 */
+typedef struct {
+    uint64_t    key;
+    void*       data;
+} dary_heap_key_t;
+
+#define DARY_HEAP_KEY_LESS(a, b)    ((a)->key < (b)->key)
+
+
+/**
+ * @brief 生成一个d叉堆类型及其操作函数，所有函数均为static inline
+ *
+ * @param name 生成的类型为name##_t，函数以name##_为前缀
+ * @param type 元素类型，按值拷贝
+ * @param less 比较宏或内联函数，less(const type* a, const type* b)为真表示a的优先级更高
+ * @param arity 每个节点的子节点数，建议为4或8
+ *
+ * 生成的函数：
+ *   void     name##_init(name##_t* heap);
+ *   void     name##_destroy(name##_t* heap);
+ *   int      name##_reserve(name##_t* heap, uint32_t capacity);
+ *   int      name##_push(name##_t* heap, const type* elem);
+ *   int      name##_pop(name##_t* heap, type* elem);
+ *   type*    name##_peek(name##_t* heap);
+ *   uint32_t name##_size(const name##_t* heap);
+ */
+#define PRI_QUEUE_DEFINE(name, type, less, arity)                                   \
+                                                                                    \
+typedef char name##_arity_check[((arity) >= 2) ? 1 : -1];                           \
+                                                                                    \
+typedef struct {                                                                    \
+    type*       mem;        /* 申请的内存，按缓存行对齐 */                          \
+    type*       elems;      /* 堆的第0个元素，位于mem + arity - 1 */                \
+    uint32_t    size;       /* 当前元素个数 */                                      \
+    uint32_t    capacity;   /* 不扩容时最多能保存的元素个数 */                      \
+} name##_t;                                                                         \
+                                                                                    \
+static inline void name##_init(name##_t* heap)                                      \
+{                                                                                   \
+    memset(heap, 0, sizeof(name##_t));                                              \
+}                                                                                   \
+                                                                                    \
+static inline void name##_destroy(name##_t* heap)                                   \
+{                                                                                   \
+    free(heap->mem);                                                                \
+    memset(heap, 0, sizeof(name##_t));                                              \
+}                                                                                   \
+                                                                                    \
+static inline int name##_reserve(name##_t* heap, uint32_t capacity)                 \
+{                                                                                   \
+    void*       mem = NULL;                                                         \
+                                                                                    \
+    if (capacity <= heap->capacity) {                                               \
+        return BLIVE_ERR_OK;                                                        \
+    }                                                                               \
+    if ((size_t)capacity + (arity) > SIZE_MAX / sizeof(type)) {                     \
+        return BLIVE_ERR_OUTOFMEM;                                                  \
+    }                                                                               \
+    /* realloc不保证对齐，只能重新申请后拷贝 */                                     \
+    if (posix_memalign(&mem, DARY_HEAP_ALIGN, ((size_t)capacity + (arity) - 1) * sizeof(type))) { \
+        return BLIVE_ERR_OUTOFMEM;                                                  \
+    }                                                                               \
+    if (heap->size) {                                                               \
+        memcpy((type*)mem + (arity) - 1, heap->elems, heap->size * sizeof(type));   \
+    }                                                                               \
+    free(heap->mem);                                                                \
+    heap->mem = (type*)mem;                                                         \
+    heap->elems = heap->mem + (arity) - 1;                                          \
+    heap->capacity = capacity;                                                      \
+                                                                                    \
+    return BLIVE_ERR_OK;                                                            \
+}                                                                                   \
+                                                                                    \
+static inline int name##_push(name##_t* heap, const type* elem)                     \
+{                                                                                   \
+    type*       elems = NULL;                                                       \
+    uint32_t    index = heap->size;                                                 \
+    uint32_t    parent = 0;                                                         \
+    int         retval = BLIVE_ERR_OK;                                              \
+                                                                                    \
+    if (heap->size == heap->capacity) {                                             \
+        if (heap->capacity > UINT32_MAX / 2) {                                      \
+            return BLIVE_ERR_OUTOFMEM;                                              \
+        }                                                                           \
+        retval = name##_reserve(heap, heap->capacity ? heap->capacity * 2 : DARY_HEAP_MIN_SIZE); \
+        if (retval != BLIVE_ERR_OK) {                                               \
+            return retval;                                                          \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    /* 上浮，父节点依次下移，最后再放入新元素 */                                    \
+    elems = heap->elems;                                                            \
+    while (index > 0) {                                                             \
+        parent = (index - 1) / (arity);                                             \
+        if (!less(elem, &elems[parent])) {                                          \
+            break;                                                                  \
+        }                                                                           \
+        elems[index] = elems[parent];                                               \
+        index = parent;                                                             \
+    }                                                                               \
+    elems[index] = *elem;                                                           \
+    heap->size++;                                                                   \
+                                                                                    \
+    return BLIVE_ERR_OK;                                                            \
+}                                                                                   \
+                                                                                    \
+static inline type* name##_peek(name##_t* heap)                                     \
+{                                                                                   \
+    return heap->size ? &heap->elems[0] : NULL;                                     \
+}                                                                                   \
+                                                                                    \
+static inline int name##_pop(name##_t* heap, type* elem)                            \
+{                                                                                   \
+    type*       elems = heap->elems;                                                \
+    type*       tail = NULL;                                                        \
+    uint32_t    index = 0;                                                          \
+    uint32_t    child = 0;                                                          \
+    uint32_t    best = 0;                                                           \
+    uint32_t    last = 0;                                                           \
+                                                                                    \
+    if (!heap->size) {                                                              \
+        return BLIVE_ERR_RESOURCE;                                                  \
+    }                                                                               \
+    if (elem != NULL) {                                                             \
+        *elem = elems[0];                                                           \
+    }                                                                               \
+                                                                                    \
+    /* 下沉，用尾部元素填补堆顶，在同一缓存行的子节点中选出优先级最高的 */          \
+    heap->size--;                                                                   \
+    tail = &elems[heap->size];                                                      \
+    while ((child = index * (arity) + 1) < heap->size) {                            \
+        best = child;                                                               \
+        last = min(child + (arity), heap->size);                                    \
+        for (child++; child < last; child++) {                                      \
+            if (less(&elems[child], &elems[best])) {                                \
+                best = child;                                                       \
+            }                                                                       \
+        }                                                                           \
+        if (!less(&elems[best], tail)) {                                            \
+            break;                                                                  \
+        }                                                                           \
+        elems[index] = elems[best];                                                 \
+        index = best;                                                               \
+    }                                                                               \
+    elems[index] = *tail;                                                           \
+                                                                                    \
+    return BLIVE_ERR_OK;                                                            \
+}                                                                                   \
+                                                                                    \
+static inline uint32_t name##_size(const name##_t* heap)                            \
+{                                                                                   \
+    return heap->size;                                                              \
+}
+
+/**
+ * @brief 生成以64位整数为键的d叉堆，元素类型为dary_heap_key_t
+ */
+#define PRI_QUEUE_DEFINE_KEYED(name, arity)     \
+    PRI_QUEUE_DEFINE(name, dary_heap_key_t, DARY_HEAP_KEY_LESS, arity)
+
+#endif
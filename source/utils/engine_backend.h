@@ -0,0 +1,86 @@
+/**
+ * @file engine_backend.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief select事件引擎内部使用的IO多路复用后端接口。事件引擎只负责
+ *        fd、定时器的管理与回调，真正等待fd就绪的工作交给后端完成。
+ *        后端的所有操作都只在事件引擎线程中调用，后端内部不需要加锁。
+ * @note 仅供select.c及各个后端实现使用，不对外暴露
+ * @version 0.1
+ * @date 2023-03-12
+ *
+ * @copyright Copyright (c) 2023
+ */
+#ifndef __UTILS_ENGINE_BACKEND_H__
+#define __UTILS_ENGINE_BACKEND_H__
+
+#include "utils.h"
+#include "select.h"
+
+
+#if defined(__linux__)
+#define ENGINE_HAVE_EPOLL   1
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ENGINE_HAVE_URING   1
+#endif
+#endif
+#endif
+
+
+/* 后端一次等待最多返回的就绪fd数量 */
+#define ENGINE_BACKEND_MAX_READY    64
+
+
+typedef struct {
+    fd_t                fd;         /* 就绪的文件描述符 */
+    uint32_t            events;     /* 就绪的事件，SELECT_EVENT_READ/WRITE/ERROR的组合 */
+} engine_ready_t;
+
+typedef struct {
+    const char*     name;
+
+    /**
+     * @brief 创建后端，失败时事件引擎会尝试下一个后端
+     */
+    blive_errno_t   (*create)(void** backend);
+    void            (*destroy)(void* backend);
+
+    /**
+     * @brief 开始监视、修改监视的事件、停止监视fd。只在事件引擎线程中调用
+     *
+     * @param [in] events SELECT_EVENT_READ/WRITE/EDGE的组合，出错总是会上报。
+     *             不支持边缘触发的后端忽略SELECT_EVENT_EDGE
+     */
+    blive_errno_t   (*fd_add)(void* backend, fd_t fd, uint32_t events);
+    blive_errno_t   (*fd_mod)(void* backend, fd_t fd, uint32_t events);
+    blive_errno_t   (*fd_del)(void* backend, fd_t fd);
+
+    /**
+     * @brief 等待fd就绪
+     *
+     * @param [in] backend 后端实体
+     * @param [in] timeout_us 等待时长，单位微秒us，小于0表示一直等待
+     * @param [out] ready 就绪的fd
+     * @param [in] max_ready ready数组的大小
+     * @return int32_t 就绪的fd数量，0表示超时，小于0表示被中断
+     */
+    int32_t         (*wait)(void* backend, int64_t timeout_us, engine_ready_t* ready, int32_t max_ready);
+} engine_backend_ops;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const engine_backend_ops engine_backend_select;
+#ifdef ENGINE_HAVE_EPOLL
+extern const engine_backend_ops engine_backend_epoll;
+#endif
+#ifdef ENGINE_HAVE_URING
+extern const engine_backend_ops engine_backend_uring;
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif
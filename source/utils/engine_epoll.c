@@ -0,0 +1,133 @@
+/**
+ * @file engine_epoll.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 基于epoll的事件引擎后端。fd的监视在内核中常驻，不需要每次等待前
+ *        重新构建fd集合，在io_uring不可用时使用
+ * @note 仅支持Linux
+ * @version 0.1
+ * @date 2023-03-12
+ *
+ * @copyright Copyright (c) 2023
+ */
+#include "engine_backend.h"
+
+#ifdef ENGINE_HAVE_EPOLL
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+
+typedef struct {
+    int                 epoll_fd;
+} epoll_backend_t;
+
+
+static blive_errno_t __epoll_create(void** backend)
+{
+    epoll_backend_t*    new_backend = NULL;
+
+    new_backend = zero_alloc(sizeof(epoll_backend_t));
+    if (new_backend == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+
+    new_backend->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (new_backend->epoll_fd < 0) {
+        blive_loge("epoll_create1 failed(%s)", strerror(errno));
+        free(new_backend);
+        return BLIVE_ERR_UNKNOWN;
+    }
+
+    *backend = new_backend;
+    return BLIVE_ERR_OK;
+}
+
+static void __epoll_destroy(void* backend)
+{
+    epoll_backend_t*    ep = (epoll_backend_t*)backend;
+
+    close(ep->epoll_fd);
+    free(ep);
+}
+
+static inline uint32_t __epoll_events(uint32_t events)
+{
+    return ((events & SELECT_EVENT_READ) ? EPOLLIN | EPOLLRDHUP : 0) |
+           ((events & SELECT_EVENT_WRITE) ? EPOLLOUT : 0) |
+           ((events & SELECT_EVENT_EDGE) ? EPOLLET : 0);
+}
+
+static blive_errno_t __epoll_fd_add(void* backend, fd_t fd, uint32_t events)
+{
+    epoll_backend_t*    ep = (epoll_backend_t*)backend;
+    struct epoll_event  event = {.events = __epoll_events(events), .data.fd = fd};
+
+    if (epoll_ctl(ep->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        /* fd关闭后epoll会自动移除监视，之前的删除可能没有执行，此时改为修改 */
+        if (errno == EEXIST && epoll_ctl(ep->epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0) {
+            return BLIVE_ERR_OK;
+        }
+        blive_loge("epoll add fd=%d failed(%s)", fd, strerror(errno));
+        return BLIVE_ERR_UNKNOWN;
+    }
+    return BLIVE_ERR_OK;
+}
+
+static blive_errno_t __epoll_fd_mod(void* backend, fd_t fd, uint32_t events)
+{
+    epoll_backend_t*    ep = (epoll_backend_t*)backend;
+    struct epoll_event  event = {.events = __epoll_events(events), .data.fd = fd};
+
+    if (epoll_ctl(ep->epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0) {
+        blive_loge("epoll modify fd=%d failed(%s)", fd, strerror(errno));
+        return errno == ENOENT ? BLIVE_ERR_NOTEXSIT : BLIVE_ERR_UNKNOWN;
+    }
+    return BLIVE_ERR_OK;
+}
+
+static blive_errno_t __epoll_fd_del(void* backend, fd_t fd)
+{
+    epoll_backend_t*    ep = (epoll_backend_t*)backend;
+
+    if (epoll_ctl(ep->epoll_fd, EPOLL_CTL_DEL, fd, NULL) < 0) {
+        return BLIVE_ERR_NOTEXSIT;
+    }
+    return BLIVE_ERR_OK;
+}
+
+static int32_t __epoll_wait(void* backend, int64_t timeout_us, engine_ready_t* ready, int32_t max_ready)
+{
+    epoll_backend_t*    ep = (epoll_backend_t*)backend;
+    struct epoll_event  events[ENGINE_BACKEND_MAX_READY];
+    int                 timeout_ms = -1;
+    int32_t             ready_num = 0;
+
+    if (timeout_us >= 0) {
+        /* epoll只支持毫秒精度，向上取整避免定时器提前醒来空转 */
+        timeout_ms = (int)((timeout_us + 999) / 1000);
+    }
+
+    ready_num = epoll_wait(ep->epoll_fd, events, min(max_ready, ENGINE_BACKEND_MAX_READY), timeout_ms);
+    for (int32_t i = 0; i < ready_num; i++) {
+        uint32_t    revents = events[i].events;
+
+        ready[i].fd = events[i].data.fd;
+        ready[i].events = ((revents & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) ? SELECT_EVENT_READ : 0) |
+                          ((revents & EPOLLOUT) ? SELECT_EVENT_WRITE : 0) |
+                          ((revents & (EPOLLERR | EPOLLHUP)) ? SELECT_EVENT_ERROR : 0);
+    }
+
+    return ready_num;
+}
+
+
+const engine_backend_ops engine_backend_epoll = {
+    .name = "epoll",
+    .create = __epoll_create,
+    .destroy = __epoll_destroy,
+    .fd_add = __epoll_fd_add,
+    .fd_mod = __epoll_fd_mod,
+    .fd_del = __epoll_fd_del,
+    .wait = __epoll_wait,
+};
+#endif
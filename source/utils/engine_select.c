@@ -0,0 +1,192 @@
+/**
+ * @file engine_select.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 基于select的事件引擎后端，所有平台可用，作为最后的回退方案
+ * @version 0.1
+ * @date 2023-03-12
+ *
+ * @copyright Copyright (c) 2023
+ */
+#include <errno.h>
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#endif
+
+#include "engine_backend.h"
+
+
+typedef struct {
+    fd_t                fd;
+    uint32_t            events;         /* 监视的事件，SELECT_EVENT_* */
+} select_watch_t;
+
+/* 所有操作都在事件引擎线程中执行，不需要加锁 */
+typedef struct {
+    select_watch_t*     fds;            /* 正在监视的fd */
+    int32_t             fd_num;
+    int32_t             fd_max_num;
+} select_poller_t;
+
+
+static blive_errno_t __select_create(void** backend)
+{
+    select_poller_t*   new_backend = NULL;
+
+    new_backend = zero_alloc(sizeof(select_poller_t));
+    if (new_backend == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+
+    *backend = new_backend;
+    return BLIVE_ERR_OK;
+}
+
+static void __select_destroy(void* backend)
+{
+    select_poller_t*   sel = (select_poller_t*)backend;
+
+    free(sel->fds);
+    free(sel);
+}
+
+/**
+ * @brief 查找fd在监视列表中的位置
+ *
+ * @return int32_t 不在列表中时返回-1
+ */
+static int32_t __select_fd_find(select_poller_t* sel, fd_t fd)
+{
+    for (int32_t i = 0; i < sel->fd_num; i++) {
+        if (sel->fds[i].fd == fd) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static blive_errno_t __select_fd_add(void* backend, fd_t fd, uint32_t events)
+{
+    select_poller_t*   sel = (select_poller_t*)backend;
+    blive_errno_t       retval = BLIVE_ERR_OK;
+    int32_t             index = 0;
+
+    index = __select_fd_find(sel, fd);
+    if (index >= 0) {
+        sel->fds[index].events = events;
+        goto _out;
+    }
+    if (sel->fd_num == FD_SETSIZE) {
+        retval = BLIVE_ERR_RESOURCE;
+        goto _out;
+    }
+    if (sel->fd_num == sel->fd_max_num) {
+        int32_t             new_max = sel->fd_max_num ? sel->fd_max_num * 2 : 16;
+        select_watch_t*     new_fds = realloc(sel->fds, new_max * sizeof(select_watch_t));
+
+        if (new_fds == NULL) {
+            retval = BLIVE_ERR_OUTOFMEM;
+            goto _out;
+        }
+        sel->fds = new_fds;
+        sel->fd_max_num = new_max;
+    }
+    sel->fds[sel->fd_num].fd = fd;
+    sel->fds[sel->fd_num].events = events;
+    sel->fd_num++;
+
+_out:
+    return retval;
+}
+
+static blive_errno_t __select_fd_mod(void* backend, fd_t fd, uint32_t events)
+{
+    select_poller_t*   sel = (select_poller_t*)backend;
+    blive_errno_t       retval = BLIVE_ERR_NOTEXSIT;
+    int32_t             index = 0;
+
+    index = __select_fd_find(sel, fd);
+    if (index >= 0) {
+        sel->fds[index].events = events;
+        retval = BLIVE_ERR_OK;
+    }
+    return retval;
+}
+
+static blive_errno_t __select_fd_del(void* backend, fd_t fd)
+{
+    select_poller_t*   sel = (select_poller_t*)backend;
+    blive_errno_t       retval = BLIVE_ERR_NOTEXSIT;
+    int32_t             index = 0;
+
+    index = __select_fd_find(sel, fd);
+    if (index >= 0) {
+        sel->fds[index] = sel->fds[--sel->fd_num];
+        retval = BLIVE_ERR_OK;
+    }
+    return retval;
+}
+
+static int32_t __select_wait(void* backend, int64_t timeout_us, engine_ready_t* ready, int32_t max_ready)
+{
+    select_poller_t*   sel = (select_poller_t*)backend;
+    fd_set              read_fds;
+    fd_set              write_fds;
+    fd_set              except_fds;
+    fd_t                max_fd = 0;
+    struct timeval      tm_wait;
+    int32_t             select_ret = 0;
+    int32_t             ready_num = 0;
+    uint32_t            events = 0;
+
+    /* 初始化需要监听的文件描述符，出错通过可读、可写或异常集合反映出来 */
+    FD_ZERO(&read_fds);
+    FD_ZERO(&write_fds);
+    FD_ZERO(&except_fds);
+    for (int32_t i = 0; i < sel->fd_num; i++) {
+#ifndef WIN32
+        max_fd = max(max_fd, sel->fds[i].fd);
+#endif
+        if (sel->fds[i].events & SELECT_EVENT_READ) {
+            FD_SET(sel->fds[i].fd, &read_fds);
+        }
+        if (sel->fds[i].events & SELECT_EVENT_WRITE) {
+            FD_SET(sel->fds[i].fd, &write_fds);
+        }
+        FD_SET(sel->fds[i].fd, &except_fds);
+    }
+
+    if (timeout_us >= 0) {
+        tm_wait.tv_sec = timeout_us / (1000 * 1000);
+        tm_wait.tv_usec = timeout_us % (1000 * 1000);
+    }
+    select_ret = select(max_fd + 1, &read_fds, &write_fds, &except_fds, timeout_us >= 0 ? &tm_wait : NULL);
+    if (select_ret <= 0) {
+        return select_ret;
+    }
+
+    for (int32_t i = 0; i < sel->fd_num && ready_num < max_ready; i++) {
+        events = (FD_ISSET(sel->fds[i].fd, &read_fds) ? SELECT_EVENT_READ : 0) |
+                 (FD_ISSET(sel->fds[i].fd, &write_fds) ? SELECT_EVENT_WRITE : 0) |
+                 (FD_ISSET(sel->fds[i].fd, &except_fds) ? SELECT_EVENT_ERROR : 0);
+        if (events) {
+            ready[ready_num].fd = sel->fds[i].fd;
+            ready[ready_num].events = events;
+            ready_num++;
+        }
+    }
+
+    return ready_num;
+}
+
+
+const engine_backend_ops engine_backend_select = {
+    .name = "select",
+    .create = __select_create,
+    .destroy = __select_destroy,
+    .fd_add = __select_fd_add,
+    .fd_mod = __select_fd_mod,
+    .fd_del = __select_fd_del,
+    .wait = __select_wait,
+};
@@ -0,0 +1,472 @@
+/**
+ * @file engine_uring.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 基于io_uring的事件引擎后端。fd监视的增删改不会立即产生系统调用，
+ *        而是记录下来，在下一次等待时与等待本身合并为一次io_uring_enter批量
+ *        提交，等待超时通过IORING_ENTER_EXT_ARG直接传递给内核。
+ * @note 仅支持Linux 5.11及以上内核，不可用时事件引擎会回退到epoll
+ * @version 0.1
+ * @date 2023-03-12
+ *
+ * @copyright Copyright (c) 2023
+ */
+#include "engine_backend.h"
+
+#ifdef ENGINE_HAVE_URING
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+
+#define URING_ENTRIES           256
+
+#ifndef POLLRDHUP
+#define POLLRDHUP               0x2000
+#endif
+
+/* user_data的最高位表示内部操作（如POLL_REMOVE），其完成事件直接丢弃 */
+#define URING_INTERNAL_FLAG     (1ULL << 63)
+#define URING_USER_DATA(fd, gen)    (((uint64_t)(gen) << 32) | (uint32_t)(fd))
+#define URING_USER_DATA_FD(data)    ((fd_t)(uint32_t)(data))
+#define URING_USER_DATA_GEN(data)   ((uint32_t)((data) >> 32))
+
+typedef enum {
+    URING_FD_NONE,          /* 未监视 */
+    URING_FD_ARMING,        /* 等待提交POLL_ADD */
+    URING_FD_ARMED,         /* POLL_ADD已提交，等待完成 */
+} uring_fd_state;
+
+typedef struct {
+    uint32_t            gen;            /* 每次重新注册都会递增，用来识别过期的完成事件 */
+    uint32_t            state;
+    uint32_t            armed_gen;      /* 内核中尚未完成的POLL_ADD对应的gen，0表示没有 */
+    uint32_t            events;         /* 监视的事件，SELECT_EVENT_* */
+    Bool                queued;         /* 是否已在变更列表中 */
+} uring_fd_t;
+
+typedef struct {
+    int                 ring_fd;
+
+    /* 提交队列 */
+    uint32_t*           sq_head;
+    uint32_t*           sq_tail;
+    uint32_t*           sq_mask;
+    uint32_t*           sq_array;
+    struct io_uring_sqe* sqes;
+    uint32_t            sq_entries;
+
+    /* 完成队列 */
+    uint32_t*           cq_head;
+    uint32_t*           cq_tail;
+    uint32_t*           cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void*               sq_ring_ptr;
+    size_t              sq_ring_size;
+    void*               cq_ring_ptr;
+    size_t              cq_ring_size;
+    size_t              sqes_size;
+
+    /* fd状态和变更列表，与提交、完成队列一样只在事件引擎线程中访问，不需要加锁 */
+    uring_fd_t*         fds;            /* 以fd为下标 */
+    int32_t             fd_max_num;
+    fd_t*               changes;        /* 等待提交到内核的fd */
+    int32_t             change_num;
+    int32_t             change_max_num;
+    uint32_t            to_submit;      /* 已放入提交队列但尚未提交的sqe数量 */
+} uring_backend_t;
+
+
+static inline int __sys_uring_setup(uint32_t entries, struct io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline int __sys_uring_enter(int ring_fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags, void* arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static void __uring_unmap(uring_backend_t* ring)
+{
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring_ptr != NULL && ring->cq_ring_ptr != MAP_FAILED && ring->cq_ring_ptr != ring->sq_ring_ptr) {
+        munmap(ring->cq_ring_ptr, ring->cq_ring_size);
+    }
+    if (ring->sq_ring_ptr != NULL && ring->sq_ring_ptr != MAP_FAILED) {
+        munmap(ring->sq_ring_ptr, ring->sq_ring_size);
+    }
+}
+
+static blive_errno_t __uring_create(void** backend)
+{
+    uring_backend_t*        ring = NULL;
+    struct io_uring_params  params;
+
+    ring = zero_alloc(sizeof(uring_backend_t));
+    if (ring == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = __sys_uring_setup(URING_ENTRIES, &params);
+    if (ring->ring_fd < 0) {
+        blive_logi("io_uring not available(%s)", strerror(errno));
+        free(ring);
+        return BLIVE_ERR_UNKNOWN;
+    }
+
+    /* 等待超时需要通过EXT_ARG传递，SINGLE_MMAP/NODROP均早于EXT_ARG */
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        blive_logi("io_uring lacks IORING_FEAT_EXT_ARG, features=0x%x", params.features);
+        goto _failed;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_ring_size = max(ring->sq_ring_size, ring->cq_ring_size);
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring_ptr = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring_ptr == MAP_FAILED) {
+        goto _failed;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring_ptr = ring->sq_ring_ptr;
+    } else {
+        ring->cq_ring_ptr = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring_ptr == MAP_FAILED) {
+            goto _failed;
+        }
+    }
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        goto _failed;
+    }
+
+    ring->sq_head = (uint32_t*)((char*)ring->sq_ring_ptr + params.sq_off.head);
+    ring->sq_tail = (uint32_t*)((char*)ring->sq_ring_ptr + params.sq_off.tail);
+    ring->sq_mask = (uint32_t*)((char*)ring->sq_ring_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (uint32_t*)((char*)ring->sq_ring_ptr + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = (uint32_t*)((char*)ring->cq_ring_ptr + params.cq_off.head);
+    ring->cq_tail = (uint32_t*)((char*)ring->cq_ring_ptr + params.cq_off.tail);
+    ring->cq_mask = (uint32_t*)((char*)ring->cq_ring_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)((char*)ring->cq_ring_ptr + params.cq_off.cqes);
+
+    *backend = ring;
+    return BLIVE_ERR_OK;
+
+_failed:
+    __uring_unmap(ring);
+    close(ring->ring_fd);
+    free(ring);
+    return BLIVE_ERR_UNKNOWN;
+}
+
+static void __uring_destroy(void* backend)
+{
+    uring_backend_t*    ring = (uring_backend_t*)backend;
+
+    __uring_unmap(ring);
+    close(ring->ring_fd);
+    free(ring->fds);
+    free(ring->changes);
+    free(ring);
+}
+
+/**
+ * @brief 获取fd的状态描述，必要时扩容
+ */
+static uring_fd_t* __uring_fd_slot(uring_backend_t* ring, fd_t fd, Bool create)
+{
+    if (fd >= ring->fd_max_num) {
+        int32_t         new_max = ring->fd_max_num ? ring->fd_max_num : 64;
+        uring_fd_t*     new_fds = NULL;
+
+        if (!create) {
+            return NULL;
+        }
+        while (new_max <= fd) {
+            new_max *= 2;
+        }
+        new_fds = realloc(ring->fds, new_max * sizeof(uring_fd_t));
+        if (new_fds == NULL) {
+            return NULL;
+        }
+        memset(new_fds + ring->fd_max_num, 0, (new_max - ring->fd_max_num) * sizeof(uring_fd_t));
+        ring->fds = new_fds;
+        ring->fd_max_num = new_max;
+    }
+    return &ring->fds[fd];
+}
+
+/**
+ * @brief 记录一个需要在下一次等待时提交给内核的fd
+ */
+static blive_errno_t __uring_queue_change(uring_backend_t* ring, fd_t fd, uring_fd_t* slot)
+{
+    if (slot->queued) {
+        return BLIVE_ERR_OK;
+    }
+    if (ring->change_num == ring->change_max_num) {
+        int32_t     new_max = ring->change_max_num ? ring->change_max_num * 2 : 32;
+        fd_t*       new_changes = realloc(ring->changes, new_max * sizeof(fd_t));
+
+        if (new_changes == NULL) {
+            return BLIVE_ERR_OUTOFMEM;
+        }
+        ring->changes = new_changes;
+        ring->change_max_num = new_max;
+    }
+    ring->changes[ring->change_num++] = fd;
+    slot->queued = True;
+    return BLIVE_ERR_OK;
+}
+
+static inline void __uring_fd_rearm(uring_fd_t* slot)
+{
+    slot->gen = (slot->gen + 1) & 0x7fffffff;
+    slot->gen = slot->gen ? slot->gen : 1;
+    slot->state = URING_FD_ARMING;
+}
+
+static blive_errno_t __uring_fd_add(void* backend, fd_t fd, uint32_t events)
+{
+    uring_backend_t*    ring = (uring_backend_t*)backend;
+    uring_fd_t*         slot = NULL;
+    blive_errno_t       retval = BLIVE_ERR_OK;
+
+    slot = __uring_fd_slot(ring, fd, True);
+    if (slot == NULL) {
+        retval = BLIVE_ERR_OUTOFMEM;
+    } else if (slot->state == URING_FD_NONE || slot->events != events) {
+        /* 已经提交的POLL_ADD监视的事件不同，换一个gen使其在提交时被移除 */
+        slot->events = events;
+        __uring_fd_rearm(slot);
+        retval = __uring_queue_change(ring, fd, slot);
+    }
+
+    return retval;
+}
+
+static blive_errno_t __uring_fd_mod(void* backend, fd_t fd, uint32_t events)
+{
+    uring_backend_t*    ring = (uring_backend_t*)backend;
+    uring_fd_t*         slot = NULL;
+
+    slot = __uring_fd_slot(ring, fd, False);
+    if (slot == NULL || slot->state == URING_FD_NONE) {
+        return BLIVE_ERR_NOTEXSIT;
+    }
+
+    return __uring_fd_add(backend, fd, events);
+}
+
+static blive_errno_t __uring_fd_del(void* backend, fd_t fd)
+{
+    uring_backend_t*    ring = (uring_backend_t*)backend;
+    uring_fd_t*         slot = NULL;
+    blive_errno_t       retval = BLIVE_ERR_OK;
+
+    slot = __uring_fd_slot(ring, fd, False);
+    if (slot == NULL || slot->state == URING_FD_NONE) {
+        retval = BLIVE_ERR_NOTEXSIT;
+    } else {
+        /* 内核中仍有POLL_ADD时，需要在下一次等待时提交POLL_REMOVE */
+        slot->state = URING_FD_NONE;
+        if (slot->armed_gen) {
+            retval = __uring_queue_change(ring, fd, slot);
+        }
+    }
+
+    return retval;
+}
+
+static struct io_uring_sqe* __uring_get_sqe(uring_backend_t* ring)
+{
+    uint32_t                head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    uint32_t                tail = *ring->sq_tail;
+    uint32_t                index = 0;
+    struct io_uring_sqe*    sqe = NULL;
+
+    if (tail - head >= ring->sq_entries) {
+        /* 提交队列已满，先把已有的提交掉 */
+        if (__sys_uring_enter(ring->ring_fd, ring->to_submit, 0, 0, NULL, 0) < 0) {
+            return NULL;
+        }
+        ring->to_submit = 0;
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    index = tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+
+    return sqe;
+}
+
+/**
+ * @brief 将变更列表转换为sqe
+ */
+static void __uring_flush_changes(uring_backend_t* ring)
+{
+    struct io_uring_sqe*    sqe = NULL;
+    int32_t                 count = 0;
+
+    for (count = 0; count < ring->change_num; count++) {
+        fd_t            fd = ring->changes[count];
+        uring_fd_t*     slot = &ring->fds[fd];
+
+        if (slot->armed_gen && (slot->state == URING_FD_NONE || slot->armed_gen != slot->gen)) {
+            sqe = __uring_get_sqe(ring);
+            if (sqe == NULL) {
+                break;
+            }
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = URING_USER_DATA(fd, slot->armed_gen);
+            sqe->user_data = URING_INTERNAL_FLAG;
+            slot->armed_gen = 0;
+        }
+        if (slot->state == URING_FD_ARMING) {
+            sqe = __uring_get_sqe(ring);
+            if (sqe == NULL) {
+                break;
+            }
+            /* 使用单次POLL_ADD，完成后在下一次等待时重新提交，保持与select一致的水平触发语义，
+               因此不支持边缘触发 */
+            uint32_t    poll_mask = ((slot->events & SELECT_EVENT_READ) ? POLLIN | POLLRDHUP : 0) |
+                                    ((slot->events & SELECT_EVENT_WRITE) ? POLLOUT : 0);
+
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = fd;
+#if __BYTE_ORDER == __BIG_ENDIAN
+            sqe->poll32_events = (poll_mask << 16) | (poll_mask >> 16);
+#else
+            sqe->poll32_events = poll_mask;
+#endif
+            sqe->user_data = URING_USER_DATA(fd, slot->gen);
+            slot->armed_gen = slot->gen;
+            slot->state = URING_FD_ARMED;
+        }
+        slot->queued = False;
+    }
+
+    /* 提交队列资源不足时，剩余的变更留到下一次 */
+    if (count < ring->change_num) {
+        memmove(ring->changes, ring->changes + count, (ring->change_num - count) * sizeof(fd_t));
+    }
+    ring->change_num -= count;
+}
+
+static int32_t __uring_wait(void* backend, int64_t timeout_us, engine_ready_t* ready, int32_t max_ready)
+{
+    uring_backend_t*                ring = (uring_backend_t*)backend;
+    struct io_uring_getevents_arg   arg;
+    struct __kernel_timespec        ts;
+    uint32_t                        head = 0;
+    uint32_t                        tail = 0;
+    int32_t                         ready_num = 0;
+    int                             ret = 0;
+
+    __uring_flush_changes(ring);
+
+    /* 如果完成队列中已有事件，就不需要阻塞 */
+    head = *ring->cq_head;
+    if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        timeout_us = 0;
+    }
+
+    memset(&arg, 0, sizeof(arg));
+    if (timeout_us >= 0) {
+        ts.tv_sec = timeout_us / (1000 * 1000);
+        ts.tv_nsec = (timeout_us % (1000 * 1000)) * 1000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    /* 提交所有变更并等待至少一个完成事件，只需要一次系统调用 */
+    ret = __sys_uring_enter(ring->ring_fd, ring->to_submit, timeout_us ? 1 : 0,
+                            IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+        blive_loge("io_uring_enter failed(%s)", strerror(errno));
+        return -1;
+    }
+    if (ret >= 0) {
+        ring->to_submit -= min((uint32_t)ret, ring->to_submit);
+    }
+
+    head = *ring->cq_head;
+    tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail && ready_num < max_ready) {
+        struct io_uring_cqe*    cqe = &ring->cqes[head & *ring->cq_mask];
+        uint64_t                user_data = cqe->user_data;
+        fd_t                    fd = URING_USER_DATA_FD(user_data);
+        uring_fd_t*             slot = NULL;
+
+        head++;
+        if (user_data & URING_INTERNAL_FLAG) {
+            continue;
+        }
+
+        slot = __uring_fd_slot(ring, fd, False);
+        if (slot == NULL) {
+            continue;
+        }
+        if (slot->armed_gen == URING_USER_DATA_GEN(user_data)) {
+            slot->armed_gen = 0;
+        }
+        /* 已被删除或重新注册过的fd，丢弃过期的完成事件 */
+        if (slot->state != URING_FD_ARMED || slot->gen != URING_USER_DATA_GEN(user_data)) {
+            continue;
+        }
+
+        /* 单次的POLL_ADD已经完成，重新放入变更列表等待下一次提交 */
+        slot->state = URING_FD_ARMING;
+        __uring_queue_change(ring, fd, slot);
+        ready[ready_num].fd = fd;
+        if (cqe->res < 0) {
+            /* fd已失效（如被提前关闭），与epoll、select一样作为出错上报，由调用者关闭并删除 */
+            blive_loge("io_uring poll fd=%d failed(%s)", fd, strerror(-cqe->res));
+            ready[ready_num].events = SELECT_EVENT_ERROR;
+        } else {
+            ready[ready_num].events = ((cqe->res & (POLLIN | POLLRDHUP | POLLHUP)) ? SELECT_EVENT_READ : 0) |
+                                      ((cqe->res & POLLOUT) ? SELECT_EVENT_WRITE : 0) |
+                                      ((cqe->res & (POLLERR | POLLHUP | POLLNVAL)) ? SELECT_EVENT_ERROR : 0);
+        }
+        ready_num++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+    return ready_num;
+}
+
+
+const engine_backend_ops engine_backend_uring = {
+    .name = "io_uring",
+    .create = __uring_create,
+    .destroy = __uring_destroy,
+    .fd_add = __uring_fd_add,
+    .fd_mod = __uring_fd_mod,
+    .fd_del = __uring_fd_del,
+    .wait = __uring_wait,
+};
+#endif
@@ -0,0 +1,301 @@
+/**
+ * @file epoch.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 基于epoch的内存回收。全局epoch只有在所有处于临界区的读者都已经看到当前
+ *        epoch时才能推进，在epoch为e时摘除的节点，到全局epoch推进到e+2时一定没有
+ *        读者还持有它。待回收的节点按照摘除时的epoch放在三个链表中轮转。
+ * @version 0.1
+ * @date 2023-03-26
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <pthread.h>
+#include "epoch.h"
+
+
+#define EPOCH_LIMBO_NUM         3       /* 待回收链表的数量，对应e-1、e、e+1 */
+#define EPOCH_RECLAIM_BATCH     64      /* 每摘除多少个节点尝试一次回收 */
+#define EPOCH_TLS_NUM           8       /* 每个线程缓存的记录数，使用更多的域时覆盖不在临界区内的缓存 */
+
+/* 记录中的状态，最低位表示是否在临界区内，其余位为进入时看到的epoch */
+#define EPOCH_ACTIVE            1ULL
+
+typedef struct epoch_record {
+    struct epoch_record*    next;       /* 域中所有记录组成的链表，只增不减 */
+    const void*             owner;      /* 所属线程的缓存数组，线程退出后由复用该地址的线程继续使用 */
+    uint64_t                state;      /* 原子操作 */
+} epoch_record_t;
+
+struct epoch_domain {
+    uint64_t            id;                         /* 全局唯一，用于线程缓存 */
+    uint64_t            epoch;                      /* 全局epoch，原子操作 */
+    epoch_record_t*     records;                    /* 原子操作 */
+    pthread_mutex_t     lock;                       /* 保护待回收链表和推进epoch */
+    epoch_entry_t*      limbo[EPOCH_LIMBO_NUM];     /* 待回收链表，按照摘除时的epoch取模 */
+    uint32_t            retired;                    /* 上次尝试回收后摘除的节点数 */
+};
+
+/* 线程缓存的记录，按照域的id查找。嵌套深度保存在缓存中，淘汰时不需要访问记录，
+   其他线程销毁的域留下的缓存也可以直接覆盖 */
+typedef struct epoch_tls {
+    uint64_t            domain_id;
+    epoch_record_t*     record;
+    uint32_t            nest;       /* 嵌套深度，不为0时不能被覆盖 */
+    struct epoch_tls*   next;       /* 溢出链表 */
+} epoch_tls_t;
+
+
+static uint64_t         epoch_domain_id = 0;
+static __thread epoch_tls_t epoch_tls[EPOCH_TLS_NUM];
+static __thread epoch_tls_t* epoch_tls_overflow = NULL;    /* 所有缓存都在临界区内时额外申请的缓存 */
+
+
+static epoch_tls_t* __epoch_tls(epoch_domain_t* domain);
+static epoch_record_t* __epoch_record(epoch_domain_t* domain);
+static Bool __epoch_try_advance(epoch_domain_t* domain, epoch_entry_t** freed);
+static uint32_t __epoch_free_list(epoch_entry_t* entry);
+
+
+int epoch_domain_create(epoch_domain_t** domain)
+{
+    epoch_domain_t*     new_domain = NULL;
+
+    if (domain == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    new_domain = zero_alloc(sizeof(epoch_domain_t));
+    if (new_domain == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    new_domain->id = __atomic_add_fetch(&epoch_domain_id, 1, __ATOMIC_RELAXED);
+    pthread_mutex_init(&new_domain->lock, NULL);
+    *domain = new_domain;
+
+    return BLIVE_ERR_OK;
+}
+
+int epoch_domain_destroy(epoch_domain_t* domain)
+{
+    epoch_record_t*     record = NULL;
+    epoch_record_t*     next = NULL;
+
+    if (domain == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    /* 只能清除当前线程的缓存，其他线程的缓存不会再被命中，在淘汰时覆盖 */
+    for (uint32_t i = 0; i < EPOCH_TLS_NUM; i++) {
+        if (epoch_tls[i].domain_id == domain->id) {
+            memset(&epoch_tls[i], 0, sizeof(epoch_tls_t));
+        }
+    }
+    for (uint32_t i = 0; i < EPOCH_LIMBO_NUM; i++) {
+        __epoch_free_list(domain->limbo[i]);
+    }
+    for (record = domain->records; record != NULL; record = next) {
+        next = record->next;
+        free(record);
+    }
+    pthread_mutex_destroy(&domain->lock);
+    free(domain);
+
+    return BLIVE_ERR_OK;
+}
+
+void epoch_enter(epoch_domain_t* domain)
+{
+    epoch_tls_t*        tls = __epoch_tls(domain);
+    uint64_t            epoch = 0;
+
+    if (tls == NULL || tls->nest++) {
+        return ;
+    }
+
+    /* 先公布自己进入的epoch，再读取任何节点，两者之间需要完整的内存屏障 */
+    epoch = __atomic_load_n(&domain->epoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&tls->record->state, (epoch << 1) | EPOCH_ACTIVE, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epoch_exit(epoch_domain_t* domain)
+{
+    epoch_tls_t*        tls = __epoch_tls(domain);
+    epoch_tls_t**       prev = &epoch_tls_overflow;
+
+    if (tls == NULL || !tls->nest || --tls->nest) {
+        return ;
+    }
+
+    __atomic_store_n(&tls->record->state, 0, __ATOMIC_RELEASE);
+
+    /* 溢出的缓存离开临界区后释放，记录仍在域中，下次使用时重新找到 */
+    if (tls < epoch_tls || tls >= epoch_tls + EPOCH_TLS_NUM) {
+        while (*prev != tls) {
+            prev = &(*prev)->next;
+        }
+        *prev = tls->next;
+        free(tls);
+    }
+}
+
+void epoch_retire(epoch_domain_t* domain, epoch_entry_t* entry, epoch_free_func free_cb)
+{
+    uint64_t            epoch = 0;
+    Bool                reclaim = False;
+
+    entry->free_cb = free_cb;
+
+    pthread_mutex_lock(&domain->lock);
+    epoch = __atomic_load_n(&domain->epoch, __ATOMIC_RELAXED);
+    entry->next = domain->limbo[epoch % EPOCH_LIMBO_NUM];
+    domain->limbo[epoch % EPOCH_LIMBO_NUM] = entry;
+    reclaim = (++domain->retired >= EPOCH_RECLAIM_BATCH);
+    pthread_mutex_unlock(&domain->lock);
+
+    if (reclaim) {
+        epoch_reclaim(domain);
+    }
+}
+
+uint32_t epoch_reclaim(epoch_domain_t* domain)
+{
+    epoch_entry_t*      freed = NULL;
+
+    if (domain == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&domain->lock);
+    domain->retired = 0;
+    __epoch_try_advance(domain, &freed);
+    pthread_mutex_unlock(&domain->lock);
+
+    /* 释放回调可能再次调用epoch_retire，在锁外执行 */
+    return __epoch_free_list(freed);
+}
+
+
+/**
+ * @brief 获取当前线程在域中的缓存，未缓存时找到或者登记记录后放入缓存
+ *
+ * @param [in] domain 回收域
+ * @return epoch_tls_t* 内存不足时返回NULL
+ */
+static epoch_tls_t* __epoch_tls(epoch_domain_t* domain)
+{
+    epoch_tls_t*        slot = NULL;
+    epoch_record_t*     record = NULL;
+
+    for (uint32_t i = 0; i < EPOCH_TLS_NUM; i++) {
+        if (epoch_tls[i].domain_id == domain->id) {
+            return &epoch_tls[i];
+        }
+    }
+    for (slot = epoch_tls_overflow; slot != NULL; slot = slot->next) {
+        if (slot->domain_id == domain->id) {
+            return slot;
+        }
+    }
+
+    record = __epoch_record(domain);
+    if (record == NULL) {
+        return NULL;
+    }
+
+    /* 覆盖空位或者不在临界区内的缓存，被覆盖的记录处于空闲状态，不会阻止epoch推进 */
+    for (uint32_t i = 0; i < EPOCH_TLS_NUM; i++) {
+        if (!epoch_tls[i].nest) {
+            slot = &epoch_tls[i];
+            break;
+        }
+    }
+    /* 同时处于超过EPOCH_TLS_NUM个域的临界区内 */
+    if (slot == NULL) {
+        slot = zero_alloc(sizeof(epoch_tls_t));
+        if (slot == NULL) {
+            return NULL;
+        }
+        slot->next = epoch_tls_overflow;
+        epoch_tls_overflow = slot;
+    }
+    slot->domain_id = domain->id;
+    slot->record = record;
+    slot->nest = 0;
+
+    return slot;
+}
+
+/**
+ * @brief 获取当前线程在域中的记录，第一次使用时登记。记录只增不减，缓存被覆盖后
+ *        再次使用时找回原来的记录
+ *
+ * @param [in] domain 回收域
+ * @return epoch_record_t* 内存不足时返回NULL
+ */
+static epoch_record_t* __epoch_record(epoch_domain_t* domain)
+{
+    epoch_record_t*     record = NULL;
+
+    for (record = __atomic_load_n(&domain->records, __ATOMIC_ACQUIRE); record != NULL; record = record->next) {
+        if (record->owner == epoch_tls) {
+            return record;
+        }
+    }
+
+    record = zero_alloc(sizeof(epoch_record_t));
+    if (record == NULL) {
+        return NULL;
+    }
+    record->owner = epoch_tls;
+    record->next = __atomic_load_n(&domain->records, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&domain->records, &record->next, record, True, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        ;
+    }
+
+    return record;
+}
+
+/**
+ * @brief 所有在临界区内的读者都已经看到当前epoch时推进epoch，需要在持有锁时调用
+ *
+ * @param [in] domain 回收域
+ * @param [out] freed 传出参数，可以释放的节点链表
+ * @return Bool 是否推进成功
+ */
+static Bool __epoch_try_advance(epoch_domain_t* domain, epoch_entry_t** freed)
+{
+    epoch_record_t*     record = NULL;
+    uint64_t            epoch = __atomic_load_n(&domain->epoch, __ATOMIC_RELAXED);
+    uint64_t            state = 0;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (record = __atomic_load_n(&domain->records, __ATOMIC_ACQUIRE); record != NULL; record = record->next) {
+        state = __atomic_load_n(&record->state, __ATOMIC_ACQUIRE);
+        if ((state & EPOCH_ACTIVE) && (state >> 1) != epoch) {
+            return False;
+        }
+    }
+
+    /* 推进到epoch+1之后，epoch-1时摘除的节点已经没有读者能看到，其链表下标正是(epoch+2)%3 */
+    __atomic_store_n(&domain->epoch, epoch + 1, __ATOMIC_RELEASE);
+    *freed = domain->limbo[(epoch + 2) % EPOCH_LIMBO_NUM];
+    domain->limbo[(epoch + 2) % EPOCH_LIMBO_NUM] = NULL;
+
+    return True;
+}
+
+static uint32_t __epoch_free_list(epoch_entry_t* entry)
+{
+    epoch_entry_t*      next = NULL;
+    uint32_t            count = 0;
+
+    for (; entry != NULL; entry = next) {
+        next = entry->next;
+        entry->free_cb(entry);
+        count++;
+    }
+
+    return count;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file epoch.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 基于epoch的内存回收。读者进入、离开临界区只需要写自己的记录，不加锁也
+ *        不会阻塞；写者将摘除的节点交给epoch_retire，等所有读者都离开了可能看到
+ *        该节点的临界区之后再释放。
+ * @attention 每个线程第一次进入某个域时自动登记一条记录，记录在域销毁时统一释放。
+ * 临界区可以嵌套，但在临界区内不能阻塞等待其他线程离开临界区。
+ * @version 0.1
+ * @date 2023-03-26
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_EPOCH_H__
+#define __UTILS_EPOCH_H__
+
+#include "utils.h"
+
+
+typedef struct epoch_domain epoch_domain_t;
+
+typedef struct epoch_entry epoch_entry_t;
+
+/**
+ * @brief 释放延迟回收的节点的回调函数，通过container_of取回节点
+ */
+typedef void (*epoch_free_func)(epoch_entry_t* entry);
+
+/**
+ * @brief 延迟回收的节点，内嵌到需要回收的结构体中
+ *
+ */
+struct epoch_entry {
+    epoch_entry_t*      next;
+    epoch_free_func     free_cb;
+};
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 创建回收域，使用同一组节点的读者和写者共用一个域
+ *
+ * @param [out] domain 传出参数，回收域
+ * @return int
+ */
+int epoch_domain_create(epoch_domain_t** domain);
+
+/**
+ * @brief 销毁回收域，尚未释放的节点全部立即释放。调用者需要保证已经没有读者
+ *
+ * @param [in] domain 回收域
+ * @return int
+ */
+int epoch_domain_destroy(epoch_domain_t* domain);
+
+/**
+ * @brief 进入读临界区，此后读到的节点在离开临界区之前不会被释放
+ *
+ * @param [in] domain 回收域
+ */
+void epoch_enter(epoch_domain_t* domain);
+
+/**
+ * @brief 离开读临界区
+ *
+ * @param [in] domain 回收域
+ */
+void epoch_exit(epoch_domain_t* domain);
+
+/**
+ * @brief 延迟释放一个已经从数据结构中摘除的节点，任意线程均可调用，也可以在临界区内调用
+ *
+ * @param [in] domain 回收域
+ * @param [in] entry 节点
+ * @param [in] free_cb 释放节点的回调函数，在没有读者能看到该节点之后调用
+ */
+void epoch_retire(epoch_domain_t* domain, epoch_entry_t* entry, epoch_free_func free_cb);
+
+/**
+ * @brief 尝试推进epoch并释放已经安全的节点。epoch_retire会定期自动调用，写入很少时
+ *        可以由调用者定时调用，避免节点长时间不释放
+ *
+ * @param [in] domain 回收域
+ * @return uint32_t 本次释放的节点数量
+ */
+uint32_t epoch_reclaim(epoch_domain_t* domain);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
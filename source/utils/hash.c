@@ -1,93 +1,361 @@
 /**
  * @file hash.c
  * @author Zhong Qiaoning (691365572@qq.com)
- * @brief 
+ * @brief 哈希表。扩容、缩容时不一次性迁移全部元素，而是同时保留新旧两个bucket数组，
+ *        之后的每次操作顺带迁移少量bucket，使单次操作的耗时有上界。
+ *        元素存放在按块申请的连续内存中，元素的位置在整理之前不会改变，遍历只需要
+ *        按位置顺序扫描。
  * @version 0.1
  * @date 2022-07-13
- * 
+ *
  * @copyright Copyright (c) 2022
- * 
+ *
  */
 #include <string.h>
+#include <time.h>
 #include "hash.h"
 #include "utils.h"
 
 #define INITIAL_MAX 15 /* 2^n - 1 */
 
-#define HASH_DEFAULT_MULTIPLER 33
+#define HASH_REHASH_STEP        4       /* 每次操作最多迁移的非空bucket数 */
+#define HASH_REHASH_EMPTY_VISIT 40      /* 每次操作最多跳过的空bucket数 */
+#define HASH_SHRINK_RATIO       8       /* 元素数量少于bucket数的1/8时缩容 */
+
+#define HASH_CHUNK_SHIFT        6
+#define HASH_CHUNK_ENTRIES      (1 << HASH_CHUNK_SHIFT)     /* 每块的元素数量 */
+#define HASH_CHUNK_MASK         (HASH_CHUNK_ENTRIES - 1)
+#define HASH_INLINE_KEY         24      /* 不超过该长度（含结尾的0）的键直接存放在元素中 */
+
+/* wyhash使用的常数 */
+#define HASH_WY_P0  0xa0761d6478bd642fULL
+#define HASH_WY_P1  0xe7037ed1a0b428dbULL
+#define HASH_WY_P2  0x8ebc6af09c88c6e3ULL
+#define HASH_WY_P3  0x589965cc75374cc3ULL
 
 typedef struct hash_entry {
-    int32_t hash;               /* 哈希值 */
-    char key[32];               /* 键 */
+    uint64_t hash;              /* 哈希值 */
     void* value;                /* 值 */
-    struct hash_entry* next;    /* 哈希链表下一个 */
+    struct hash_entry* next;    /* 哈希链表下一个，空闲时为空闲链表的下一个 */
+    char* key;                  /* 键，指向inline_key或单独申请的内存，NULL表示空闲 */
+    char inline_key[HASH_INLINE_KEY];
 } hash_entry_t;
 
+typedef struct {
+    hash_entry_t entries[HASH_CHUNK_ENTRIES];
+} hash_chunk_t;
 
-struct hash_t {
+typedef struct {
     hash_entry_t **array;       /* 哈希bucket */
+    uint32_t max;               /* bucket数量-1 */
+} hash_bucket_t;
+
+struct hash_t {
+    hash_bucket_t table[2];     /* table[1]只在迁移过程中使用，迁移完成后成为table[0] */
+    int64_t rehash_index;       /* table[0]中下一个需要迁移的bucket，-1表示没有在迁移 */
+    uint32_t min_max;           /* 创建时的bucket数量-1，缩容时不低于这个大小 */
     uint32_t count;             /* 当前哈希表内的数据 */
-    uint32_t max;               /* 哈希表最大存储数据 */
-    hash_func hash_func;        /* 哈希函数 */
-    hash_entry_t *free;         /* 避免频繁free使用 */
+    hash_func hash_func;        /* 自定义的哈希函数，为NULL时使用默认的哈希函数 */
+    uint64_t seed;              /* 默认哈希函数的种子，每个哈希表随机生成 */
+    hash_chunk_t **chunks;      /* 元素的存储块 */
+    uint32_t chunk_num;         /* 已申请的块数 */
+    uint32_t chunk_max;         /* chunks数组的长度 */
+    uint32_t entry_end;         /* 使用过的最大位置+1，遍历只需要扫描到这里 */
+    hash_entry_t *free;         /* 空闲的元素，删除的元素放入这里供下次使用 */
+    uint32_t generation;        /* 每次整理后递增，使整理前的游标失效 */
 };
 
+
+static inline uint64_t __hash_read64(const uint8_t* p)
+{
+    uint64_t    v = 0;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t __hash_read32(const uint8_t* p)
+{
+    uint32_t    v = 0;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void __hash_mum(uint64_t* a, uint64_t* b)
+{
+    __uint128_t r = (__uint128_t)(*a) * (*b);
+
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+}
+
+static inline uint64_t __hash_mix(uint64_t a, uint64_t b)
+{
+    __hash_mum(&a, &b);
+    return a ^ b;
+}
+
 /**
- * @brief 默认的哈希函数
- * 
- * @param char_key 
- * @return uint32_t 
+ * @brief 默认的哈希函数，wyhash。每次处理8到48字节，带有种子，数字组成的键也能
+ *        均匀分布
+ *
+ * @param key 键
+ * @param len 键的长度
+ * @param seed 种子
+ * @return uint64_t
  */
-static uint32_t hashfunc_default(const char* char_key)
+static uint64_t hashfunc_default(const void* key, size_t len, uint64_t seed)
 {
-    const char*     key = (const char *)char_key;
-    const char*     cur_pos = NULL;
-    uint32_t        hash = 0;
+    const uint8_t*  p = (const uint8_t*)key;
+    uint64_t        a = 0;
+    uint64_t        b = 0;
+    uint64_t        see1 = 0;
+    uint64_t        see2 = 0;
+    size_t          i = len;
+
+    seed ^= __hash_mix(seed ^ HASH_WY_P0, HASH_WY_P1);
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (__hash_read32(p) << 32) | __hash_read32(p + ((len >> 3) << 2));
+            b = (__hash_read32(p + len - 4) << 32) | __hash_read32(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+        }
+    } else {
+        if (i > 48) {
+            see1 = seed;
+            see2 = seed;
+            do {
+                seed = __hash_mix(__hash_read64(p) ^ HASH_WY_P1, __hash_read64(p + 8) ^ seed);
+                see1 = __hash_mix(__hash_read64(p + 16) ^ HASH_WY_P2, __hash_read64(p + 24) ^ see1);
+                see2 = __hash_mix(__hash_read64(p + 32) ^ HASH_WY_P3, __hash_read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = __hash_mix(__hash_read64(p) ^ HASH_WY_P1, __hash_read64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = __hash_read64(p + i - 16);
+        b = __hash_read64(p + i - 8);
+    }
 
-    for (cur_pos = key; *cur_pos; cur_pos++) {
-        hash = hash * HASH_DEFAULT_MULTIPLER + *cur_pos;
+    a ^= HASH_WY_P1;
+    b ^= seed;
+    __hash_mum(&a, &b);
+    return __hash_mix(a ^ HASH_WY_P0 ^ len, b ^ HASH_WY_P1);
+}
+
+static inline uint64_t __hash_key(const hash_t *hash_table, const char *key)
+{
+    if (hash_table->hash_func != NULL) {
+        return hash_table->hash_func(key);
     }
-    return hash;
+    return hashfunc_default(key, strlen(key), hash_table->seed);
+}
+
+/**
+ * @brief 为哈希表生成随机的种子，使外部无法构造出大量碰撞的键
+ */
+static uint64_t __hash_seed(const hash_t *hash_table)
+{
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return __hash_mix((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec, (uintptr_t)hash_table ^ HASH_WY_P2);
+}
+
+static inline hash_entry_t* __entry_at(const hash_t *hash_table, uint32_t position)
+{
+    return &hash_table->chunks[position >> HASH_CHUNK_SHIFT]->entries[position & HASH_CHUNK_MASK];
+}
+
+/**
+ * @brief 从存储块中分配一个元素，优先使用空闲的元素
+ *
+ * @param hash_table 哈希表描述结构体
+ * @param key 键
+ * @param key_len 键的长度
+ * @return hash_entry_t* 内存不足时返回NULL
+ */
+static hash_entry_t* __entry_alloc(hash_t *hash_table, const char *key, size_t key_len)
+{
+    hash_entry_t*   entry = NULL;
+    hash_chunk_t**  chunks = NULL;
+    uint32_t        chunk_max = 0;
+
+    if (hash_table->free == NULL && (hash_table->entry_end >> HASH_CHUNK_SHIFT) >= hash_table->chunk_num) {
+        if (hash_table->chunk_num == hash_table->chunk_max) {
+            chunk_max = hash_table->chunk_max ? hash_table->chunk_max * 2 : 4;
+            chunks = realloc(hash_table->chunks, sizeof(hash_chunk_t*) * chunk_max);
+            if (chunks == NULL) {
+                return NULL;
+            }
+            hash_table->chunks = chunks;
+            hash_table->chunk_max = chunk_max;
+        }
+        hash_table->chunks[hash_table->chunk_num] = malloc(sizeof(hash_chunk_t));
+        if (hash_table->chunks[hash_table->chunk_num] == NULL) {
+            return NULL;
+        }
+        hash_table->chunk_num++;
+    }
+
+    if (hash_table->free != NULL) {
+        entry = hash_table->free;
+        hash_table->free = entry->next;
+    } else {
+        entry = __entry_at(hash_table, hash_table->entry_end++);
+    }
+
+    if (key_len < HASH_INLINE_KEY) {
+        entry->key = entry->inline_key;
+    } else {
+        entry->key = malloc(key_len + 1);
+        if (entry->key == NULL) {
+            /* 从未使用过的位置内容未初始化，放回空闲链表前与__entry_free一样标记为空闲，
+               否则游标和整理会把它当作有效元素 */
+            entry->key = NULL;
+            entry->value = NULL;
+            entry->next = hash_table->free;
+            hash_table->free = entry;
+            return NULL;
+        }
+    }
+    memcpy(entry->key, key, key_len + 1);
+
+    return entry;
+}
+
+/**
+ * @brief 将元素放回空闲链表，元素所在的位置保持空闲直到被再次分配或整理
+ *
+ * @param hash_table 哈希表描述结构体
+ * @param entry 元素
+ */
+static void __entry_free(hash_t *hash_table, hash_entry_t *entry)
+{
+    if (entry->key != entry->inline_key) {
+        free(entry->key);
+    }
+    entry->key = NULL;
+    entry->value = NULL;
+    entry->next = hash_table->free;
+    hash_table->free = entry;
 }
 
 /**
  * @brief 分配哈希bucket
- * 
+ *
+ * @param bucket 哈希bucket
+ * @param max 哈希bucket数量-1，必须是2^n - 1
+ * @return blive_errno_t
+ */
+static blive_errno_t __alloc_array(hash_bucket_t *bucket, uint32_t max)
+{
+    bucket->array = zero_alloc(sizeof(*bucket->array) * ((size_t)max + 1));
+    if (bucket->array == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    bucket->max = max;
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 开始将哈希表迁移到新的大小，只申请新的bucket，元素在之后的操作中逐步迁移
+ *
  * @param hash_table 哈希表描述结构体
- * @param max 哈希表最大值
- * @return hash_entry_t** 
+ * @param new_max 新的bucket数量-1
  */
-static hash_entry_t** __alloc_array(hash_t *hash_table, uint32_t max)
+static void __resize_start(hash_t *hash_table, uint32_t new_max)
 {
-    return zero_alloc(sizeof(*hash_table->array) * (max + 1));
+    if (hash_table->rehash_index >= 0 || new_max == hash_table->table[0].max) {
+        return ;
+    }
+
+    /* 申请失败时继续使用原来的大小，不影响正确性 */
+    if (__alloc_array(&hash_table->table[1], new_max) == BLIVE_ERR_OK) {
+        hash_table->rehash_index = 0;
+    }
 }
 
 /**
- * @brief 进行哈希表的扩容
- * 
+ * @brief 迁移少量bucket，迁移完成后新的bucket替代旧的
+ *
  * @param hash_table 哈希表描述结构体
  */
-static void __expand_array(hash_t *hash_table)
+static void __rehash_step(hash_t *hash_table)
 {
-    hash_entry_t**   new_array = NULL;
-    uint32_t            new_max;
+    hash_bucket_t*  old_table = &hash_table->table[0];
+    hash_bucket_t*  new_table = &hash_table->table[1];
+    hash_entry_t*   entry = NULL;
+    hash_entry_t*   next = NULL;
+    uint32_t        moved = 0;
+    uint32_t        visited = 0;
+
+    if (hash_table->rehash_index < 0) {
+        return ;
+    }
 
-    new_max = hash_table->max * 2 + 1;
-    new_array = __alloc_array(hash_table, new_max);
+    while (hash_table->rehash_index <= old_table->max && moved < HASH_REHASH_STEP && visited < HASH_REHASH_EMPTY_VISIT) {
+        entry = old_table->array[hash_table->rehash_index];
+        if (entry == NULL) {
+            hash_table->rehash_index++;
+            visited++;
+            continue;
+        }
 
-    for (uint32_t i = 0; i <= hash_table->max; i++) {
-        hash_entry_t *entry = hash_table->array[i];
         while (entry) {
-            hash_entry_t *next = entry->next;
-            uint32_t index = entry->hash & new_max;
-            entry->next = new_array[index];
-            new_array[index] = entry;
+            next = entry->next;
+            entry->next = new_table->array[entry->hash & new_table->max];
+            new_table->array[entry->hash & new_table->max] = entry;
             entry = next;
         }
+        old_table->array[hash_table->rehash_index] = NULL;
+        hash_table->rehash_index++;
+        moved++;
+    }
+
+    if (hash_table->rehash_index > old_table->max) {
+        free(old_table->array);
+        *old_table = *new_table;
+        memset(new_table, 0, sizeof(hash_bucket_t));
+        hash_table->rehash_index = -1;
+    }
+}
+
+/**
+ * @brief 根据元素数量判断是否需要扩容或缩容
+ *
+ * @param hash_table 哈希表描述结构体
+ */
+static void __check_size(hash_t *hash_table)
+{
+    uint32_t    max = hash_table->table[0].max;
+    uint32_t    new_max = hash_table->min_max;
+
+    if (hash_table->rehash_index >= 0) {
+        return ;
+    }
+
+    /* 迁移期间不会再次扩容，元素数量可能已经远超bucket数，一次扩到足够的大小 */
+    if (hash_table->count > max && max < (UINT32_MAX >> 1)) {
+        new_max = max * 2 + 1;
+        while (new_max < hash_table->count && new_max < (UINT32_MAX >> 1)) {
+            new_max = new_max * 2 + 1;
+        }
+        __resize_start(hash_table, new_max);
+    } else if (max > hash_table->min_max && (uint64_t)hash_table->count * HASH_SHRINK_RATIO < max) {
+        while (new_max < hash_table->count * 2) {
+            new_max = new_max * 2 + 1;
+        }
+        __resize_start(hash_table, new_max);
     }
-    free(hash_table->array);
-    hash_table->array = new_array;
-    hash_table->max = new_max;
 }
 
 
@@ -100,9 +368,6 @@ blive_errno_t hash_create(hash_t **out, uint32_t size, hash_func hash_func)
     if (out == NULL) {
         return BLIVE_ERR_NULLPTR;
     }
-    if (size < 0) {
-        return BLIVE_ERR_INVALID;
-    }
 
     if (size == 0) {
         max_size = INITIAL_MAX;
@@ -116,16 +381,21 @@ blive_errno_t hash_create(hash_t **out, uint32_t size, hash_func hash_func)
         max_size -= 1;
     }
 
-    if (hash_func == NULL)
-        hash_func = hashfunc_default;
-
     hash_table = zero_alloc(sizeof(hash_t));
-    *out = hash_table;
+    if (hash_table == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    retval = __alloc_array(&hash_table->table[0], max_size);
+    if (retval != BLIVE_ERR_OK) {
+        free(hash_table);
+        return retval;
+    }
     hash_table->count = 0;
-    hash_table->max = max_size;
+    hash_table->rehash_index = -1;
+    hash_table->min_max = max_size;
     hash_table->hash_func = hash_func;
-    hash_table->array = __alloc_array(hash_table, hash_table->max);
-    hash_table->free = NULL;
+    hash_table->seed = __hash_seed(hash_table);
+    *out = hash_table;
 
     return retval;
 }
@@ -140,66 +410,49 @@ blive_errno_t hash_destroy(hash_t *hash_table)
         return BLIVE_ERR_NULLPTR;
     }
 
-    for (uint32_t i = 0; i <= hash_table->max; i++) {
-        entry = hash_table->array[i];
-        while (entry) {
-            hash_entry_t *next = entry->next;
-            free(entry);
-            entry = next;
+    for (uint32_t i = 0; i < hash_table->entry_end; i++) {
+        entry = __entry_at(hash_table, i);
+        if (entry->key != NULL && entry->key != entry->inline_key) {
+            free(entry->key);
         }
     }
-
-    entry = hash_table->free;
-    while(entry) {
-        hash_entry_t *next = entry->next;
-        free(entry);
-        entry = next;
+    for (uint32_t i = 0; i < hash_table->chunk_num; i++) {
+        free(hash_table->chunks[i]);
     }
-
-    free(hash_table->array);
+    free(hash_table->chunks);
+    free(hash_table->table[0].array);
+    free(hash_table->table[1].array);
     free(hash_table);
 
     return retval;
 }
 
-static hash_entry_t **find_entry(hash_t *hash_table, const char *key, const void* value)
+/**
+ * @brief 查找键所在的位置
+ *
+ * @param hash_table 哈希表描述结构体
+ * @param key 键
+ * @param hash 键的哈希值
+ * @return hash_entry_t** 指向元素的指针的地址，*retval为NULL表示不存在
+ */
+static hash_entry_t **find_entry(hash_t *hash_table, const char *key, uint64_t hash)
 {
     hash_entry_t**  retval = NULL;
     hash_entry_t*   hash_entry = NULL;
-    uint32_t        hash = 0;
-    Bool            found = False;
-
-    if (hash_table == NULL) {
-        return NULL;
-    }
-
-    hash = hash_table->hash_func(key);
-    retval = &hash_table->array[hash & hash_table->max];
 
-    for (hash_entry = *retval; hash_entry; retval = &hash_entry->next, hash_entry = *retval) {
-        if (hash_entry->hash == hash && strcmp(hash_entry->key, key) == 0) {
-            found = True;
+    /* 迁移过程中两个bucket都可能有该键，table[0]中已经迁移的bucket为空 */
+    for (int t = 0; t < 2; t++) {
+        if (t == 1 && hash_table->rehash_index < 0) {
             break;
         }
-    }
-
-    if (value == NULL && !found) {
-        return retval;
-    }
-    if (hash_entry != NULL || value == NULL) {
-        return retval;
-    }
 
-    if ((hash_entry = hash_table->free) != NULL) {
-        hash_table->free = hash_entry->next;
-    } else {
-        hash_entry = zero_alloc(sizeof(*hash_entry));
+        retval = &hash_table->table[t].array[hash & hash_table->table[t].max];
+        for (hash_entry = *retval; hash_entry; retval = &hash_entry->next, hash_entry = *retval) {
+            if (hash_entry->hash == hash && strcmp(hash_entry->key, key) == 0) {
+                return retval;
+            }
+        }
     }
-    hash_entry->next = NULL;
-    hash_entry->hash = hash;
-    strncpy(hash_entry->key, key, sizeof(hash_entry->key) - 2);
-    *retval = hash_entry;
-    hash_table->count++;
 
     return retval;
 }
@@ -207,39 +460,49 @@ static hash_entry_t **find_entry(hash_t *hash_table, const char *key, const void
 
 void* hash_push(hash_t *hash_table, const char *key, const void* value)
 {
-    void* old_value = NULL;
-    hash_entry_t **hash_entry_addr;
+    void*           old_value = NULL;
+    hash_entry_t**  hash_entry_addr = NULL;
+    hash_entry_t*   entry = NULL;
+    hash_bucket_t*  table = NULL;
+    uint64_t        hash = 0;
 
-    if (key == NULL) {
+    if (hash_table == NULL || key == NULL) {
         return NULL;
     }
 
-    hash_entry_addr = find_entry(hash_table, key, value);
-    if (hash_entry_addr == NULL) {
-        /* 没有存储过却要删除key */
-        return old_value;
-    } else if (*hash_entry_addr) {
+    __rehash_step(hash_table);
+    hash = __hash_key(hash_table, key);
+    hash_entry_addr = find_entry(hash_table, key, hash);
+    if (*hash_entry_addr) {
         if (!value) {
             /* delete entry */
-            hash_entry_t *old = *hash_entry_addr;
-            *hash_entry_addr = (*hash_entry_addr)->next;
-            old->next = hash_table->free;
-            old_value = old->value;
-            old->value = NULL;
-            //free指针指向被移除的节点，该节点将提供给下一个写入节点使用，避免频繁malloc
-            hash_table->free = old;
+            entry = *hash_entry_addr;
+            *hash_entry_addr = entry->next;
+            old_value = entry->value;
+            __entry_free(hash_table, entry);
             --hash_table->count;
+            __check_size(hash_table);
         } else {
             /* replace entry */
             old_value = (*hash_entry_addr)->value;
             (*hash_entry_addr)->value = (void*)value;
-            /* check that the collision rate isn't too high */
-            if (hash_table->count > hash_table->max) {
-                __expand_array(hash_table);
-            }
         }
+    } else if (value) {
+        /* 新的元素，迁移过程中放入新的bucket */
+        entry = __entry_alloc(hash_table, key, strlen(key));
+        if (entry == NULL) {
+            return NULL;
+        }
+        entry->hash = hash;
+        entry->value = (void*)value;
+        table = &hash_table->table[(hash_table->rehash_index >= 0) ? 1 : 0];
+        entry->next = table->array[hash & table->max];
+        table->array[hash & table->max] = entry;
+        hash_table->count++;
+        __check_size(hash_table);
     }
-    return (void*)old_value;
+
+    return old_value;
 }
 
 
@@ -253,8 +516,13 @@ void* hash_peek(hash_t *hash_table, const char *key)
 {
     hash_entry_t**   hash_entry_addr = NULL;
 
-    hash_entry_addr = find_entry(hash_table, key, NULL);
-    if (hash_entry_addr)
+    if (hash_table == NULL || key == NULL) {
+        return NULL;
+    }
+
+    __rehash_step(hash_table);
+    hash_entry_addr = find_entry(hash_table, key, __hash_key(hash_table, key));
+    if (*hash_entry_addr)
         return (void*)((*hash_entry_addr)->value);
     else
         return NULL;
@@ -268,17 +536,126 @@ int32_t hash_count(hash_t *hash_table)
 
 void hash_foreach(hash_t *hash_table, hash_cb callback, void* context)
 {
-    uint32_t    i = 0;
+    hash_entry_t*   entry = NULL;
 
-    for (i = 0; i <= hash_table->max; i++) {
-        hash_entry_t* entry = hash_table->array[i];
-        while (entry) {
-            hash_entry_t *next = entry->next;
-            if (!callback(entry->key, entry->value, context)) {
-                return;
+    /* 按位置扫描，回调中删除其他元素只会使其位置变为空闲，不影响继续遍历 */
+    for (uint32_t i = 0; i < hash_table->entry_end; i++) {
+        entry = __entry_at(hash_table, i);
+        if (entry->key != NULL && !callback(entry->key, entry->value, context)) {
+            return;
+        }
+    }
+}
+
+void hash_cursor_init(hash_t *hash_table, hash_cursor_t *cursor)
+{
+    cursor->position = 0;
+    cursor->generation = hash_table->generation;
+}
+
+int hash_cursor_next(hash_t *hash_table, hash_cursor_t *cursor, const char **key, void **value)
+{
+    hash_entry_t*   entry = NULL;
+
+    if (hash_table == NULL || cursor == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+    if (cursor->generation != hash_table->generation) {
+        return BLIVE_ERR_INVALID;
+    }
+
+    while (cursor->position < hash_table->entry_end) {
+        entry = __entry_at(hash_table, cursor->position++);
+        if (entry->key != NULL) {
+            if (key != NULL) {
+                *key = entry->key;
             }
-            entry = next;
+            if (value != NULL) {
+                *value = entry->value;
+            }
+            return BLIVE_ERR_OK;
         }
     }
+
+    return BLIVE_ERR_NOTEXSIT;
 }
 
+int hash_compact(hash_t *hash_table)
+{
+    hash_entry_t*   hole = NULL;
+    hash_entry_t*   entry = NULL;
+    hash_chunk_t**  chunks = NULL;
+    hash_bucket_t   bucket;
+    uint32_t        low = 0;
+    uint32_t        high = 0;
+    uint32_t        chunk_num = 0;
+    uint32_t        max = 0;
+
+    if (hash_table == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    /* 按照当前的元素数量重新申请bucket，不小于创建时的大小，失败时保持原样 */
+    max = hash_table->min_max;
+    while (max < hash_table->count) {
+        max = max * 2 + 1;
+    }
+    if (__alloc_array(&bucket, max) != BLIVE_ERR_OK) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+
+    /* 将尾部的元素依次移动到头部的空位中，使元素连续存放在[0, count) */
+    high = hash_table->entry_end;
+    while (low < high) {
+        hole = __entry_at(hash_table, low);
+        if (hole->key != NULL) {
+            low++;
+            continue;
+        }
+        entry = __entry_at(hash_table, --high);
+        if (entry->key == NULL) {
+            continue;
+        }
+        *hole = *entry;
+        if (entry->key == entry->inline_key) {
+            hole->key = hole->inline_key;
+        }
+        entry->key = NULL;
+        low++;
+    }
+    hash_table->entry_end = hash_table->count;
+    hash_table->free = NULL;
+
+    /* 释放多余的块 */
+    chunk_num = (hash_table->entry_end + HASH_CHUNK_MASK) >> HASH_CHUNK_SHIFT;
+    for (uint32_t i = chunk_num; i < hash_table->chunk_num; i++) {
+        free(hash_table->chunks[i]);
+    }
+    hash_table->chunk_num = chunk_num;
+    if (!chunk_num) {
+        free(hash_table->chunks);
+        hash_table->chunks = NULL;
+        hash_table->chunk_max = 0;
+    } else if (chunk_num < hash_table->chunk_max) {
+        chunks = realloc(hash_table->chunks, sizeof(hash_chunk_t*) * chunk_num);
+        if (chunks != NULL) {
+            hash_table->chunks = chunks;
+            hash_table->chunk_max = chunk_num;
+        }
+    }
+
+    /* 元素的地址已经改变，重新建立bucket链表，同时结束正在进行的迁移 */
+    free(hash_table->table[0].array);
+    free(hash_table->table[1].array);
+    memset(&hash_table->table[1], 0, sizeof(hash_bucket_t));
+    hash_table->table[0] = bucket;
+    hash_table->rehash_index = -1;
+    for (uint32_t i = 0; i < hash_table->entry_end; i++) {
+        entry = __entry_at(hash_table, i);
+        entry->next = bucket.array[entry->hash & bucket.max];
+        bucket.array[entry->hash & bucket.max] = entry;
+    }
+    hash_table->generation++;
+
+    return BLIVE_ERR_OK;
+}
\ No newline at end of file
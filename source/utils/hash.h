@@ -1,7 +1,8 @@
 /**
  * @file hash.h
  * @author Zhong Qiaoning (691365572@qq.com)
- * @brief 哈希表
+ * @brief 哈希表，键为任意长度的字符串。扩容、缩容均为渐进式，之后的每次操作顺带
+ *        迁移少量元素，单次操作的耗时不随哈希表的大小增长
  * @version 0.1
  * @date 2022-07-13
  * 
@@ -19,6 +20,17 @@
  */
 typedef struct hash_t hash_t;
 
+/**
+ * @brief 哈希表的游标，按元素的存放位置依次遍历。遍历过程中可以任意插入、删除元素，
+ *        遍历期间一直存在的元素恰好被访问一次，新插入的元素可能被访问也可能不被访问，
+ *        调用hash_compact之后游标失效
+ *
+ */
+typedef struct {
+    uint32_t position;          /* 下一个检查的位置 */
+    uint32_t generation;        /* 创建游标时哈希表的整理次数 */
+} hash_cursor_t;
+
 
 /**
  * @brief 计算哈希值的哈希函数
@@ -50,7 +62,8 @@ extern "C" {
  * 
  * @param [out] pht 传出参数
  * @param [in] size 创建的哈希表的bucket大小
- * @param [in] hash_func 计算哈希值的哈希函数，如果传入NULL则会使用内置的默认哈希函数
+ * @param [in] hash_func 计算哈希值的哈希函数，如果传入NULL则会使用内置的默认哈希函数（带有
+ *             每个哈希表随机生成的种子）
  * @return int 
  */
 int hash_create(hash_t **pht, uint32_t size, hash_func hash_func);
@@ -68,7 +81,7 @@ int hash_destroy(hash_t *ht);
  * 
  * @param [in] ht 哈希表的描述结构
  * @param [in] key 存入哈希表的元素的键
- * @param [in] val 存入哈希表的元素的值
+ * @param [in] val 存入哈希表的元素的值，为NULL时等同于hash_pop
  * @return void* 如果发生碰撞，将会返回碰撞的元素的值，否则返回NULL
  */
 void* hash_push(hash_t *ht, const char *key, const void* val);
@@ -108,6 +121,34 @@ int32_t hash_count(hash_t *ht);
  */
 void hash_foreach(hash_t *ht, hash_cb callback, void* context);
 
+/**
+ * @brief 初始化游标，使其指向第一个元素之前
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [out] cursor 游标
+ */
+void hash_cursor_init(hash_t *ht, hash_cursor_t *cursor);
+
+/**
+ * @brief 取出游标的下一个元素，并将游标向后移动
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @param [in] cursor 游标
+ * @param [out] key 传出参数，元素的键，在元素被删除之前有效，不关心时可以传入NULL
+ * @param [out] value 传出参数，元素的值，不关心时可以传入NULL
+ * @return int 遍历结束返回BLIVE_ERR_NOTEXSIT，哈希表整理过返回BLIVE_ERR_INVALID
+ */
+int hash_cursor_next(hash_t *ht, hash_cursor_t *cursor, const char **key, void **value);
+
+/**
+ * @brief 整理哈希表，将元素移动到连续的位置，释放多余的存储块和bucket。耗时与元素
+ *        数量成正比，适合在删除大量元素之后的空闲时刻调用
+ *
+ * @param [in] ht 哈希表的描述结构
+ * @return int
+ */
+int hash_compact(hash_t *ht);
+
 #ifdef __cplusplus
 }
 #endif
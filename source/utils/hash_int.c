@@ -0,0 +1,269 @@
+/**
+ * @file hash_int.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 整数键的Robin Hood哈希表。每个槽记录自己距离理想位置的探测长度，插入时
+ *        探测长度较短的元素让位给较长的元素，使所有元素的探测长度趋于平均；查找时
+ *        遇到探测长度比当前更短的槽就可以确定键不存在，不需要扫描到空槽。
+ * @version 0.1
+ * @date 2023-03-24
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "hash_int.h"
+
+
+#define HASH_INT_MIN_SLOTS      16      /* 槽数组的最小长度，必须是2的幂 */
+#define HASH_INT_LOAD_NUM       4       /* 最大负载因子为4/5 */
+#define HASH_INT_LOAD_DEN       5
+
+
+/**
+ * @brief 整数的混合函数（murmur3的最终混合），连续的uid、fd也能均匀分布
+ */
+static inline uint32_t __hash_mix32(uint32_t key)
+{
+    key ^= key >> 16;
+    key *= 0x85ebca6bU;
+    key ^= key >> 13;
+    key *= 0xc2b2ae35U;
+    key ^= key >> 16;
+    return key;
+}
+
+static inline uint32_t __hash_mix64(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+/**
+ * @brief 计算能够容纳size个元素的槽数组长度
+ */
+static uint32_t __hash_slot_num(uint32_t size)
+{
+    uint64_t    need = (uint64_t)size * HASH_INT_LOAD_DEN / HASH_INT_LOAD_NUM + 1;
+    uint64_t    slot_num = HASH_INT_MIN_SLOTS;
+
+    while (slot_num < need) {
+        slot_num <<= 1;
+    }
+    return (slot_num > ((uint64_t)1 << 31)) ? 0 : (uint32_t)slot_num;
+}
+
+
+/**
+ * @brief 生成一种整数键的哈希表的实现
+ *
+ * @param name 类型与函数的前缀
+ * @param key_type 键的类型
+ * @param mix 键的混合函数
+ */
+#define HASH_INT_DEFINE(name, key_type, mix)                                        \
+                                                                                    \
+typedef struct {                                                                    \
+    key_type    key;                                                                \
+    uint32_t    dist;       /* 探测长度+1，为0表示空槽 */                           \
+    void*       value;                                                              \
+} name##_slot_t;                                                                    \
+                                                                                    \
+struct name {                                                                       \
+    name##_slot_t*  slots;      /* 槽数组 */                                        \
+    uint32_t        mask;       /* 槽数组长度-1 */                                  \
+    uint32_t        count;      /* 元素数量 */                                      \
+};                                                                                  \
+                                                                                    \
+/* 将一个确定不在表中的元素放入槽数组 */                                            \
+static void __##name##_place(name##_slot_t* slots, uint32_t mask, key_type key, void* value) \
+{                                                                                   \
+    name##_slot_t   cur = {key, 1, value};                                          \
+    name##_slot_t   tmp;                                                            \
+    uint32_t        index = mix(key) & mask;                                        \
+                                                                                    \
+    for (;;) {                                                                      \
+        if (!slots[index].dist) {                                                   \
+            slots[index] = cur;                                                     \
+            return ;                                                                \
+        }                                                                           \
+        /* 劫富济贫，探测长度更短的元素让出位置，带着它继续向后探测 */              \
+        if (slots[index].dist < cur.dist) {                                         \
+            tmp = slots[index];                                                     \
+            slots[index] = cur;                                                     \
+            cur = tmp;                                                              \
+        }                                                                           \
+        index = (index + 1) & mask;                                                 \
+        cur.dist++;                                                                 \
+    }                                                                               \
+}                                                                                   \
+                                                                                    \
+/* 查找键所在的槽，不存在时返回-1 */                                                \
+static int64_t __##name##_find(const name##_t* table, key_type key)                 \
+{                                                                                   \
+    uint32_t    index = mix(key) & table->mask;                                     \
+    uint32_t    dist = 1;                                                           \
+                                                                                    \
+    for (;;) {                                                                      \
+        if (table->slots[index].dist < dist) {                                      \
+            return -1;                                                              \
+        }                                                                           \
+        if (table->slots[index].dist == dist && table->slots[index].key == key) {   \
+            return index;                                                           \
+        }                                                                           \
+        index = (index + 1) & table->mask;                                          \
+        dist++;                                                                     \
+    }                                                                               \
+}                                                                                   \
+                                                                                    \
+static int __##name##_resize(name##_t* table, uint32_t slot_num)                    \
+{                                                                                   \
+    name##_slot_t*  new_slots = NULL;                                               \
+                                                                                    \
+    if (!slot_num) {                                                                \
+        return BLIVE_ERR_OUTOFMEM;                                                  \
+    }                                                                               \
+    new_slots = zero_alloc(sizeof(name##_slot_t) * slot_num);                       \
+    if (new_slots == NULL) {                                                        \
+        return BLIVE_ERR_OUTOFMEM;                                                  \
+    }                                                                               \
+    for (uint32_t i = 0; table->slots != NULL && i <= table->mask; i++) {           \
+        if (table->slots[i].dist) {                                                 \
+            __##name##_place(new_slots, slot_num - 1, table->slots[i].key, table->slots[i].value); \
+        }                                                                           \
+    }                                                                               \
+    free(table->slots);                                                             \
+    table->slots = new_slots;                                                       \
+    table->mask = slot_num - 1;                                                     \
+                                                                                    \
+    return BLIVE_ERR_OK;                                                            \
+}                                                                                   \
+                                                                                    \
+int name##_create(name##_t** table, uint32_t size)                                  \
+{                                                                                   \
+    name##_t*   new_table = NULL;                                                   \
+                                                                                    \
+    if (table == NULL) {                                                            \
+        return BLIVE_ERR_NULLPTR;                                                   \
+    }                                                                               \
+                                                                                    \
+    new_table = zero_alloc(sizeof(name##_t));                                       \
+    if (new_table == NULL) {                                                        \
+        return BLIVE_ERR_OUTOFMEM;                                                  \
+    }                                                                               \
+    if (__##name##_resize(new_table, __hash_slot_num(size)) != BLIVE_ERR_OK) {      \
+        free(new_table);                                                            \
+        return BLIVE_ERR_OUTOFMEM;                                                  \
+    }                                                                               \
+    *table = new_table;                                                             \
+                                                                                    \
+    return BLIVE_ERR_OK;                                                            \
+}                                                                                   \
+                                                                                    \
+int name##_destroy(name##_t* table)                                                 \
+{                                                                                   \
+    if (table == NULL) {                                                            \
+        return BLIVE_ERR_NULLPTR;                                                   \
+    }                                                                               \
+                                                                                    \
+    free(table->slots);                                                             \
+    free(table);                                                                    \
+                                                                                    \
+    return BLIVE_ERR_OK;                                                            \
+}                                                                                   \
+                                                                                    \
+int name##_push(name##_t* table, key_type key, const void* value, void** old_value) \
+{                                                                                   \
+    int64_t     index = 0;                                                          \
+    int         retval = BLIVE_ERR_OK;                                              \
+                                                                                    \
+    if (table == NULL || value == NULL) {                                           \
+        return BLIVE_ERR_NULLPTR;                                                   \
+    }                                                                               \
+                                                                                    \
+    index = __##name##_find(table, key);                                            \
+    if (index >= 0) {                                                               \
+        if (old_value != NULL) {                                                    \
+            *old_value = table->slots[index].value;                                 \
+        }                                                                           \
+        table->slots[index].value = (void*)value;                                   \
+        return BLIVE_ERR_OK;                                                        \
+    }                                                                               \
+                                                                                    \
+    if ((uint64_t)(table->count + 1) * HASH_INT_LOAD_DEN > (uint64_t)(table->mask + 1) * HASH_INT_LOAD_NUM) { \
+        retval = __##name##_resize(table, __hash_slot_num(table->count + 1));       \
+        if (retval != BLIVE_ERR_OK) {                                               \
+            return retval;                                                          \
+        }                                                                           \
+    }                                                                               \
+    __##name##_place(table->slots, table->mask, key, (void*)value);                 \
+    table->count++;                                                                 \
+    if (old_value != NULL) {                                                        \
+        *old_value = NULL;                                                          \
+    }                                                                               \
+                                                                                    \
+    return BLIVE_ERR_OK;                                                            \
+}                                                                                   \
+                                                                                    \
+void* name##_peek(const name##_t* table, key_type key)                              \
+{                                                                                   \
+    int64_t     index = 0;                                                          \
+                                                                                    \
+    if (table == NULL) {                                                            \
+        return NULL;                                                                \
+    }                                                                               \
+    index = __##name##_find(table, key);                                            \
+    return (index >= 0) ? table->slots[index].value : NULL;                         \
+}                                                                                   \
+                                                                                    \
+void* name##_pop(name##_t* table, key_type key)                                     \
+{                                                                                   \
+    int64_t     found = 0;                                                          \
+    uint32_t    index = 0;                                                          \
+    uint32_t    next = 0;                                                           \
+    void*       value = NULL;                                                       \
+                                                                                    \
+    if (table == NULL || (found = __##name##_find(table, key)) < 0) {               \
+        return NULL;                                                                \
+    }                                                                               \
+                                                                                    \
+    /* 后续不在理想位置上的元素依次前移一格，直到遇到空槽或者在理想位置的元素 */    \
+    index = (uint32_t)found;                                                        \
+    value = table->slots[index].value;                                              \
+    for (;;) {                                                                      \
+        next = (index + 1) & table->mask;                                           \
+        if (table->slots[next].dist <= 1) {                                         \
+            break;                                                                  \
+        }                                                                           \
+        table->slots[index] = table->slots[next];                                   \
+        table->slots[index].dist--;                                                 \
+        index = next;                                                               \
+    }                                                                               \
+    table->slots[index].dist = 0;                                                   \
+    table->slots[index].value = NULL;                                               \
+    table->count--;                                                                 \
+                                                                                    \
+    return value;                                                                   \
+}                                                                                   \
+                                                                                    \
+uint32_t name##_count(const name##_t* table)                                        \
+{                                                                                   \
+    return (table != NULL) ? table->count : 0;                                      \
+}                                                                                   \
+                                                                                    \
+void name##_foreach(const name##_t* table, name##_cb callback, void* context)       \
+{                                                                                   \
+    if (table == NULL || callback == NULL) {                                        \
+        return ;                                                                    \
+    }                                                                               \
+    for (uint32_t i = 0; i <= table->mask; i++) {                                   \
+        if (table->slots[i].dist && !callback(table->slots[i].key, table->slots[i].value, context)) { \
+            return ;                                                                \
+        }                                                                           \
+    }                                                                               \
+}
+
+HASH_INT_DEFINE(hash_u32, uint32_t, __hash_mix32)
+HASH_INT_DEFINE(hash_u64, uint64_t, __hash_mix64)
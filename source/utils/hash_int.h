@@ -0,0 +1,123 @@
+/**
+ * @file hash_int.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 以整数为键的哈希表，用于uid、fd等整数键的场景。采用Robin Hood开放寻址，
+ *        键和值直接存放在槽数组中，插入、删除都不需要为每个元素申请内存。
+ * @attention 删除时将后续元素整体前移（backward shift），不使用墓碑标记，表中不
+ * 会积累已删除的槽。哈希表本身不加锁，遍历过程中不能修改。
+ * @version 0.1
+ * @date 2023-03-24
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_HASH_INT_H__
+#define __UTILS_HASH_INT_H__
+
+#include "utils.h"
+
+
+/**
+ * @brief 以uint32_t为键的哈希表
+ *
+ */
+typedef struct hash_u32 hash_u32_t;
+
+/**
+ * @brief 以uint64_t为键的哈希表
+ *
+ */
+typedef struct hash_u64 hash_u64_t;
+
+/**
+ * @brief 遍历哈希表使用的回调函数
+ *
+ * @param [in] key 元素的键
+ * @param [in] value 元素的值
+ * @param [in] context 回调者依赖的上下文
+ * @return 返回False将会停止遍历立即结束
+ */
+typedef Bool (*hash_u32_cb)(uint32_t key, void* value, void* context);
+typedef Bool (*hash_u64_cb)(uint64_t key, void* value, void* context);
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 创建一个哈希表
+ *
+ * @param [out] table 传出参数
+ * @param [in] size 预计保存的元素数量，为0时使用默认大小
+ * @return int
+ */
+int hash_u64_create(hash_u64_t** table, uint32_t size);
+
+/**
+ * @brief 销毁一个哈希表，值所指向的内存由调用者负责释放
+ *
+ * @param [in] table 哈希表
+ * @return int
+ */
+int hash_u64_destroy(hash_u64_t* table);
+
+/**
+ * @brief 插入或替换键对应的值
+ *
+ * @param [in] table 哈希表
+ * @param [in] key 键
+ * @param [in] value 值，不能为NULL
+ * @param [out] old_value 传出参数，被替换的值，键不存在时为NULL，不关心时可以传入NULL
+ * @return int 扩容失败时返回BLIVE_ERR_OUTOFMEM，表中的内容不变
+ */
+int hash_u64_push(hash_u64_t* table, uint64_t key, const void* value, void** old_value);
+
+/**
+ * @brief 获取键对应的值
+ *
+ * @param [in] table 哈希表
+ * @param [in] key 键
+ * @return void* 键对应的值，键不存在时返回NULL
+ */
+void* hash_u64_peek(const hash_u64_t* table, uint64_t key);
+
+/**
+ * @brief 移除键对应的元素
+ *
+ * @param [in] table 哈希表
+ * @param [in] key 键
+ * @return void* 被移除的值，键不存在时返回NULL
+ */
+void* hash_u64_pop(hash_u64_t* table, uint64_t key);
+
+/**
+ * @brief 获取哈希表中元素的数量
+ *
+ * @param [in] table 哈希表
+ * @return uint32_t 元素的数量
+ */
+uint32_t hash_u64_count(const hash_u64_t* table);
+
+/**
+ * @brief 遍历哈希表，顺序不确定
+ *
+ * @param [in] table 哈希表
+ * @param [in] callback 回调函数
+ * @param [in] context 回调者依赖的上下文
+ */
+void hash_u64_foreach(const hash_u64_t* table, hash_u64_cb callback, void* context);
+
+/* 以下为uint32_t键的版本，用法与uint64_t键的版本相同 */
+int hash_u32_create(hash_u32_t** table, uint32_t size);
+int hash_u32_destroy(hash_u32_t* table);
+int hash_u32_push(hash_u32_t* table, uint32_t key, const void* value, void** old_value);
+void* hash_u32_peek(const hash_u32_t* table, uint32_t key);
+void* hash_u32_pop(hash_u32_t* table, uint32_t key);
+uint32_t hash_u32_count(const hash_u32_t* table);
+void hash_u32_foreach(const hash_u32_t* table, hash_u32_cb callback, void* context);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
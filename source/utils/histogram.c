@@ -0,0 +1,111 @@
+/**
+ * @file histogram.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 对数线性分桶的直方图。小于HISTOGRAM_SUB_BUCKETS的值每个值一个桶，
+ *        其余的值按最高位所在的2的幂分组，组内按次高的HISTOGRAM_SUB_BITS位分桶
+ * @version 0.1
+ * @date 2023-03-20
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "histogram.h"
+
+
+static inline uint32_t __bucket_index(uint64_t value)
+{
+    uint32_t    exponent = 0;
+
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return (uint32_t)value;
+    }
+
+    exponent = 63 - __builtin_clzll(value);
+    return (exponent - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS +
+           (uint32_t)((value >> (exponent - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/**
+ * @brief 获取桶所能表示的最大值
+ */
+static inline uint64_t __bucket_upper(uint32_t index)
+{
+    uint32_t    exponent = 0;
+    uint64_t    lower = 0;
+
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+
+    exponent = index / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BITS - 1;
+    lower = (uint64_t)(HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS) << (exponent - HISTOGRAM_SUB_BITS);
+    return lower + ((1ULL << (exponent - HISTOGRAM_SUB_BITS)) - 1);
+}
+
+
+void histogram_reset(histogram_t* hist)
+{
+    __atomic_store_n(&hist->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->sum, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->max, 0, __ATOMIC_RELAXED);
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        __atomic_store_n(&hist->buckets[i], 0, __ATOMIC_RELAXED);
+    }
+}
+
+void histogram_record(histogram_t* hist, uint64_t value)
+{
+    uint64_t    cur_max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+
+    __atomic_add_fetch(&hist->buckets[__bucket_index(value)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hist->sum, value, __ATOMIC_RELAXED);
+    while (value > cur_max &&
+           !__atomic_compare_exchange_n(&hist->max, &cur_max, value, True, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+uint64_t histogram_count(const histogram_t* hist)
+{
+    return __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+}
+
+uint64_t histogram_mean(const histogram_t* hist)
+{
+    uint64_t    count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+
+    return count ? __atomic_load_n(&hist->sum, __ATOMIC_RELAXED) / count : 0;
+}
+
+uint64_t histogram_max(const histogram_t* hist)
+{
+    return __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+}
+
+uint64_t histogram_percentile(const histogram_t* hist, double percentile)
+{
+    uint64_t    total = 0;
+    uint64_t    target = 0;
+    uint64_t    seen = 0;
+    uint64_t    max_value = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+
+    /* 记录可能与读取同时进行，以各个桶的实际计数之和为准 */
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        total += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+    }
+    if (!total) {
+        return 0;
+    }
+
+    percentile = percentile < 0 ? 0 : (percentile > 100 ? 100 : percentile);
+    target = (uint64_t)(percentile / 100 * total + 0.5);
+    target = target ? target : 1;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        if (seen >= target) {
+            return min(__bucket_upper(i), max_value);
+        }
+    }
+
+    return max_value;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file histogram.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 对数线性分桶的直方图（HDR风格）。每个2的幂区间再等分为若干个子桶，
+ *        相对误差不超过1/HISTOGRAM_SUB_BUCKETS，可以覆盖整个uint64_t的范围。
+ *        记录只有几次原子加，不加锁，适合在事件循环中统计耗时
+ * @version 0.1
+ * @date 2023-03-20
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_HISTOGRAM_H__
+#define __UTILS_HISTOGRAM_H__
+
+#include "utils.h"
+
+
+#define HISTOGRAM_SUB_BITS      4
+#define HISTOGRAM_SUB_BUCKETS   (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS       ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t    count;                          /* 记录的次数 */
+    uint64_t    sum;                            /* 所有记录值的和 */
+    uint64_t    max;                            /* 最大的记录值 */
+    uint64_t    buckets[HISTOGRAM_BUCKETS];
+} histogram_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 清空直方图
+ *
+ * @param [in] hist 直方图
+ */
+void histogram_reset(histogram_t* hist);
+
+/**
+ * @brief 记录一个值，可以在多个线程中同时调用
+ *
+ * @param [in] hist 直方图
+ * @param [in] value 记录的值
+ */
+void histogram_record(histogram_t* hist, uint64_t value);
+
+/**
+ * @brief 获取记录的次数
+ *
+ * @param [in] hist 直方图
+ * @return uint64_t
+ */
+uint64_t histogram_count(const histogram_t* hist);
+
+/**
+ * @brief 获取所有记录值的平均值
+ *
+ * @param [in] hist 直方图
+ * @return uint64_t 没有记录时返回0
+ */
+uint64_t histogram_mean(const histogram_t* hist);
+
+/**
+ * @brief 获取最大的记录值
+ *
+ * @param [in] hist 直方图
+ * @return uint64_t
+ */
+uint64_t histogram_max(const histogram_t* hist);
+
+/**
+ * @brief 获取百分位数，返回所在桶的上界，且不超过最大的记录值
+ *
+ * @param [in] hist 直方图
+ * @param [in] percentile 百分位，取值[0, 100]
+ * @return uint64_t 没有记录时返回0
+ */
+uint64_t histogram_percentile(const histogram_t* hist, double percentile);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -4,7 +4,7 @@
  * @brief 简易的http服务端，使用html注入来允许修改html页面内容
  * @version 0.1
  * @date 2023-02-26
- * 
+ *
  * @copyright Copyright (c) 2023
  */
 
@@ -12,33 +12,197 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <time.h>
 #include <sys/time.h>
 #ifdef WIN32
 #include <winsock2.h>
 #else
+#include <fcntl.h>
+#include <sys/uio.h>
 #include <net/if.h>
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
 #endif
 #include "httpd.h"
+#include "sha1.h"
+#include "mpsc_queue.h"
 #include "bliveq_internal.h"
 
 
-#define MAX_INJECTION_NUM   20
+#define MAX_INJECTION_NUM       20
+#define HTTPD_ROUTE_MAX         4           /* 最多可注册的接口数 */
+#define HTTPD_ROUTE_CACHE       8           /* 每个接口按查询参数缓存的响应数，不同的查询参数超过这个数时淘汰最久未使用的 */
+#define HTTPD_QUERY_SIZE        256         /* 接口可缓存的查询参数的最大长度 */
+#define HTTPD_LISTEN_BACKLOG    128
+#define HTTPD_ACCEPT_BATCH      64          /* 监听socket每次可读时最多接受的连接数，避免新连接挤占已有连接 */
+#define HTTPD_RBUF_SIZE         4096        /* 每个连接的读缓冲区大小，请求头超过这个长度时断开连接 */
+#define HTTPD_LINE_SIZE         20480       /* html文件中一行的最大长度，也是注入回调可写入的长度 */
+#define HTTPD_HEADER_SIZE       512         /* 响应头的最大长度 */
+#define HTTPD_WBUF_HIGH         (256 * 1024)        /* 待发送的响应超过这个长度时暂停处理流水线中的请求 */
+#define HTTPD_SEG_MAX           64          /* 每个连接的发送队列最多容纳的数据段数 */
+#define HTTPD_SEG_PER_RESPONSE  3           /* 一个响应最多占用的数据段数：响应头、Connection头部、响应体 */
+#define HTTPD_ETAG_SIZE         64
+#define HTTPD_KEEPALIVE_SECOND  15                  /* 保持连接的空闲超时，单位秒，页面每2秒刷新一次，需要大于刷新间隔 */
+#define HTTPD_KEEPALIVE_TIMEOUT (HTTPD_KEEPALIVE_SECOND * 1000 * 1000)
+#define __HTTPD_STR(x)          #x
+#define HTTPD_STR(x)            __HTTPD_STR(x)
+#define HTTPD_REQUEST_TIMEOUT   (10 * 1000 * 1000)  /* 开始接收请求后收齐请求头的超时，单位微秒us */
+#define HTTPD_WRITE_TIMEOUT     (30 * 1000 * 1000)  /* 发送响应时没有任何进展的超时，单位微秒us */
+#define HTTPD_EVENT_PATH        "/events"           /* 事件推送(Server-Sent Events)的路径 */
+#define HTTPD_EVENT_FRAME       (50 * 1000)         /* 合并通知的窗口，单位微秒us，窗口内的多次通知只推送一次 */
+#define HTTPD_EVENT_HEARTBEAT   (30 * 1000 * 1000)  /* 推送空闲时发送注释行的间隔，避免被中间的代理断开 */
+#define HTTPD_WS_PATH           "/ws"               /* WebSocket的路径 */
+#define HTTPD_WS_GUID           "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"  /* RFC 6455中计算Sec-WebSocket-Accept使用的GUID */
+#define HTTPD_WS_HEADER_MAX     10                  /* 服务端发送的帧头的最大长度，服务端的帧不带掩码 */
+
+typedef enum {
+    WS_OP_CONTINUATION = 0x0,
+    WS_OP_TEXT = 0x1,
+    WS_OP_BINARY = 0x2,
+    WS_OP_CLOSE = 0x8,
+    WS_OP_PING = 0x9,
+    WS_OP_PONG = 0xA,
+} ws_opcode;
+
+typedef enum {
+    WS_CLOSE_NORMAL = 1000,
+    WS_CLOSE_PROTOCOL = 1002,       /* 协议错误 */
+    WS_CLOSE_TOO_BIG = 1009,        /* 消息过大 */
+} ws_close_code;
 
 typedef enum {
     HTTP_HOME,
+    HTTP_OVERLAY,
     HTTP_NOTFOUND,
+    HTTP_FILE_MAX,
 } http_file;
 
+typedef enum {
+    HTTP_CONN_IDLE,         /* 保持连接，等待下一个请求 */
+    HTTP_CONN_READING,      /* 正在接收请求头 */
+    HTTP_CONN_WRITING,      /* 发送缓冲区已满，等待可写 */
+    HTTP_CONN_STREAMING,    /* 已订阅事件推送，等待下一次推送 */
+} http_conn_state;
+
+typedef struct {
+    char*       method;
+    char*       path;       /* 请求的路径，不含查询参数 */
+    char*       query;      /* '?'之后的查询参数，没有时为NULL */
+    Bool        keep_alive; /* 响应之后是否保持连接 */
+    Bool        head_only;  /* HEAD请求，只发送响应头 */
+    char*       if_none_match;  /* 客户端缓存的ETag，没有时为NULL */
+    uint32_t    body_len;   /* 请求体的长度，请求体会被丢弃 */
+    Bool        upgrade;    /* 请求升级为WebSocket，Upgrade与Connection头部都已包含 */
+    char*       ws_key;     /* Sec-WebSocket-Key，没有时为NULL */
+    char*       ws_version; /* Sec-WebSocket-Version，没有时为NULL */
+} http_request;
+
 typedef struct {
     const char*   html_label_name;
     void    (*callback)(char* dst, void* context);
     void*   context;
 } http_inject_unit;
 
+typedef struct {
+    char*       data;
+    uint32_t    len;        /* 已写入的长度 */
+    uint32_t    cap;        /* 申请的长度 */
+} http_buf;
+
+typedef struct {
+    uint32_t    ref;        /* 引用计数，只在引擎线程中修改 */
+    uint32_t    len;
+    char        data[];
+} http_chunk;   /* 只读的数据块，可以同时挂在多个连接的发送队列上 */
+
+typedef struct {
+    http_chunk* chunk;      /* 数据所属的块，静态字符串时为NULL */
+    const char* data;
+    uint32_t    len;
+} http_seg;     /* 发送队列中的一段数据 */
+
+typedef struct {
+    http_chunk* response;       /* 完整的响应，响应头中不含Connection头部与结尾的空行 */
+    uint32_t    header_len;     /* 响应头的长度 */
+    uint64_t    version;        /* 渲染前读取的页面内容版本号 */
+    uint64_t    config_version; /* 渲染前读取的配置版本号 */
+    char        etag[HTTPD_ETAG_SIZE];  /* 未设置页面内容版本号来源时为空 */
+} http_cache;   /* 渲染好的页面 */
+
+typedef struct {
+    http_cache  cache;
+    char        query[HTTPD_QUERY_SIZE];    /* 缓存对应的查询参数 */
+    uint64_t    last_used;                  /* 最近一次使用的序号，用于淘汰 */
+} http_route_cache;
+
+typedef struct {
+    const char*         path;
+    blive_errno_t       (*callback)(const char* query, char** data, uint32_t* len, void* context);
+    uint64_t            (*version_cb)(void* context);
+    void*               context;
+    http_route_cache    cache[HTTPD_ROUTE_CACHE];
+    uint64_t            use_count;
+} http_route;   /* 返回数据的接口，响应按查询参数与版本号缓存 */
+
+typedef struct {
+    mpsc_node_t node;
+    uint32_t    len;
+    char        data[];     /* 已经加上帧头的完整的帧 */
+} http_ws_msg;  /* 其他线程提交的广播消息，在引擎线程中合并发送 */
+
+typedef struct {
+    list                list_node;      /* 挂在httpd_handler的连接链表上 */
+    httpd_handler*      handler;
+    fd_t                fd;
+    http_conn_state     state;
+    Bool                closing;        /* 发送完写缓冲区中的响应后关闭连接 */
+    Bool                half_closed;    /* 对端已经关闭写入，不会再有新的请求 */
+    Bool                streaming;      /* 已订阅事件推送或者升级为WebSocket，不再处理之后的请求 */
+    Bool                websocket;      /* 已升级为WebSocket，读缓冲区中是客户端发送的帧 */
+    Bool                event_missed;   /* 推送时发送队列已满，队列空出后补发最新的一帧或者快照 */
+    list                event_node;     /* 挂在httpd_handler的订阅链表或者WebSocket链表上 */
+    select_timer_t      timer;          /* 超时定时器，已触发时为SELECT_TIMER_INVALID */
+    uint32_t            rlen;           /* 读缓冲区中已接收的长度，可能包含流水线中的多个请求 */
+    uint32_t            discard;        /* 还需要丢弃的请求体长度 */
+    char                rbuf[HTTPD_RBUF_SIZE];
+    http_seg            segs[HTTPD_SEG_MAX];    /* 发送队列，环形数组，流水线中的多个响应按顺序排列 */
+    uint32_t            seg_head;
+    uint32_t            seg_num;
+    uint32_t            pending;        /* 发送队列中数据的总长度 */
+} http_conn;
+
 struct httpd_handler {
     fd_t                httpd_socket;
+    select_engine_t*    engine;         /* 所有的连接都在这个引擎的线程中处理 */
+    Bool                accepting;      /* 监听socket是否在引擎中监视，连接数达到上限时暂停 */
+    uint32_t            conn_num;
+    uint32_t            max_conn;
+    list                conn_list;
+    http_buf            body;           /* 渲染页面时使用的缓冲区，只在引擎线程中使用 */
+    http_cache          cache[HTTP_FILE_MAX];
+    uint64_t            (*version_cb)(void* context);   /* 页面内容的版本号来源 */
+    void*               version_ctx;
+    uint64_t            config_version; /* 注入的配置变化时加一 */
+    uint64_t            boot_id;        /* 创建时的时间，区分不同进程生成的ETag */
+    void                (*event_cb)(char* dst, void* context);  /* 生成推送内容的回调 */
+    void*               event_ctx;
+    list                event_list;     /* 订阅了事件推送的连接 */
+    uint32_t            event_num;
+    http_chunk*         event_frame;    /* 最近一次推送的内容，新的订阅者先收到这一帧 */
+    uint64_t            event_id;
+    Bool                event_pending;  /* 已有通知在等待推送，之后的通知合并到这一次 */
+    select_timer_t      event_timer;
+    blive_errno_t       (*ws_cb)(char** data, uint32_t* len, void* context);    /* 生成WebSocket快照的回调 */
+    void*               ws_ctx;
+    list                ws_list;        /* 已升级为WebSocket的连接 */
+    uint32_t            ws_num;
+    mpsc_queue_t        ws_queue;       /* 等待广播的消息 */
+    Bool                ws_pending;     /* 已经唤醒引擎广播，之后的消息在同一轮中发出 */
+    http_route          routes[HTTPD_ROUTE_MAX];
+    uint32_t            route_num;
+    char                line[HTTPD_LINE_SIZE];
     uint32_t            html_cur_inject_num;
     http_inject_unit    injection_list[MAX_INJECTION_NUM];
 };
@@ -48,74 +212,143 @@ static const struct {
     char*   request_path;
     char*   filepath;
     char*   content_type;
-    char*   status_line;
+    char*   status;
 } httpfile_map[] = {
-    {"/",       "./config/htdocs/index.html",      "text/html",     "HTTP/1.0 200 OK\r\n"},
-    {"",        "./config/htdocs/404.html",        "text/html",     "HTTP/1.0 404 Not Found\r\n"},
+    {"/",       "./config/htdocs/index.html",      "text/html",     "200 OK"},
+    {"/overlay", "./config/htdocs/overlay.html",   "text/html",     "200 OK"},
+    {"",        "./config/htdocs/404.html",        "text/html",     "404 Not Found"},
 };
 
+static const char http_conn_close[] = "Connection: close\r\n\r\n";
+static const char http_conn_keep_alive[] = "Connection: keep-alive\r\nKeep-Alive: timeout=" HTTPD_STR(HTTPD_KEEPALIVE_SECOND) "\r\n\r\n";
+/*事件推送的响应没有长度，以关闭连接结束，retry为浏览器断线重连的间隔(ms)*/
+static const char http_event_header[] = "HTTP/1.1 200 OK\r\nServer: zqn httpd/0.1.0\r\nContent-Type: text/event-stream\r\n"
+                                        "Cache-Control: no-cache\r\nConnection: close\r\n\r\nretry: 1000\n\n";
+static const char http_event_heartbeat[] = ":\n\n";
+static const char http_ws_ping[] = "\x89\x00";
 
-static int get_filename(char* buf);
-static blive_errno_t http_sendfile(fd_t fd, http_file file, httpd_handler* handler);
+
+static blive_errno_t __socket_nonblock(fd_t fd);
+static void __socket_close(fd_t fd);
+static http_file get_filename(const char* path);
 static void do_html_inject(char* dst, httpd_handler* handler);
+static void __httpd_accept(fd_t fd, uint32_t events, void* context);
+static void __conn_io(fd_t fd, uint32_t events, void* context);
+static void __conn_timeout(void* context);
+static void __conn_close(http_conn* conn);
+static void __conn_consume(http_conn* conn, uint32_t sent);
+static void __chunk_unref(http_chunk* chunk);
+static void __conn_sync(http_conn* conn, blive_errno_t retval);
+static Bool __conn_can_queue(const http_conn* conn);
+static void __conn_push(http_conn* conn, http_chunk* chunk, const char* data, uint32_t len);
+static blive_errno_t __conn_flush(http_conn* conn);
+static void __httpd_event_arm(void* context);
+static void __httpd_ws_broadcast(void* context);
+static uint32_t __ws_frame_header(char* dst, ws_opcode opcode, uint64_t len);
 
 
 
-blive_errno_t http_create(httpd_handler** handler, const char* ip, uint16_t port)
+blive_errno_t http_create(httpd_handler** handler, select_engine_t* engine, const char* ip, uint16_t port)
 {
     httpd_handler*      new_httpd = NULL;
     struct sockaddr_in  saddr;
-    int                 res = 0;
     int                 val_1 = 1;
+    blive_errno_t       retval = BLIVE_ERR_OK;
 
-    if (handler == NULL) {
+    if (handler == NULL || engine == NULL || ip == NULL) {
         return BLIVE_ERR_NULLPTR;
     }
     new_httpd = zero_alloc(sizeof(httpd_handler));
     if (new_httpd == NULL) {
         return BLIVE_ERR_OUTOFMEM;
     }
+    new_httpd->engine = engine;
+    new_httpd->max_conn = HTTPD_MAX_CONN;
+    new_httpd->boot_id = (uint64_t)time(NULL);
+    LIST_NODE_INIT(&new_httpd->conn_list);
+    LIST_NODE_INIT(&new_httpd->event_list);
+    LIST_NODE_INIT(&new_httpd->ws_list);
+    mpsc_queue_init(&new_httpd->ws_queue);
 
 #ifdef WIN32
     WORD sockVersion = MAKEWORD(2, 2);
     WSADATA wsaData;
     if (WSAStartup(sockVersion, &wsaData) != 0) {
-        return BLIVE_ERR_UNKNOWN;
+        retval = BLIVE_ERR_UNKNOWN;
+        goto _free;
     }
 #endif
     new_httpd->httpd_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (new_httpd->httpd_socket < 0) {
+        blive_loge("socket error(%s)\n", strerror(errno));
+        retval = BLIVE_ERR_UNKNOWN;
+        goto _free;
+    }
 
-    /*bind*/
+    /*bind，重启后需要立即复用处于TIME_WAIT的端口，因此在bind之前设置*/
+    setsockopt(new_httpd->httpd_socket, SOL_SOCKET, SO_REUSEADDR, (char*)&val_1, sizeof(int));
     memset(&saddr, 0, sizeof(saddr));
     saddr.sin_family = AF_INET;
     saddr.sin_port = htons(port);
     saddr.sin_addr.s_addr = inet_addr(ip);
-    res = bind(new_httpd->httpd_socket, (struct sockaddr*)&saddr, sizeof(saddr));
-    if (res == -1) {
+    if (bind(new_httpd->httpd_socket, (struct sockaddr*)&saddr, sizeof(saddr)) == -1) {
         blive_loge("bind error(%s)\n", strerror(errno));
-        return BLIVE_ERR_UNKNOWN;
+        retval = BLIVE_ERR_UNKNOWN;
+        goto _close;
     }
-    setsockopt(new_httpd->httpd_socket, SOL_SOCKET, SO_REUSEADDR, &val_1, sizeof(int));
     /*listen*/
-    res = listen(new_httpd->httpd_socket, 10);
-    if (res == -1) {
+    if (listen(new_httpd->httpd_socket, HTTPD_LISTEN_BACKLOG) == -1) {
         blive_loge("listen error\n");
-        return BLIVE_ERR_UNKNOWN;
+        retval = BLIVE_ERR_UNKNOWN;
+        goto _close;
+    }
+    if (__socket_nonblock(new_httpd->httpd_socket) != BLIVE_ERR_OK) {
+        retval = BLIVE_ERR_UNKNOWN;
+        goto _close;
     }
 
     *handler = new_httpd;
     return BLIVE_ERR_OK;
+
+_close:
+    __socket_close(new_httpd->httpd_socket);
+_free:
+    free(new_httpd);
+    return retval;
 }
 
 blive_errno_t http_destroy(httpd_handler* handler)
 {
+    list*           list_ptr = NULL;
+    mpsc_node_t*    node = NULL;
+
     if (handler == NULL) {
         return BLIVE_ERR_NULLPTR;
     }
 
-    if (handler->httpd_socket) {
-        shutdown(handler->httpd_socket, SHUT_RDWR);
+    if (handler->accepting) {
+        select_engine_fd_del(handler->engine, handler->httpd_socket);
+    }
+    while ((list_ptr = handler->conn_list.next) != &handler->conn_list) {
+        __conn_close(list_entry(list_ptr, http_conn, list_node));
+    }
+    __socket_close(handler->httpd_socket);
+    if (handler->event_timer != SELECT_TIMER_INVALID) {
+        select_engine_schedule_cancel(handler->engine, handler->event_timer);
+    }
+    for (int file = 0; file < HTTP_FILE_MAX; file++) {
+        __chunk_unref(handler->cache[file].response);
     }
+    for (uint32_t route = 0; route < handler->route_num; route++) {
+        for (int index = 0; index < HTTPD_ROUTE_CACHE; index++) {
+            __chunk_unref(handler->routes[route].cache[index].cache.response);
+        }
+    }
+    __chunk_unref(handler->event_frame);
+    while ((node = mpsc_queue_pop(&handler->ws_queue)) != NULL) {
+        free(list_entry(node, http_ws_msg, node));
+    }
+    free(handler->body.data);
     free(handler);
 
     return BLIVE_ERR_OK;
@@ -123,52 +356,30 @@ blive_errno_t http_destroy(httpd_handler* handler)
 
 blive_errno_t http_perform(httpd_handler* handler)
 {
-    struct sockaddr_in  addr;
-    socklen_t           socklen = sizeof(struct sockaddr);
-    fd_t                conn_fd = FD_NULL;
-    int                 buffer_len = 0;
-    char                buffer[1024] = {0};
-    int                 file = HTTP_NOTFOUND;
+    blive_errno_t   retval = BLIVE_ERR_OK;
 
-#ifdef WIN32
-    WORD sockVersion = MAKEWORD(2, 2);
-    WSADATA wsaData;
-    if (WSAStartup(sockVersion, &wsaData) != 0) {
-        return ERROR;
+    if (handler == NULL) {
+        return BLIVE_ERR_NULLPTR;
     }
-#endif
 
-    while (1) {
-        /*接受tcp连接*/
-        conn_fd = accept(handler->httpd_socket, (struct sockaddr*)&addr, &socklen);
-        blive_logd("recv socket: %d, %d", conn_fd, errno);
-
-        /*读取http请求*/
-        buffer_len = fd_read(conn_fd, buffer, sizeof(buffer) - 1);
-        if (buffer_len < 0) {
-            blive_loge("read %d(%s)!", buffer_len, strerror(errno));
-            shutdown(conn_fd, SHUT_RDWR);
-            continue;
-        }
-        blive_logd("%s", buffer);
+    retval = select_engine_fd_watch(handler->engine, handler->httpd_socket, SELECT_EVENT_READ, __httpd_accept, handler);
+    if (retval == BLIVE_ERR_OK) {
+        handler->accepting = True;
+    }
 
-        /*解析http请求*/
-        file = get_filename(buffer);
-        if (file < 0) {
-            blive_loge("remote closed");
-            shutdown(conn_fd, SHUT_RDWR);
-            continue;
-        }
-        blive_logd("get file %d", file);
+    return retval;
+}
 
-        /*发送http响应*/
-        if (http_sendfile(conn_fd, file, handler) != BLIVE_ERR_OK) {
-            blive_loge("error occurred: %d(%s)", errno, strerror(errno));
-        }
-        memset(buffer, 0, sizeof(buffer));
-        shutdown(conn_fd, SHUT_RDWR);
+blive_errno_t http_set_max_conn(httpd_handler* handler, uint32_t max_conn)
+{
+    if (handler == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+    if (!max_conn) {
+        return BLIVE_ERR_INVALID;
     }
 
+    handler->max_conn = max_conn;
     return BLIVE_ERR_OK;
 }
 
@@ -185,104 +396,1738 @@ blive_errno_t http_html_injection(httpd_handler* handler, const char* inject_wor
     handler->injection_list[handler->html_cur_inject_num].callback = callback;
     handler->injection_list[handler->html_cur_inject_num].context = context;
     handler->html_cur_inject_num++;
+    __atomic_add_fetch(&handler->config_version, 1, __ATOMIC_RELEASE);
+
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t http_html_version(httpd_handler* handler, uint64_t (*callback)(void*), void* context)
+{
+    if (handler == NULL || callback == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    handler->version_cb = callback;
+    handler->version_ctx = context;
+    __atomic_add_fetch(&handler->config_version, 1, __ATOMIC_RELEASE);
 
     return BLIVE_ERR_OK;
 }
 
+blive_errno_t http_event_source(httpd_handler* handler, void (*callback)(char*, void*), void* context)
+{
+    if (handler == NULL || callback == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
 
+    handler->event_cb = callback;
+    handler->event_ctx = context;
+    return BLIVE_ERR_OK;
+}
 
-static int get_filename(char* buf)
+blive_errno_t http_event_notify(httpd_handler* handler)
 {
-    char*       s = strtok(buf, " ");
-    http_file   file = HTTP_HOME;
+    if (handler == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+    if (handler->event_cb == NULL) {
+        return BLIVE_ERR_OK;
+    }
 
-    if (s == NULL) {
-        blive_loge("request message invalid:\r\n%s", buf);
-        return BLIVE_ERR_INVALID;
+    /*已经有通知在等待推送时直接返回，只有第一个通知需要唤醒引擎*/
+    if (__atomic_exchange_n(&handler->event_pending, True, __ATOMIC_ACQ_REL)) {
+        return BLIVE_ERR_OK;
     }
+    return select_engine_post(handler->engine, __httpd_event_arm, handler);
+}
 
-    blive_logd("request method: %s\n", s);
-    s = strtok(NULL," ");
-    if (s == NULL) {
-        blive_loge("request not include resource name");
-        return BLIVE_ERR_NOTEXSIT;
+blive_errno_t http_ws_source(httpd_handler* handler, blive_errno_t (*callback)(char**, uint32_t*, void*), void* context)
+{
+    if (handler == NULL || callback == NULL) {
+        return BLIVE_ERR_NULLPTR;
     }
 
-    while (file < HTTP_NOTFOUND) {
-        if (!strcmp(httpfile_map[file].request_path, s)) {
-            blive_logd("request resource %s found", s);
-            return file;
-        }
-        file++;
+    handler->ws_cb = callback;
+    handler->ws_ctx = context;
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t http_ws_broadcast(httpd_handler* handler, const char* data, uint32_t len)
+{
+    http_ws_msg*    msg = NULL;
+    blive_errno_t   retval = BLIVE_ERR_OK;
+
+    if (handler == NULL || data == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+    if (handler->ws_cb == NULL) {
+        return BLIVE_ERR_OK;
     }
 
-    blive_loge("request resource not found [%s]", s);
-    return HTTP_NOTFOUND;
+    /*在调用者的线程中加上帧头，引擎线程只需要拼接*/
+    msg = malloc(sizeof(http_ws_msg) + HTTPD_WS_HEADER_MAX + len);
+    if (msg == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    msg->len = __ws_frame_header(msg->data, WS_OP_TEXT, len);
+    memcpy(msg->data + msg->len, data, len);
+    msg->len += len;
+    mpsc_queue_push(&handler->ws_queue, &msg->node);
+
+    /*先入队再设置标志，引擎清除标志之后入队的消息一定会由下一次唤醒发出*/
+    if (__atomic_exchange_n(&handler->ws_pending, True, __ATOMIC_ACQ_REL)) {
+        return BLIVE_ERR_OK;
+    }
+    retval = select_engine_post(handler->engine, __httpd_ws_broadcast, handler);
+    if (retval != BLIVE_ERR_OK) {
+        __atomic_store_n(&handler->ws_pending, False, __ATOMIC_RELEASE);
+    }
+    return retval;
 }
 
-static blive_errno_t http_sendfile(fd_t fd, http_file file, httpd_handler* handler)
+blive_errno_t http_api_route(httpd_handler* handler, const char* path,
+                             blive_errno_t (*callback)(const char*, char**, uint32_t*, void*),
+                             uint64_t (*version)(void*), void* context)
 {
-    FILE*   fp = NULL;
-    char    data[20480] = {0};
-    char*   status_line = NULL;
-    char*   server_field = "Server: zqn httpd/0.1.0\r\n";
-    char    content_type[256] = {0};
+    http_route*     route = NULL;
 
-    fp = fopen(httpfile_map[file].filepath, "r");
-    if (fp == NULL) {
-        file = HTTP_NOTFOUND;
-        fp = fopen(httpfile_map[HTTP_NOTFOUND].filepath, "r");
+    if (handler == NULL || path == NULL || callback == NULL) {
+        return BLIVE_ERR_NULLPTR;
     }
-    status_line = httpfile_map[file].status_line;
-    snprintf(content_type, 255, "Content-Type: %s\r\n", httpfile_map[file].content_type);
+    if (handler->route_num == HTTPD_ROUTE_MAX) {
+        return BLIVE_ERR_RESOURCE;
+    }
+
+    route = &handler->routes[handler->route_num];
+    route->path = path;
+    route->callback = callback;
+    route->version_cb = version;
+    route->context = context;
+    handler->route_num++;
+
+    return BLIVE_ERR_OK;
+}
 
-    if (fd_write(fd, status_line, strlen(status_line)) < 0) {
-        goto _WRITE_ERR;
+/**
+ * @brief 十六进制字符的值
+ *
+ * @return int 不是十六进制字符时返回-1
+ */
+static inline int __hex_value(char ch)
+{
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
     }
-    if (fd_write(fd, server_field, strlen(server_field)) < 0) {
-        goto _WRITE_ERR;
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
     }
-    if (fd_write(fd, content_type, strlen(content_type)) < 0) {
-        goto _WRITE_ERR;
+    return -1;
+}
+
+blive_errno_t http_query_param(const char* query, const char* key, char* value, uint32_t size)
+{
+    size_t      key_len = 0;
+    const char* end = NULL;
+    uint32_t    len = 0;
+
+    if (query == NULL || key == NULL || value == NULL) {
+        return BLIVE_ERR_NULLPTR;
     }
-    if (fd_write(fd, "\r\n", 2) < 0) {
-        goto _WRITE_ERR;
+    if (!size) {
+        return BLIVE_ERR_INVALID;
     }
 
-    /*发送html文件，并在其中进行html标签的注入*/
-    fgets(data, sizeof(data), fp);
-    while (!feof(fp)) {
-        /*如果配置了http注入，进行http注入部分的替换*/
-        do_html_inject(data, handler);
-        if (fd_write(fd, data, strlen(data)) < 0) {
-            goto _WRITE_ERR;
+    key_len = strlen(key);
+    while (*query) {
+        end = query + strcspn(query, "&");
+        if ((size_t)(end - query) >= key_len && !strncmp(query, key, key_len) &&
+            (query[key_len] == '=' || query + key_len == end)) {
+            /*解码'+'与%XX，不合法的%XX原样保留*/
+            for (query += key_len + (query[key_len] == '='); query < end; query++) {
+                if (len + 1 == size) {
+                    value[len] = '\0';
+                    return BLIVE_ERR_RESOURCE;
+                }
+                if (*query == '+') {
+                    value[len++] = ' ';
+                } else if (*query == '%' && end - query >= 3 && __hex_value(query[1]) >= 0 && __hex_value(query[2]) >= 0) {
+                    value[len++] = (char)(__hex_value(query[1]) * 16 + __hex_value(query[2]));
+                    query += 2;
+                } else {
+                    value[len++] = *query;
+                }
+            }
+            value[len] = '\0';
+            return BLIVE_ERR_OK;
         }
-        fgets(data, sizeof(data), fp);
+        query = *end ? end + 1 : end;
+    }
+
+    return BLIVE_ERR_NOTEXSIT;
+}
+
+blive_errno_t http_cache_invalidate(httpd_handler* handler)
+{
+    if (handler == NULL) {
+        return BLIVE_ERR_NULLPTR;
     }
-    do_html_inject(data, handler);
-    if (fd_write(fd, data, strlen(data)) < 0) {
-        goto _WRITE_ERR;
+
+    __atomic_add_fetch(&handler->config_version, 1, __ATOMIC_RELEASE);
+    return BLIVE_ERR_OK;
+}
+
+
+
+static blive_errno_t __socket_nonblock(fd_t fd)
+{
+#ifdef WIN32
+    u_long  mode = 1;
+
+    return ioctlsocket(fd, FIONBIO, &mode) == 0 ? BLIVE_ERR_OK : BLIVE_ERR_UNKNOWN;
+#else
+    int     flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        blive_loge("set nonblock error(%s)", strerror(errno));
+        return BLIVE_ERR_UNKNOWN;
+    }
+    return BLIVE_ERR_OK;
+#endif
+}
+
+static inline void __socket_close(fd_t fd)
+{
+#ifdef WIN32
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+}
+
+/**
+ * @brief 非阻塞socket的读写是否只是暂时无法进行
+ *
+ * @return Bool
+ */
+static inline Bool __socket_would_block(void)
+{
+#ifdef WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK ? True : False;
+#else
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? True : False;
+#endif
+}
+
+static blive_errno_t __buf_reserve(http_buf* buf, uint32_t size)
+{
+    char*       data = NULL;
+    uint32_t    cap = buf->cap ? buf->cap : 1024;
+
+    if (buf->len + size <= buf->cap) {
+        return BLIVE_ERR_OK;
+    }
+    while (cap < buf->len + size) {
+        cap *= 2;
+    }
+    data = realloc(buf->data, cap);
+    if (data == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
     }
+    buf->data = data;
+    buf->cap = cap;
 
-    fclose(fp);
     return BLIVE_ERR_OK;
+}
+
+static blive_errno_t __buf_append(http_buf* buf, const char* data, uint32_t size)
+{
+    if (__buf_reserve(buf, size) != BLIVE_ERR_OK) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    memcpy(buf->data + buf->len, data, size);
+    buf->len += size;
 
-_WRITE_ERR:
-    fclose(fp);
-    return BLIVE_ERR_TERMINATE;
+    return BLIVE_ERR_OK;
 }
 
-static inline void do_html_inject(char* dst, httpd_handler* handler)
+/**
+ * @brief 监听socket可读时，接受新的连接并放入引擎中监视。连接数达到上限时暂停监听，
+ *        等已有的连接关闭后再恢复，多出的连接留在内核的队列中
+ *
+ * @param [in] fd 监听socket
+ * @param [in] events 就绪的事件
+ * @param [in] context httpd_handler
+ */
+static void __httpd_accept(fd_t fd, uint32_t events, void* context)
 {
-    if (!handler->html_cur_inject_num) {
+    httpd_handler*      handler = (httpd_handler*)context;
+    http_conn*          conn = NULL;
+    struct sockaddr_in  addr;
+    socklen_t           socklen = 0;
+    fd_t                conn_fd = FD_NULL;
+
+    for (int count = 0; count < HTTPD_ACCEPT_BATCH; count++) {
+        if (handler->conn_num >= handler->max_conn) {
+            blive_logi("httpd reach max connection %u, pause accepting", handler->max_conn);
+            select_engine_fd_del(handler->engine, fd);
+            handler->accepting = False;
+            return ;
+        }
+
+        socklen = sizeof(addr);
+        conn_fd = accept(fd, (struct sockaddr*)&addr, &socklen);
+        if (conn_fd < 0) {
+            if (!__socket_would_block()) {
+                blive_loge("accept error(%s)", strerror(errno));
+            }
+            return ;
+        }
+        blive_logd("recv socket: %d", conn_fd);
+
+        conn = zero_alloc(sizeof(http_conn));
+        if (conn == NULL) {
+            __socket_close(conn_fd);
+            continue;
+        }
+        conn->handler = handler;
+        conn->fd = conn_fd;
+        conn->state = HTTP_CONN_READING;
+        if (__socket_nonblock(conn_fd) != BLIVE_ERR_OK ||
+            select_engine_schedule_add(handler->engine, __conn_timeout, conn, HTTPD_REQUEST_TIMEOUT, &conn->timer) != BLIVE_ERR_OK) {
+            __socket_close(conn_fd);
+            free(conn);
+            continue;
+        }
+        if (select_engine_fd_watch(handler->engine, conn_fd, SELECT_EVENT_READ, __conn_io, conn) != BLIVE_ERR_OK) {
+            select_engine_schedule_cancel(handler->engine, conn->timer);
+            __socket_close(conn_fd);
+            free(conn);
+            continue;
+        }
+        LIST_APPEND_REAR(&handler->conn_list, &conn->list_node);
+        handler->conn_num++;
+    }
+}
+
+/**
+ * @brief 将WebSocket连接从广播链表中移除，并放弃尚未补发的快照，发送关闭帧之后不能
+ *        再发送其他帧
+ *
+ * @param [in] conn 已升级为WebSocket的连接
+ */
+static void __conn_ws_leave(http_conn* conn)
+{
+    conn->event_missed = False;
+    /*已经移除的节点指向自身*/
+    if (conn->event_node.next != &conn->event_node) {
+        LIST_SUBTRACT(&conn->event_node);
+        LIST_NODE_INIT(&conn->event_node);
+        conn->handler->ws_num--;
+    }
+}
+
+/**
+ * @brief 关闭连接并释放，连接数回落到上限以下时恢复监听
+ *
+ * @param [in] conn 连接
+ */
+static void __conn_close(http_conn* conn)
+{
+    httpd_handler*  handler = conn->handler;
+
+    if (conn->timer != SELECT_TIMER_INVALID) {
+        select_engine_schedule_cancel(handler->engine, conn->timer);
+    }
+    select_engine_fd_del(handler->engine, conn->fd);
+    __socket_close(conn->fd);
+    LIST_SUBTRACT(&conn->list_node);
+    handler->conn_num--;
+    if (conn->websocket) {
+        __conn_ws_leave(conn);
+    } else if (conn->streaming) {
+        LIST_SUBTRACT(&conn->event_node);
+        handler->event_num--;
+    }
+    __conn_consume(conn, conn->pending);
+    free(conn);
+
+    if (!handler->accepting && handler->conn_num < handler->max_conn) {
+        if (select_engine_fd_watch(handler->engine, handler->httpd_socket, SELECT_EVENT_READ, __httpd_accept, handler) == BLIVE_ERR_OK) {
+            handler->accepting = True;
+        }
+    }
+}
+
+static void __conn_timeout(void* context)
+{
+    http_conn*      conn = (http_conn*)context;
+
+    /* 推送空闲时发送心跳，WebSocket使用ping帧，并在回调中重新设置定时器，句柄保持不变。
+     * 已经发送关闭帧的连接不再发送心跳 */
+    if (conn->state == HTTP_CONN_STREAMING) {
+        if (!conn->closing && __conn_can_queue(conn)) {
+            if (conn->websocket) {
+                __conn_push(conn, NULL, http_ws_ping, sizeof(http_ws_ping) - 1);
+            } else {
+                __conn_push(conn, NULL, http_event_heartbeat, sizeof(http_event_heartbeat) - 1);
+            }
+        }
+        select_engine_schedule_reschedule(conn->handler->engine, conn->timer, HTTPD_EVENT_HEARTBEAT);
+        __conn_sync(conn, __conn_flush(conn));
         return ;
     }
-    for (int count = 0; count < handler->html_cur_inject_num; count++) {
-        if (strstr(dst, handler->injection_list[count].html_label_name) != NULL) {
-            memset(dst, 0, strlen(dst));
-            handler->injection_list[count].callback(dst, handler->injection_list[count].context);
+
+    /* 定时器已经触发，关闭时不需要再取消 */
+    conn->timer = SELECT_TIMER_INVALID;
+    blive_logd("connection %d timeout in state %d", conn->fd, conn->state);
+    __conn_close(conn);
+}
+
+/**
+ * @brief 切换连接的状态，状态变化时按新状态重新计算超时。同一状态内不会延长超时，
+ *        因此每次只发送几个字节的慢速客户端也会在请求超时后断开
+ *
+ * @param [in] conn 连接
+ * @param [in] state 新的状态
+ */
+static void __conn_set_state(http_conn* conn, http_conn_state state)
+{
+    static const int64_t    timeout[] = {
+        [HTTP_CONN_IDLE]    = HTTPD_KEEPALIVE_TIMEOUT,
+        [HTTP_CONN_READING] = HTTPD_REQUEST_TIMEOUT,
+        [HTTP_CONN_WRITING] = HTTPD_WRITE_TIMEOUT,
+        [HTTP_CONN_STREAMING] = HTTPD_EVENT_HEARTBEAT,
+    };
+
+    if (conn->state == state) {
+        return ;
+    }
+    conn->state = state;
+    if (conn->timer != SELECT_TIMER_INVALID) {
+        select_engine_schedule_reschedule(conn->handler->engine, conn->timer, timeout[state]);
+    }
+}
+
+/**
+ * @brief 在请求中查找请求头的结尾，请求中可能含有'\0'，不能使用strstr
+ *
+ * @param [in] buf 接收到的数据
+ * @param [in] len 数据的长度
+ * @return int32_t 请求头(含结尾的空行)的长度，未收齐时返回-1
+ */
+static int32_t __request_header_end(const char* buf, uint32_t len)
+{
+    for (uint32_t index = 3; index < len; index++) {
+        if (buf[index] == '\n' && buf[index - 1] == '\r' && buf[index - 2] == '\n' && buf[index - 3] == '\r') {
+            return index + 1;
         }
     }
-    return ;
+    return -1;
+}
+
+/**
+ * @brief 逗号分隔的头部值中是否包含指定的选项，不区分大小写
+ *
+ * @param [in] value 头部的值
+ * @param [in] token 选项
+ * @return Bool
+ */
+static Bool __header_has_token(const char* value, const char* token)
+{
+    size_t      token_len = strlen(token);
+    const char* end = NULL;
+
+    while (*value) {
+        while (*value == ' ' || *value == '\t' || *value == ',') {
+            value++;
+        }
+        end = value;
+        while (*end && *end != ',' && *end != ' ' && *end != '\t') {
+            end++;
+        }
+        if ((size_t)(end - value) == token_len && !strncasecmp(value, token, token_len)) {
+            return True;
+        }
+        value = end;
+    }
+    return False;
 }
 
+/**
+ * @brief 解析请求行与请求头，解析时会修改缓冲区的内容
+ *
+ * @param [in] buf 完整的请求头，以'\0'结尾
+ * @param [out] request 传出参数，解析的结果
+ * @return blive_errno_t 请求格式错误时返回BLIVE_ERR_INVALID
+ */
+static blive_errno_t __request_parse(char* buf, http_request* request)
+{
+    char*       line = buf;
+    char*       next = NULL;
+    char*       value = NULL;
+    char*       version = NULL;
+    Bool        upgrade_ws = False;
+    Bool        conn_upgrade = False;
+
+    memset(request, 0, sizeof(http_request));
+
+    /*请求行：方法 路径 版本*/
+    next = strstr(line, "\r\n");
+    if (next == NULL) {
+        return BLIVE_ERR_INVALID;
+    }
+    *next = '\0';
+    request->method = line;
+    request->path = strchr(line, ' ');
+    if (request->path == NULL) {
+        blive_loge("request message invalid: %s", buf);
+        return BLIVE_ERR_INVALID;
+    }
+    *request->path++ = '\0';
+    version = strchr(request->path, ' ');
+    if (version == NULL || strncmp(version + 1, "HTTP/1.", 7)) {
+        blive_loge("request not include resource name or version");
+        return BLIVE_ERR_INVALID;
+    }
+    *version++ = '\0';
+    request->query = strchr(request->path, '?');
+    if (request->query != NULL) {
+        *request->query++ = '\0';
+    }
+    request->head_only = !strcmp(request->method, "HEAD") ? True : False;
+    /*HTTP/1.1默认保持连接，HTTP/1.0默认关闭连接*/
+    request->keep_alive = strcmp(version, "HTTP/1.0") ? True : False;
+    blive_logd("request method: %s, path: %s", request->method, request->path);
+
+    /*请求头，只关心连接的保持、请求体的长度、缓存与WebSocket的升级*/
+    for (line = next + 2; *line; line = next + 2) {
+        next = strstr(line, "\r\n");
+        if (next == NULL) {
+            return BLIVE_ERR_INVALID;
+        }
+        *next = '\0';
+        value = strchr(line, ':');
+        if (value == NULL) {
+            continue;
+        }
+        *value++ = '\0';
+        while (*value == ' ' || *value == '\t') {
+            value++;
+        }
+        for (char* end = next; end > value && (end[-1] == ' ' || end[-1] == '\t'); ) {
+            *--end = '\0';
+        }
+        if (!strcasecmp(line, "Connection")) {
+            if (__header_has_token(value, "close")) {
+                request->keep_alive = False;
+            } else if (__header_has_token(value, "keep-alive")) {
+                request->keep_alive = True;
+            }
+            conn_upgrade = __header_has_token(value, "upgrade");
+        } else if (!strcasecmp(line, "Upgrade")) {
+            upgrade_ws = __header_has_token(value, "websocket");
+        } else if (!strcasecmp(line, "Sec-WebSocket-Key")) {
+            request->ws_key = value;
+        } else if (!strcasecmp(line, "Sec-WebSocket-Version")) {
+            request->ws_version = value;
+        } else if (!strcasecmp(line, "If-None-Match")) {
+            request->if_none_match = value;
+        } else if (!strcasecmp(line, "Content-Length")) {
+            request->body_len = strtoul(value, NULL, 10);
+        } else if (!strcasecmp(line, "Transfer-Encoding")) {
+            /*不支持分块的请求体，无法确定请求的边界*/
+            return BLIVE_ERR_INVALID;
+        }
+    }
+    request->upgrade = (upgrade_ws && conn_upgrade) ? True : False;
+
+    return BLIVE_ERR_OK;
+}
+
+static http_chunk* __chunk_alloc(uint32_t len)
+{
+    http_chunk*     chunk = malloc(sizeof(http_chunk) + len);
+
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->ref = 1;
+    chunk->len = len;
+    return chunk;
+}
+
+static inline void __chunk_unref(http_chunk* chunk)
+{
+    if (chunk != NULL && --chunk->ref == 0) {
+        free(chunk);
+    }
+}
+
+/**
+ * @brief 发送队列是否还能放下一个完整的响应
+ *
+ * @param [in] conn 连接
+ * @return Bool
+ */
+static inline Bool __conn_can_queue(const http_conn* conn)
+{
+    return (conn->pending < HTTPD_WBUF_HIGH && conn->seg_num + HTTPD_SEG_PER_RESPONSE <= HTTPD_SEG_MAX) ? True : False;
+}
+
+/**
+ * @brief 将一段数据放入连接的发送队列，数据属于chunk时增加其引用计数，发送完成后释放。
+ *        调用者需要先通过__conn_can_queue确认队列中有空位
+ *
+ * @param [in] conn 连接
+ * @param [in] chunk 数据所属的块，静态字符串时为NULL
+ * @param [in] data 数据
+ * @param [in] len 数据的长度
+ */
+static void __conn_push(http_conn* conn, http_chunk* chunk, const char* data, uint32_t len)
+{
+    http_seg*   seg = NULL;
+
+    if (!len) {
+        return ;
+    }
+    seg = &conn->segs[(conn->seg_head + conn->seg_num) % HTTPD_SEG_MAX];
+    seg->chunk = chunk;
+    seg->data = data;
+    seg->len = len;
+    if (chunk != NULL) {
+        chunk->ref++;
+    }
+    conn->seg_num++;
+    conn->pending += len;
+}
+
+/**
+ * @brief 放入Connection头部与响应头结尾的空行，同一个响应对于不同的连接只有这部分不同
+ *
+ * @param [in] conn 连接
+ */
+static inline void __conn_push_connection(http_conn* conn)
+{
+    /*HTTP/1.0的客户端需要明确的keep-alive才会保持连接*/
+    if (conn->closing) {
+        __conn_push(conn, NULL, http_conn_close, sizeof(http_conn_close) - 1);
+    } else {
+        __conn_push(conn, NULL, http_conn_keep_alive, sizeof(http_conn_keep_alive) - 1);
+    }
+}
+
+/**
+ * @brief 放入一个没有响应体的响应
+ *
+ * @param [in] conn 连接
+ * @param [in] status 状态码与描述，如"304 Not Modified"
+ * @param [in] extra 额外的头部，每行以"\r\n"结尾
+ * @return blive_errno_t
+ */
+static blive_errno_t __conn_simple(http_conn* conn, const char* status, const char* extra)
+{
+    char        header[HTTPD_HEADER_SIZE] = {0};
+    int         header_len = 0;
+    http_chunk* chunk = NULL;
+
+    header_len = snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nServer: zqn httpd/0.1.0\r\n%s", status, extra);
+    chunk = __chunk_alloc(header_len);
+    if (chunk == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    memcpy(chunk->data, header, header_len);
+    __conn_push(conn, chunk, chunk->data, chunk->len);
+    __chunk_unref(chunk);
+    __conn_push_connection(conn);
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 请求出错时回复错误并在发送完成后关闭连接，不再处理之后的请求
+ *
+ * @param [in] conn 连接
+ * @param [in] status 状态码与描述
+ */
+static void __conn_error(http_conn* conn, const char* status)
+{
+    conn->closing = True;
+    conn->rlen = 0;
+    conn->discard = 0;
+    __conn_simple(conn, status, "Content-Length: 0\r\n");
+}
+
+/**
+ * @brief If-None-Match中是否有与ETag相同的值，使用弱比较
+ *
+ * @param [in] value If-None-Match的值
+ * @param [in] etag 当前的ETag，含双引号
+ * @return Bool
+ */
+static Bool __etag_match(const char* value, const char* etag)
+{
+    size_t      etag_len = strlen(etag);
+    const char* end = NULL;
+
+    while (*value) {
+        while (*value == ' ' || *value == '\t' || *value == ',') {
+            value++;
+        }
+        if (*value == '*') {
+            return True;
+        }
+        if (!strncmp(value, "W/", 2)) {
+            value += 2;
+        }
+        end = value;
+        while (*end && *end != ',' && *end != ' ' && *end != '\t') {
+            end++;
+        }
+        if ((size_t)(end - value) == etag_len && !strncmp(value, etag, etag_len)) {
+            return True;
+        }
+        value = end;
+    }
+    return False;
+}
+
+/**
+ * @brief 将响应体连同响应头一起保存到缓存中。缓存中原先的响应可能还在某些连接的发送
+ *        队列中，由引用计数在发送完成后释放
+ *
+ * @param [in] handler http服务端实体
+ * @param [in] cache 保存的位置
+ * @param [in] status 状态码与描述
+ * @param [in] content_type 响应体的类型
+ * @param [in] body 响应体
+ * @param [in] body_len 响应体的长度
+ * @param [in] versioned 内容是否有版本号，有版本号时生成ETag
+ * @param [in] version 生成内容前读取的版本号
+ * @param [in] config_version 生成内容前读取的配置版本号
+ * @return blive_errno_t
+ */
+static blive_errno_t __httpd_cache_store(httpd_handler* handler, http_cache* cache, const char* status, const char* content_type,
+                                         const char* body, uint32_t body_len, Bool versioned, uint64_t version, uint64_t config_version)
+{
+    http_chunk*     chunk = NULL;
+    char            header[HTTPD_HEADER_SIZE] = {0};
+    int             header_len = 0;
+    char            etag[HTTPD_ETAG_SIZE] = {0};
+
+    /*ETag中加入启动时间，避免重启后版本号从头计数时与浏览器缓存的ETag相同*/
+    if (versioned) {
+        snprintf(etag, sizeof(etag), "\"%" PRIx64 "-%" PRIx64 "-%" PRIx64 "\"", handler->boot_id, config_version, version);
+    }
+    header_len = snprintf(header, sizeof(header),
+                          "HTTP/1.1 %s\r\nServer: zqn httpd/0.1.0\r\nContent-Type: %s\r\nContent-Length: %u\r\nCache-Control: no-cache\r\n%s%s%s",
+                          status, content_type, body_len, etag[0] ? "ETag: " : "", etag, etag[0] ? "\r\n" : "");
+
+    chunk = __chunk_alloc(header_len + body_len);
+    if (chunk == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    memcpy(chunk->data, header, header_len);
+    memcpy(chunk->data + header_len, body, body_len);
+
+    __chunk_unref(cache->response);
+    cache->response = chunk;
+    cache->header_len = header_len;
+    memcpy(cache->etag, etag, sizeof(etag));
+    cache->version = version;
+    cache->config_version = config_version;
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 渲染页面，连同响应头一起保存到缓存中
+ *
+ * @param [in] handler http服务端实体
+ * @param [in] file 请求的页面
+ * @param [in] version 渲染前读取的页面内容版本号
+ * @param [in] config_version 渲染前读取的配置版本号
+ * @return blive_errno_t
+ */
+static blive_errno_t __httpd_render(httpd_handler* handler, http_file file, uint64_t version, uint64_t config_version)
+{
+    http_cache*     cache = &handler->cache[file];
+    http_buf*       body = &handler->body;
+    http_file       actual = file;
+    FILE*           fp = NULL;
+
+    fp = fopen(httpfile_map[file].filepath, "r");
+    if (fp == NULL) {
+        actual = HTTP_NOTFOUND;
+        fp = fopen(httpfile_map[HTTP_NOTFOUND].filepath, "r");
+    }
+
+    /*读取html文件，并在其中进行html标签的注入*/
+    body->len = 0;
+    while (fp != NULL && fgets(handler->line, sizeof(handler->line), fp) != NULL) {
+        /*如果配置了http注入，进行http注入部分的替换*/
+        do_html_inject(handler->line, handler);
+        if (__buf_append(body, handler->line, strlen(handler->line)) != BLIVE_ERR_OK) {
+            fclose(fp);
+            return BLIVE_ERR_OUTOFMEM;
+        }
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+
+    return __httpd_cache_store(handler, cache, httpfile_map[actual].status, httpfile_map[actual].content_type,
+                               body->data, body->len, handler->version_cb != NULL, version, config_version);
+}
+
+/**
+ * @brief 获取页面的缓存，页面内容或者配置的版本号变化时重新渲染。未设置版本号来源时
+ *        无法判断页面是否变化，每次都重新渲染
+ *
+ * @param [in] handler http服务端实体
+ * @param [in] file 请求的页面
+ * @return http_cache* 内存不足时返回NULL
+ */
+static http_cache* __httpd_cache_get(httpd_handler* handler, http_file file)
+{
+    http_cache*     cache = &handler->cache[file];
+    uint64_t        version = 0;
+    uint64_t        config_version = __atomic_load_n(&handler->config_version, __ATOMIC_ACQUIRE);
+
+    /*先读取版本号再渲染，渲染期间内容发生变化时，下一次请求会因为版本号不同而重新渲染*/
+    if (handler->version_cb != NULL) {
+        version = handler->version_cb(handler->version_ctx);
+        if (cache->response != NULL && cache->version == version && cache->config_version == config_version) {
+            return cache;
+        }
+    }
+    if (__httpd_render(handler, file, version, config_version) != BLIVE_ERR_OK) {
+        return NULL;
+    }
+
+    return cache;
+}
+
+/**
+ * @brief 查找请求的路径对应的接口
+ *
+ * @param [in] handler http服务端实体
+ * @param [in] path 请求的路径
+ * @return http_route* 不是接口时返回NULL
+ */
+static http_route* __httpd_route_find(httpd_handler* handler, const char* path)
+{
+    for (uint32_t route = 0; route < handler->route_num; route++) {
+        if (!strcmp(handler->routes[route].path, path)) {
+            return &handler->routes[route];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 获取接口的响应，相同的查询参数在版本号与配置不变时直接使用缓存。不同的查询
+ *        参数分别缓存，超过HTTPD_ROUTE_CACHE个时淘汰最久未使用的
+ *
+ * @param [in] handler http服务端实体
+ * @param [in] route 接口
+ * @param [in] query 查询参数，没有时为空字符串
+ * @param [out] cache 传出参数，响应所在的缓存
+ * @return blive_errno_t 查询参数过长时返回BLIVE_ERR_RESOURCE，其余为接口回调返回的错误
+ */
+static blive_errno_t __httpd_route_cache(httpd_handler* handler, http_route* route, const char* query, http_cache** cache)
+{
+    http_route_cache*   slot = NULL;
+    http_route_cache*   oldest = &route->cache[0];
+    uint64_t            version = 0;
+    uint64_t            config_version = __atomic_load_n(&handler->config_version, __ATOMIC_ACQUIRE);
+    char*               data = NULL;
+    uint32_t            len = 0;
+    blive_errno_t       retval = BLIVE_ERR_OK;
+
+    if (strlen(query) >= HTTPD_QUERY_SIZE) {
+        return BLIVE_ERR_RESOURCE;
+    }
+    /*未使用过的位置last_used为0，会被优先选中*/
+    for (int index = 0; index < HTTPD_ROUTE_CACHE; index++) {
+        if (route->cache[index].cache.response != NULL && !strcmp(route->cache[index].query, query)) {
+            slot = &route->cache[index];
+            break;
+        }
+        if (route->cache[index].last_used < oldest->last_used) {
+            oldest = &route->cache[index];
+        }
+    }
+
+    /*先读取版本号再生成，生成期间内容发生变化时，下一次请求会因为版本号不同而重新生成*/
+    if (route->version_cb != NULL) {
+        version = route->version_cb(route->context);
+    }
+    if (slot == NULL || route->version_cb == NULL || slot->cache.version != version || slot->cache.config_version != config_version) {
+        retval = route->callback(query, &data, &len, route->context);
+        if (retval != BLIVE_ERR_OK) {
+            return retval;
+        }
+        if (slot == NULL) {
+            slot = oldest;
+            __chunk_unref(slot->cache.response);
+            slot->cache.response = NULL;
+            slot->query[0] = '\0';
+        }
+        retval = __httpd_cache_store(handler, &slot->cache, "200 OK", "application/json; charset=utf-8",
+                                     data, len, route->version_cb != NULL, version, config_version);
+        free(data);
+        if (retval != BLIVE_ERR_OK) {
+            return retval;
+        }
+        strcpy(slot->query, query);
+    }
+    slot->last_used = ++route->use_count;
+    *cache = &slot->cache;
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 生成一帧推送的内容。回调生成的内容可能有多行，按照SSE的格式逐行加上"data: "
+ *        前缀，客户端收到后再以换行拼接
+ *
+ * @param [in] handler http服务端实体
+ * @return http_chunk* 内存不足时返回NULL
+ */
+static http_chunk* __httpd_event_render(httpd_handler* handler)
+{
+    http_buf*       body = &handler->body;
+    http_chunk*     chunk = NULL;
+    char*           line = handler->line;
+    char*           end = NULL;
+    char            id[32] = {0};
+    int             id_len = 0;
+
+    line[0] = '\0';
+    handler->event_cb(line, handler->event_ctx);
+
+    body->len = 0;
+    id_len = snprintf(id, sizeof(id), "id: %" PRIu64 "\n", ++handler->event_id);
+    if (__buf_append(body, id, id_len) != BLIVE_ERR_OK) {
+        return NULL;
+    }
+    do {
+        end = line + strcspn(line, "\r\n");
+        if (__buf_append(body, "data: ", 6) != BLIVE_ERR_OK ||
+            __buf_append(body, line, end - line) != BLIVE_ERR_OK ||
+            __buf_append(body, "\n", 1) != BLIVE_ERR_OK) {
+            return NULL;
+        }
+        if (*end == '\r') {
+            end++;
+        }
+        if (*end == '\n') {
+            end++;
+        }
+        line = end;
+    } while (*line);
+    if (__buf_append(body, "\n", 1) != BLIVE_ERR_OK) {
+        return NULL;
+    }
+
+    chunk = __chunk_alloc(body->len);
+    if (chunk != NULL) {
+        memcpy(chunk->data, body->data, body->len);
+    }
+    return chunk;
+}
+
+/**
+ * @brief 将最近的一帧放入订阅者的发送队列，所有订阅者共享同一个数据块。发送队列已满时
+ *        先跳过，等队列空出后补发那时最新的一帧，中间的帧不需要再发送
+ *
+ * @param [in] conn 订阅了事件推送的连接
+ */
+static void __conn_event_push(http_conn* conn)
+{
+    http_chunk*     frame = conn->handler->event_frame;
+
+    /*还没有生成过任何一帧，没有需要补发的内容*/
+    if (frame == NULL) {
+        conn->event_missed = False;
+        return ;
+    }
+    if (!__conn_can_queue(conn)) {
+        conn->event_missed = True;
+        return ;
+    }
+    conn->event_missed = False;
+    __conn_push(conn, frame, frame->data, frame->len);
+}
+
+/**
+ * @brief 合并窗口结束，生成一帧并推送给所有的订阅者
+ *
+ * @param [in] context httpd_handler
+ */
+static void __httpd_event_broadcast(void* context)
+{
+    httpd_handler*  handler = (httpd_handler*)context;
+    list*           list_ptr = NULL;
+    list*           next = NULL;
+
+    handler->event_timer = SELECT_TIMER_INVALID;
+    /*先清除标志再生成内容，生成期间的通知会触发下一次推送*/
+    __atomic_store_n(&handler->event_pending, False, __ATOMIC_RELEASE);
+    __chunk_unref(handler->event_frame);
+    handler->event_frame = NULL;
+
+    /*没有订阅者时不生成，等下一个订阅者连接时再生成*/
+    if (!handler->event_num) {
+        return ;
+    }
+    handler->event_frame = __httpd_event_render(handler);
+    if (handler->event_frame == NULL) {
+        blive_loge("out of mem!");
+        return ;
+    }
+
+    /*推送时连接可能因为发送出错而关闭，先取出下一个节点*/
+    for (list_ptr = handler->event_list.next; list_ptr != &handler->event_list; list_ptr = next) {
+        http_conn*  conn = list_entry(list_ptr, http_conn, event_node);
+
+        next = list_ptr->next;
+        __conn_event_push(conn);
+        __conn_sync(conn, __conn_flush(conn));
+    }
+}
+
+/**
+ * @brief 在引擎线程中开始合并窗口，窗口结束时推送
+ *
+ * @param [in] context httpd_handler
+ */
+static void __httpd_event_arm(void* context)
+{
+    httpd_handler*  handler = (httpd_handler*)context;
+
+    if (handler->event_timer != SELECT_TIMER_INVALID) {
+        return ;
+    }
+    if (select_engine_schedule_add(handler->engine, __httpd_event_broadcast, handler, HTTPD_EVENT_FRAME, &handler->event_timer) != BLIVE_ERR_OK) {
+        __atomic_store_n(&handler->event_pending, False, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief 订阅事件推送，回复响应头后立即发送当前的完整内容，之后连接上只有推送
+ *
+ * @param [in] conn 连接
+ * @return blive_errno_t
+ */
+static blive_errno_t __conn_subscribe(http_conn* conn)
+{
+    httpd_handler*  handler = conn->handler;
+
+    if (handler->event_frame == NULL) {
+        handler->event_frame = __httpd_event_render(handler);
+        if (handler->event_frame == NULL) {
+            return BLIVE_ERR_OUTOFMEM;
+        }
+    }
+
+    /*推送以关闭连接结束，与请求的keep-alive无关*/
+    conn->streaming = True;
+    conn->closing = False;
+    conn->discard = 0;
+    LIST_APPEND_REAR(&handler->event_list, &conn->event_node);
+    handler->event_num++;
+    __conn_push(conn, NULL, http_event_header, sizeof(http_event_header) - 1);
+    __conn_event_push(conn);
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 生成服务端发送的帧头，服务端的帧不分片、不带掩码
+ *
+ * @param [out] dst 传出参数，长度至少为HTTPD_WS_HEADER_MAX
+ * @param [in] opcode 帧的类型
+ * @param [in] len 负载的长度
+ * @return uint32_t 帧头的长度
+ */
+static uint32_t __ws_frame_header(char* dst, ws_opcode opcode, uint64_t len)
+{
+    dst[0] = (char)(0x80 | opcode);
+    if (len < 126) {
+        dst[1] = (char)len;
+        return 2;
+    }
+    if (len <= 0xFFFF) {
+        dst[1] = 126;
+        dst[2] = (char)(len >> 8);
+        dst[3] = (char)len;
+        return 4;
+    }
+    dst[1] = 127;
+    for (int index = 0; index < 8; index++) {
+        dst[2 + index] = (char)(len >> (56 - index * 8));
+    }
+    return 10;
+}
+
+/**
+ * @brief 生成一个完整的帧
+ *
+ * @param [in] opcode 帧的类型
+ * @param [in] data 负载
+ * @param [in] len 负载的长度
+ * @return http_chunk* 内存不足时返回NULL
+ */
+static http_chunk* __ws_frame(ws_opcode opcode, const char* data, uint32_t len)
+{
+    char            header[HTTPD_WS_HEADER_MAX] = {0};
+    uint32_t        header_len = __ws_frame_header(header, opcode, len);
+    http_chunk*     chunk = __chunk_alloc(header_len + len);
+
+    if (chunk == NULL) {
+        return NULL;
+    }
+    memcpy(chunk->data, header, header_len);
+    memcpy(chunk->data + header_len, data, len);
+    return chunk;
+}
+
+/**
+ * @brief 向单个连接发送一帧，只用于控制帧与快照
+ *
+ * @param [in] conn 已升级为WebSocket的连接
+ * @param [in] opcode 帧的类型
+ * @param [in] data 负载
+ * @param [in] len 负载的长度
+ * @return blive_errno_t
+ */
+static blive_errno_t __conn_ws_send(http_conn* conn, ws_opcode opcode, const char* data, uint32_t len)
+{
+    http_chunk*     chunk = __ws_frame(opcode, data, len);
+
+    if (chunk == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    __conn_push(conn, chunk, chunk->data, chunk->len);
+    __chunk_unref(chunk);
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 发送关闭帧，发送完成后关闭连接，之后收到的帧都被丢弃
+ *
+ * @param [in] conn 已升级为WebSocket的连接
+ * @param [in] code 关闭的原因
+ * @return blive_errno_t
+ */
+static blive_errno_t __conn_ws_close(http_conn* conn, ws_close_code code)
+{
+    char        payload[2] = {(char)(code >> 8), (char)code};
+
+    conn->closing = True;
+    conn->rlen = 0;
+    conn->discard = 0;
+    __conn_ws_leave(conn);
+    return __conn_ws_send(conn, WS_OP_CLOSE, payload, sizeof(payload));
+}
+
+/**
+ * @brief 发送一次完整的快照，之前的状态由客户端丢弃。发送队列已满时先跳过，等队列
+ *        空出后再发送那时的快照
+ *
+ * @param [in] conn 已升级为WebSocket的连接
+ * @return blive_errno_t
+ */
+static blive_errno_t __conn_ws_snapshot(http_conn* conn)
+{
+    httpd_handler*  handler = conn->handler;
+    char*           data = NULL;
+    uint32_t        len = 0;
+    blive_errno_t   retval = BLIVE_ERR_OK;
+
+    if (!__conn_can_queue(conn)) {
+        conn->event_missed = True;
+        return BLIVE_ERR_OK;
+    }
+    retval = handler->ws_cb(&data, &len, handler->ws_ctx);
+    if (retval != BLIVE_ERR_OK) {
+        return retval;
+    }
+    retval = __conn_ws_send(conn, WS_OP_TEXT, data, len);
+    free(data);
+    if (retval == BLIVE_ERR_OK) {
+        conn->event_missed = False;
+    }
+    return retval;
+}
+
+/**
+ * @brief 将一批广播消息放入连接的发送队列，所有连接共享同一个数据块。消息之间有先后
+ *        关系，不能像事件推送那样只发最新的一帧，跳过了消息的连接需要重新发送快照
+ *
+ * @param [in] conn 已升级为WebSocket的连接
+ * @param [in] batch 这一批消息，生成失败时为NULL
+ * @return blive_errno_t
+ */
+static blive_errno_t __conn_ws_push(http_conn* conn, http_chunk* batch)
+{
+    if (conn->event_missed || batch == NULL) {
+        return __conn_ws_snapshot(conn);
+    }
+    if (!__conn_can_queue(conn)) {
+        conn->event_missed = True;
+        return BLIVE_ERR_OK;
+    }
+    __conn_push(conn, batch, batch->data, batch->len);
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 在引擎线程中取出所有等待广播的消息，拼接为一个数据块后发给所有的连接
+ *
+ * @param [in] context httpd_handler
+ */
+static void __httpd_ws_broadcast(void* context)
+{
+    httpd_handler*  handler = (httpd_handler*)context;
+    http_buf*       body = &handler->body;
+    http_chunk*     batch = NULL;
+    mpsc_node_t*    node = NULL;
+    http_ws_msg*    msg = NULL;
+    Bool            lost = False;
+    list*           list_ptr = NULL;
+    list*           next = NULL;
+
+    /*先清除标志再取出消息，取出期间入队的消息会触发下一次广播*/
+    __atomic_store_n(&handler->ws_pending, False, __ATOMIC_RELEASE);
+    body->len = 0;
+    while ((node = mpsc_queue_pop(&handler->ws_queue)) != NULL) {
+        msg = list_entry(node, http_ws_msg, node);
+        if (handler->ws_num && __buf_append(body, msg->data, msg->len) != BLIVE_ERR_OK) {
+            lost = True;
+        }
+        free(msg);
+    }
+    if (!handler->ws_num || (!body->len && !lost)) {
+        return ;
+    }
+    if (!lost) {
+        batch = __chunk_alloc(body->len);
+        if (batch != NULL) {
+            memcpy(batch->data, body->data, body->len);
+        }
+    }
+    if (batch == NULL) {
+        blive_loge("out of mem, resend snapshot to all websocket connections");
+    }
+
+    /*发送时连接可能因为出错而关闭，先取出下一个节点*/
+    for (list_ptr = handler->ws_list.next; list_ptr != &handler->ws_list; list_ptr = next) {
+        http_conn*  conn = list_entry(list_ptr, http_conn, event_node);
+
+        next = list_ptr->next;
+        if (__conn_ws_push(conn, batch) != BLIVE_ERR_OK) {
+            __conn_close(conn);
+            continue;
+        }
+        __conn_sync(conn, __conn_flush(conn));
+    }
+    __chunk_unref(batch);
+}
+
+/**
+ * @brief 回复WebSocket的握手并发送第一次快照，之后连接上不再有http请求
+ *
+ * @param [in] conn 连接
+ * @param [in] request 升级的请求
+ * @return blive_errno_t
+ */
+static blive_errno_t __conn_ws_upgrade(http_conn* conn, const http_request* request)
+{
+    httpd_handler*  handler = conn->handler;
+    sha1_ctx_t      sha1;
+    uint8_t         digest[SHA1_DIGEST_SIZE] = {0};
+    char            accept[BASE64_ENCODED_SIZE(SHA1_DIGEST_SIZE)] = {0};
+    char            header[HTTPD_HEADER_SIZE] = {0};
+    int             header_len = 0;
+    http_chunk*     chunk = NULL;
+
+    if (strcmp(request->method, "GET") || !request->upgrade || request->ws_key == NULL) {
+        return __conn_simple(conn, "400 Bad Request", "Content-Length: 0\r\n");
+    }
+    if (request->ws_version == NULL || strcmp(request->ws_version, "13")) {
+        return __conn_simple(conn, "426 Upgrade Required", "Sec-WebSocket-Version: 13\r\nContent-Length: 0\r\n");
+    }
+
+    /*Sec-WebSocket-Accept为Sec-WebSocket-Key拼接GUID后SHA-1摘要的base64编码*/
+    sha1_init(&sha1);
+    sha1_update(&sha1, request->ws_key, strlen(request->ws_key));
+    sha1_update(&sha1, HTTPD_WS_GUID, sizeof(HTTPD_WS_GUID) - 1);
+    sha1_final(&sha1, digest);
+    base64_encode(digest, sizeof(digest), accept);
+    header_len = snprintf(header, sizeof(header), "HTTP/1.1 101 Switching Protocols\r\nServer: zqn httpd/0.1.0\r\n"
+                          "Upgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept);
+    chunk = __chunk_alloc(header_len);
+    if (chunk == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    memcpy(chunk->data, header, header_len);
+    __conn_push(conn, chunk, chunk->data, chunk->len);
+    __chunk_unref(chunk);
+
+    /*升级之后读到的都是帧，请求声明的请求体不再丢弃*/
+    conn->streaming = True;
+    conn->websocket = True;
+    conn->closing = False;
+    conn->discard = 0;
+    LIST_APPEND_REAR(&handler->ws_list, &conn->event_node);
+    handler->ws_num++;
+
+    return __conn_ws_snapshot(conn);
+}
+
+/**
+ * @brief 处理客户端发送的控制帧，负载已经收齐
+ *
+ * @param [in] conn 已升级为WebSocket的连接
+ * @param [in] opcode 帧的类型
+ * @param [in] payload 去掉掩码后的负载
+ * @param [in] len 负载的长度
+ * @return blive_errno_t
+ */
+static blive_errno_t __conn_ws_control(http_conn* conn, ws_opcode opcode, const char* payload, uint32_t len)
+{
+    switch (opcode) {
+    case WS_OP_PING:
+        return __conn_ws_send(conn, WS_OP_PONG, payload, len);
+    case WS_OP_CLOSE:
+        /*回复同样的关闭原因，发送完成后关闭连接，之后的数据不再处理*/
+        conn->closing = True;
+        conn->rlen = 0;
+        conn->discard = 0;
+        __conn_ws_leave(conn);
+        return __conn_ws_send(conn, WS_OP_CLOSE, payload, min(len, 2));
+    case WS_OP_PONG:
+        return BLIVE_ERR_OK;
+    default:
+        return __conn_ws_close(conn, WS_CLOSE_PROTOCOL);
+    }
+}
+
+/**
+ * @brief 处理读缓冲区中客户端发送的帧。服务端只广播，客户端的数据帧直接丢弃，只回应
+ *        ping与close，发送队列已满时暂停处理
+ *
+ * @param [in] conn 已升级为WebSocket的连接
+ * @return blive_errno_t 内存不足时返回错误
+ */
+static blive_errno_t __conn_ws_process(http_conn* conn)
+{
+    uint8_t*        frame = (uint8_t*)conn->rbuf;
+    ws_opcode       opcode = WS_OP_CONTINUATION;
+    uint64_t        payload_len = 0;
+    uint32_t        header_len = 0;
+    uint32_t        consumed = 0;
+    blive_errno_t   retval = BLIVE_ERR_OK;
+
+    while (conn->rlen && !conn->closing && __conn_can_queue(conn)) {
+        /*跳过数据帧的负载*/
+        if (conn->discard) {
+            consumed = min(conn->discard, conn->rlen);
+            conn->discard -= consumed;
+        } else {
+            /*帧头：FIN、RSV、opcode，MASK与长度，扩展长度，4字节的掩码*/
+            if (conn->rlen < 2) {
+                break;
+            }
+            /*客户端的帧必须带掩码，没有协商扩展时RSV必须为0*/
+            if (!(frame[1] & 0x80) || (frame[0] & 0x70)) {
+                return __conn_ws_close(conn, WS_CLOSE_PROTOCOL);
+            }
+            opcode = (ws_opcode)(frame[0] & 0x0F);
+            payload_len = frame[1] & 0x7F;
+            header_len = 2 + (payload_len == 126 ? 2 : 0) + (payload_len == 127 ? 8 : 0) + 4;
+            if (conn->rlen < header_len) {
+                break;
+            }
+            if (payload_len >= 126) {
+                payload_len = 0;
+                for (uint32_t index = 2; index < header_len - 4; index++) {
+                    payload_len = (payload_len << 8) | frame[index];
+                }
+            }
+
+            if (opcode & 0x08) {
+                /*控制帧不能分片，负载不超过125字节，一定能放入读缓冲区*/
+                if (!(frame[0] & 0x80) || payload_len > 125) {
+                    return __conn_ws_close(conn, WS_CLOSE_PROTOCOL);
+                }
+                if (conn->rlen < header_len + payload_len) {
+                    break;
+                }
+                for (uint32_t index = 0; index < payload_len; index++) {
+                    frame[header_len + index] ^= frame[header_len - 4 + (index & 3)];
+                }
+                retval = __conn_ws_control(conn, opcode, (char*)frame + header_len, (uint32_t)payload_len);
+                if (retval != BLIVE_ERR_OK || conn->closing) {
+                    return retval;
+                }
+                consumed = header_len + payload_len;
+            } else if (opcode <= WS_OP_BINARY) {
+                if (payload_len > UINT32_MAX) {
+                    return __conn_ws_close(conn, WS_CLOSE_TOO_BIG);
+                }
+                consumed = header_len;
+                conn->discard = (uint32_t)payload_len;
+            } else {
+                return __conn_ws_close(conn, WS_CLOSE_PROTOCOL);
+            }
+        }
+
+        conn->rlen -= consumed;
+        memmove(conn->rbuf, conn->rbuf + consumed, conn->rlen);
+    }
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 将请求的页面或者接口的响应放入发送队列。缓存的响应按引用放入，不会复制，只有Connection
+ *        头部按连接单独放入，一次writev发出
+ *
+ * @param [in] conn 连接
+ * @param [in] request 请求
+ * @return blive_errno_t
+ */
+static blive_errno_t __conn_render(http_conn* conn, const http_request* request)
+{
+    http_cache*     cache = NULL;
+    http_chunk*     response = NULL;
+    http_route*     route = NULL;
+    char            extra[HTTPD_ETAG_SIZE + 16] = {0};
+    blive_errno_t   retval = BLIVE_ERR_OK;
+
+    if (conn->handler->event_cb != NULL && !strcmp(request->path, HTTPD_EVENT_PATH)) {
+        return __conn_subscribe(conn);
+    }
+    if (conn->handler->ws_cb != NULL && !strcmp(request->path, HTTPD_WS_PATH)) {
+        return __conn_ws_upgrade(conn, request);
+    }
+
+    route = __httpd_route_find(conn->handler, request->path);
+    if (route != NULL) {
+        retval = __httpd_route_cache(conn->handler, route, request->query != NULL ? request->query : "", &cache);
+        if (retval == BLIVE_ERR_INVALID) {
+            return __conn_simple(conn, "400 Bad Request", "Content-Length: 0\r\n");
+        } else if (retval == BLIVE_ERR_RESOURCE) {
+            return __conn_simple(conn, "414 URI Too Long", "Content-Length: 0\r\n");
+        } else if (retval != BLIVE_ERR_OK) {
+            return retval;
+        }
+    } else {
+        cache = __httpd_cache_get(conn->handler, get_filename(request->path));
+        if (cache == NULL) {
+            return BLIVE_ERR_OUTOFMEM;
+        }
+    }
+
+    /*页面没有变化，客户端使用自己缓存的页面*/
+    if (cache->etag[0] && request->if_none_match != NULL && __etag_match(request->if_none_match, cache->etag)) {
+        snprintf(extra, sizeof(extra), "ETag: %s\r\n", cache->etag);
+        return __conn_simple(conn, "304 Not Modified", extra);
+    }
+
+    response = cache->response;
+    __conn_push(conn, response, response->data, cache->header_len);
+    __conn_push_connection(conn);
+    /*HEAD请求的响应头与GET相同，但不发送响应体*/
+    if (!request->head_only) {
+        __conn_push(conn, response, response->data + cache->header_len, response->len - cache->header_len);
+    }
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 处理读缓冲区中所有已经收齐的请求。待发送的响应过多时暂停，等发送之后再继续，
+ *        避免只发请求不收响应的客户端占用过多内存
+ *
+ * @param [in] conn 连接
+ * @return blive_errno_t 内存不足时返回错误
+ */
+static blive_errno_t __conn_process(http_conn* conn)
+{
+    http_request    request;
+    int32_t         header_len = 0;
+    uint32_t        consumed = 0;
+
+    while (!conn->closing && !conn->streaming && __conn_can_queue(conn)) {
+        /*跳过上一个请求的请求体*/
+        if (conn->discard) {
+            consumed = min(conn->discard, conn->rlen);
+            conn->discard -= consumed;
+        } else {
+            header_len = __request_header_end(conn->rbuf, conn->rlen);
+            if (header_len < 0) {
+                /*保留一个字节作为字符串结尾，缓冲区满时仍未收齐说明请求头过大*/
+                if (conn->rlen == sizeof(conn->rbuf) - 1) {
+                    blive_loge("request header too large");
+                    __conn_error(conn, "431 Request Header Fields Too Large");
+                }
+                break;
+            }
+            consumed = header_len;
+
+            /*解析时会在请求头中写入'\0'，解析完成后这部分数据就会被丢弃*/
+            conn->rbuf[header_len - 2] = '\0';
+            blive_logd("%s", conn->rbuf);
+            if (__request_parse(conn->rbuf, &request) != BLIVE_ERR_OK) {
+                __conn_error(conn, "400 Bad Request");
+                break;
+            }
+            conn->discard = request.body_len;
+            conn->closing = !request.keep_alive;
+            if (__conn_render(conn, &request) != BLIVE_ERR_OK) {
+                return BLIVE_ERR_OUTOFMEM;
+            }
+        }
+
+        conn->rlen -= consumed;
+        memmove(conn->rbuf, conn->rbuf + consumed, conn->rlen);
+        if (!conn->rlen) {
+            break;
+        }
+    }
+
+    /*升级之后读缓冲区中剩下的是WebSocket的帧*/
+    if (conn->websocket) {
+        return __conn_ws_process(conn);
+    }
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 从发送队列的头部移除已经发送的数据，整段发送完成时释放对数据块的引用
+ *
+ * @param [in] conn 连接
+ * @param [in] sent 已发送的长度
+ */
+static void __conn_consume(http_conn* conn, uint32_t sent)
+{
+    http_seg*   seg = NULL;
+
+    conn->pending -= sent;
+    while (sent) {
+        seg = &conn->segs[conn->seg_head];
+        if (sent < seg->len) {
+            seg->data += sent;
+            seg->len -= sent;
+            return ;
+        }
+        sent -= seg->len;
+        __chunk_unref(seg->chunk);
+        conn->seg_head = (conn->seg_head + 1) % HTTPD_SEG_MAX;
+        conn->seg_num--;
+    }
+}
+
+/**
+ * @brief 尽量发送发送队列中的数据，队列中的多段数据一次系统调用发出
+ *
+ * @param [in] conn 连接
+ * @return blive_errno_t 全部发送完成时返回BLIVE_ERR_OK，还需等待可写时返回BLIVE_ERR_RESOURCE
+ */
+static blive_errno_t __conn_flush(http_conn* conn)
+{
+    http_seg*       seg = NULL;
+    ssize_t         sent = 0;
+#ifndef WIN32
+    struct iovec    iov[HTTPD_SEG_MAX];
+    struct msghdr   msg;
+    uint32_t        iov_num = 0;
+#endif
+
+    while (conn->seg_num) {
+#ifdef WIN32
+        seg = &conn->segs[conn->seg_head];
+        sent = fd_write(conn->fd, seg->data, seg->len);
+#else
+        for (iov_num = 0; iov_num < conn->seg_num; iov_num++) {
+            seg = &conn->segs[(conn->seg_head + iov_num) % HTTPD_SEG_MAX];
+            iov[iov_num].iov_base = (void*)seg->data;
+            iov[iov_num].iov_len = seg->len;
+        }
+        /*相当于writev，但可以带上MSG_NOSIGNAL，对端关闭时不会产生SIGPIPE*/
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_num;
+        sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+#endif
+        if (sent < 0) {
+            if (!__socket_would_block()) {
+                return BLIVE_ERR_TERMINATE;
+            }
+            return BLIVE_ERR_RESOURCE;
+        }
+        __conn_consume(conn, (uint32_t)sent);
+        /* 等待可写期间有进展时重新计算超时，只有对端长时间不接收时才断开 */
+        if (conn->state == HTTP_CONN_WRITING && conn->timer != SELECT_TIMER_INVALID) {
+            select_engine_schedule_reschedule(conn->handler->engine, conn->timer, HTTPD_WRITE_TIMEOUT);
+        }
+    }
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 接收数据放入读缓冲区，直到缓冲区满或者暂时没有数据
+ *
+ * @param [in] conn 连接
+ * @return blive_errno_t 出错时返回BLIVE_ERR_TERMINATE，对端关闭写入时返回BLIVE_ERR_NOTEXSIT
+ */
+static blive_errno_t __conn_recv(http_conn* conn)
+{
+    int         res = 0;
+
+    while (conn->rlen < sizeof(conn->rbuf) - 1) {
+        res = fd_read(conn->fd, conn->rbuf + conn->rlen, sizeof(conn->rbuf) - 1 - conn->rlen);
+        if (res == 0) {
+            blive_logd("remote closed");
+            return BLIVE_ERR_NOTEXSIT;
+        }
+        if (res < 0) {
+            if (__socket_would_block()) {
+                break;
+            }
+            blive_loge("read %d(%s)!", res, strerror(errno));
+            return BLIVE_ERR_TERMINATE;
+        }
+        conn->rlen += res;
+    }
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 发送之后根据连接的状态关闭连接，或者更新监视的事件与超时
+ *
+ * @param [in] conn 连接
+ * @param [in] retval 发送的结果
+ */
+static void __conn_sync(http_conn* conn, blive_errno_t retval)
+{
+    uint32_t        interest = 0;
+
+    if (retval == BLIVE_ERR_TERMINATE) {
+        __conn_close(conn);
+        return ;
+    }
+    /*响应已全部发送，之后不会再有请求*/
+    if (retval == BLIVE_ERR_OK && (conn->closing || conn->half_closed)) {
+        __conn_close(conn);
+        return ;
+    }
+
+    /*有待发送的响应时监视可写，响应积压过多或者对端已不再发送时停止读取*/
+    if (conn->seg_num) {
+        interest |= SELECT_EVENT_WRITE;
+        __conn_set_state(conn, HTTP_CONN_WRITING);
+    } else if (conn->streaming) {
+        __conn_set_state(conn, HTTP_CONN_STREAMING);
+    } else {
+        __conn_set_state(conn, conn->rlen ? HTTP_CONN_READING : HTTP_CONN_IDLE);
+    }
+    if (!conn->closing && !conn->half_closed && __conn_can_queue(conn)) {
+        interest |= SELECT_EVENT_READ;
+    }
+    select_engine_fd_modify(conn->handler->engine, conn->fd, interest);
+}
+
+static void __conn_io(fd_t fd, uint32_t events, void* context)
+{
+    http_conn*      conn = (http_conn*)context;
+    blive_errno_t   retval = BLIVE_ERR_OK;
+
+    if (events & SELECT_EVENT_ERROR) {
+        __conn_close(conn);
+        return ;
+    }
+
+    if (events & SELECT_EVENT_READ) {
+        retval = __conn_recv(conn);
+        if (retval == BLIVE_ERR_TERMINATE) {
+            __conn_close(conn);
+            return ;
+        }
+        /*订阅了推送的连接不再处理请求，收到的数据直接丢弃*/
+        if (conn->streaming && !conn->websocket) {
+            conn->rlen = 0;
+        }
+        /*对端不再发送请求，处理完已收到的请求后关闭*/
+        if (retval == BLIVE_ERR_NOTEXSIT) {
+            if (__request_header_end(conn->rbuf, conn->rlen) < 0 && !conn->seg_num) {
+                __conn_close(conn);
+                return ;
+            }
+            conn->half_closed = True;
+        }
+    }
+
+    /*处理请求与发送响应交替进行，直到没有完整的请求与需要补发的推送，或者发送缓冲区已满*/
+    do {
+        if (__conn_process(conn) != BLIVE_ERR_OK) {
+            __conn_close(conn);
+            return ;
+        }
+        if (conn->event_missed && conn->websocket) {
+            if (__conn_ws_snapshot(conn) != BLIVE_ERR_OK) {
+                __conn_close(conn);
+                return ;
+            }
+        } else if (conn->event_missed) {
+            __conn_event_push(conn);
+        }
+        retval = __conn_flush(conn);
+        if (retval == BLIVE_ERR_TERMINATE) {
+            __conn_close(conn);
+            return ;
+        }
+    } while (retval == BLIVE_ERR_OK && !conn->closing &&
+             (conn->event_missed || (!conn->streaming && __request_header_end(conn->rbuf, conn->rlen) >= 0)));
+
+    __conn_sync(conn, retval);
+}
+
+static http_file get_filename(const char* path)
+{
+    http_file   file = HTTP_HOME;
+
+    while (file < HTTP_NOTFOUND) {
+        if (!strcmp(httpfile_map[file].request_path, path)) {
+            blive_logd("request resource %s found", path);
+            return file;
+        }
+        file++;
+    }
+
+    blive_loge("request resource not found [%s]", path);
+    return HTTP_NOTFOUND;
+}
+
+static inline void do_html_inject(char* dst, httpd_handler* handler)
+{
+    if (!handler->html_cur_inject_num) {
+        return ;
+    }
+    for (int count = 0; count < handler->html_cur_inject_num; count++) {
+        if (strstr(dst, handler->injection_list[count].html_label_name) != NULL) {
+            memset(dst, 0, strlen(dst));
+            handler->injection_list[count].callback(dst, handler->injection_list[count].context);
+        }
+    }
+    return ;
+}
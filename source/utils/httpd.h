@@ -1,7 +1,8 @@
 /**
  * @file httpd.h
  * @author zhongqiaoning (691365572@qq.com)
- * @brief 简易的http服务端，使用html注入来允许修改html页面内容
+ * @brief 简易的http服务端，使用html注入来允许修改html页面内容。服务端运行在事件引擎
+ *        中，每个连接是一个非阻塞的状态机，慢速或空闲的客户端不会阻塞其他客户端
  * @version 0.1
  * @date 2023-03-05
  * 
@@ -12,6 +13,10 @@
 #define __HTTPD_H__
 
 #include "utils.h"
+#include "select.h"
+
+
+#define HTTPD_MAX_CONN      1024    /* 默认同时保持的连接数上限 */
 
 
 typedef struct httpd_handler httpd_handler;
@@ -22,17 +27,19 @@ extern "C" {
 #endif
 
 /**
- * @brief 在指定的IP、端口创建http服务端处理
+ * @brief 在指定的IP、端口创建http服务端处理，此时尚未开始接受连接
  * 
  * @param [out] handler http服务端实体
+ * @param [in] engine 处理所有连接的事件引擎
  * @param [in] ip 使用的IP
  * @param [in] port 使用的端口
  * @return blive_errno_t 
  */
-blive_errno_t http_create(httpd_handler** handler, const char* ip, uint16_t port);
+blive_errno_t http_create(httpd_handler** handler, select_engine_t* engine, const char* ip, uint16_t port);
 
 /**
- * @brief 删除一个http服务端实体
+ * @brief 删除一个http服务端实体，关闭所有的连接
+ * @note 只能在事件引擎的线程中调用，或者在事件引擎停止之后调用
  * 
  * @param [in] handler http服务端实体
  * @return blive_errno_t 
@@ -40,13 +47,24 @@ blive_errno_t http_create(httpd_handler** handler, const char* ip, uint16_t port
 blive_errno_t http_destroy(httpd_handler* handler);
 
 /**
- * @brief 运行http服务端
+ * @brief 运行http服务端，将监听socket放入事件引擎，立即返回。之后的连接都在引擎的
+ *        线程中处理，html注入需要在此之前设置
  * 
  * @param [in] handler http服务端实体 
  * @return blive_errno_t 
  */
 blive_errno_t http_perform(httpd_handler* handler);
 
+/**
+ * @brief 设置同时保持的连接数上限，达到上限后暂停接受新连接，直到已有的连接关闭。
+ *        需要在http_perform之前调用
+ * 
+ * @param [in] handler http服务端实体
+ * @param [in] max_conn 连接数上限，默认为HTTPD_MAX_CONN
+ * @return blive_errno_t 
+ */
+blive_errno_t http_set_max_conn(httpd_handler* handler, uint32_t max_conn);
+
 /**
  * @brief 在html页面文件中出现关键字的时候注入指定内容
  * 
@@ -58,6 +76,105 @@ blive_errno_t http_perform(httpd_handler* handler);
  */
 blive_errno_t http_html_injection(httpd_handler* handler, const char* inject_word, void (*callback)(char*, void*), void* context);
 
+/**
+ * @brief 设置页面内容的版本号来源。渲染好的页面连同响应头一起缓存，只有版本号或者
+ *        注入的配置变化时才重新渲染，并以版本号生成ETag，客户端携带相同的
+ *        If-None-Match时回复304。未设置时每次请求都重新渲染，也不生成ETag
+ * @note 回调在事件引擎的线程中调用，需要在http_perform之前设置
+ * 
+ * @param [in] handler http服务端实体
+ * @param [in] callback 返回当前版本号的回调函数，页面内容每次变化后版本号都需要不同
+ * @param [in] context 回调函数的参数
+ * @return blive_errno_t 
+ */
+blive_errno_t http_html_version(httpd_handler* handler, uint64_t (*callback)(void*), void* context);
+
+/**
+ * @brief 设置事件推送(Server-Sent Events)的内容。客户端访问/events时保持连接，先收到
+ *        一次完整的内容，之后每次通知都会收到一次新的内容，多行内容由客户端以换行拼接
+ * @note 回调在事件引擎的线程中调用，需要在http_perform之前设置
+ * 
+ * @param [in] handler http服务端实体
+ * @param [in] callback 生成推送内容的回调函数，参数与html注入的回调相同
+ * @param [in] context 回调函数的参数
+ * @return blive_errno_t 
+ */
+blive_errno_t http_event_source(httpd_handler* handler, void (*callback)(char*, void*), void* context);
+
+/**
+ * @brief 通知推送的内容已经变化，任意线程均可调用。50ms内的多次通知合并为一次推送，
+ *        内容只生成一次，由所有的订阅者共享
+ * 
+ * @param [in] handler http服务端实体
+ * @return blive_errno_t 
+ */
+blive_errno_t http_event_notify(httpd_handler* handler);
+
+/**
+ * @brief 设置WebSocket(RFC 6455)的快照来源。客户端连接/ws后先收到一条快照消息，之后按顺序
+ *        收到每一条广播的消息。连接的发送队列积压时会跳过期间的消息，队列空出后重新发送
+ *        一次快照，客户端收到快照时需要丢弃之前的状态
+ * @note 回调在事件引擎的线程中调用，需要在http_perform之前设置
+ * 
+ * @param [in] handler http服务端实体
+ * @param [in] callback 生成快照的回调，传出malloc申请的文本消息与长度，由httpd释放
+ * @param [in] context 回调函数的参数
+ * @return blive_errno_t 
+ */
+blive_errno_t http_ws_source(httpd_handler* handler, blive_errno_t (*callback)(char** data, uint32_t* len, void* context), void* context);
+
+/**
+ * @brief 向所有的WebSocket连接广播一条文本消息，任意线程均可调用。消息在调用者的线程中
+ *        加上帧头，引擎线程一次取出的多条消息拼接为一个数据块，由所有连接共享
+ * @note 多个线程同时广播时，消息的顺序由调用者保证，如在修改数据时持有的锁中调用
+ * 
+ * @param [in] handler http服务端实体
+ * @param [in] data 消息，会被复制
+ * @param [in] len 消息的长度
+ * @return blive_errno_t 
+ */
+blive_errno_t http_ws_broadcast(httpd_handler* handler, const char* data, uint32_t len);
+
+/**
+ * @brief 注册一个返回数据的接口，请求的路径与path相同时由回调生成响应体，类型为json。
+ *        响应按查询参数分别缓存，版本号与注入的配置都没有变化时直接使用缓存，并以版本号
+ *        生成ETag，客户端携带相同的If-None-Match时回复304。未设置版本号来源时每次请求都
+ *        重新生成，也不生成ETag
+ * @note 回调在事件引擎的线程中调用，需要在http_perform之前设置。回调返回BLIVE_ERR_INVALID
+ *       时回复400
+ * 
+ * @param [in] handler http服务端实体
+ * @param [in] path 接口的路径，如"/api/queue"
+ * @param [in] callback 生成响应的回调，query为'?'之后的查询参数，没有时为空字符串，传出
+ *             malloc申请的响应体与长度，由httpd释放
+ * @param [in] version 返回当前版本号的回调，可以为NULL
+ * @param [in] context 回调函数的参数
+ * @return blive_errno_t 
+ */
+blive_errno_t http_api_route(httpd_handler* handler, const char* path,
+                             blive_errno_t (*callback)(const char* query, char** data, uint32_t* len, void* context),
+                             uint64_t (*version)(void* context), void* context);
+
+/**
+ * @brief 从查询参数中取出一个参数的值，并解码'+'与%XX
+ * 
+ * @param [in] query 查询参数，如"offset=0&limit=10"
+ * @param [in] key 参数名
+ * @param [out] value 传出参数，解码后的值，以'\0'结尾
+ * @param [in] size value的长度
+ * @return blive_errno_t 没有该参数时返回BLIVE_ERR_NOTEXSIT，value放不下时返回BLIVE_ERR_RESOURCE
+ */
+blive_errno_t http_query_param(const char* query, const char* key, char* value, uint32_t size);
+
+/**
+ * @brief 使缓存的页面与接口的响应失效，下一次请求时重新生成，如页面文件或者注入使用的配置被修改后。
+ *        任意线程均可调用
+ * 
+ * @param [in] handler http服务端实体
+ * @return blive_errno_t 
+ */
+blive_errno_t http_cache_invalidate(httpd_handler* handler);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,265 @@
+/**
+ * @file json_writer.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 流式的json生成器，每一层是否需要逗号、是数组还是对象各用一个位记录
+ * @version 0.1
+ * @date 2023-03-25
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <stdio.h>
+#include <inttypes.h>
+#include "json_writer.h"
+
+
+#define JSON_WRITER_MIN_SIZE    256
+#define JSON_LEVEL_BIT(depth)   (1ULL << ((depth) - 1))
+
+
+static Bool __writer_reserve(json_writer* writer, uint32_t size)
+{
+    char*       data = NULL;
+    uint32_t    cap = writer->cap ? writer->cap : JSON_WRITER_MIN_SIZE;
+
+    if (writer->err != BLIVE_ERR_OK) {
+        return False;
+    }
+    /*多保留一个字节作为结尾的'\0'*/
+    if (writer->len + size < writer->cap) {
+        return True;
+    }
+    while (cap <= writer->len + size) {
+        if (cap > UINT32_MAX / 2) {
+            writer->err = BLIVE_ERR_OUTOFMEM;
+            return False;
+        }
+        cap *= 2;
+    }
+    data = realloc(writer->data, cap);
+    if (data == NULL) {
+        writer->err = BLIVE_ERR_OUTOFMEM;
+        return False;
+    }
+    writer->data = data;
+    writer->cap = cap;
+
+    return True;
+}
+
+static inline void __writer_append(json_writer* writer, const char* data, uint32_t size)
+{
+    if (!__writer_reserve(writer, size)) {
+        return ;
+    }
+    memcpy(writer->data + writer->len, data, size);
+    writer->len += size;
+    writer->data[writer->len] = '\0';
+}
+
+/**
+ * @brief 写入带引号的字符串，只转义json要求转义的字符
+ *
+ * @param [in] writer 生成器
+ * @param [in] value 字符串
+ */
+static void __writer_quote(json_writer* writer, const char* value)
+{
+    static const char   hex[] = "0123456789abcdef";
+    const char*         plain = value;
+    char                escape[8] = {0};
+    uint32_t            escape_len = 0;
+
+    __writer_append(writer, "\"", 1);
+    for (; *value; value++) {
+        unsigned char   ch = (unsigned char)*value;
+
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            continue;
+        }
+        /*连续的普通字符一次写入*/
+        __writer_append(writer, plain, value - plain);
+        plain = value + 1;
+        escape[0] = '\\';
+        escape_len = 2;
+        switch (ch) {
+        case '"':   escape[1] = '"';    break;
+        case '\\':  escape[1] = '\\';   break;
+        case '\n':  escape[1] = 'n';    break;
+        case '\r':  escape[1] = 'r';    break;
+        case '\t':  escape[1] = 't';    break;
+        default:
+            memcpy(escape + 1, "u00", 3);
+            escape[4] = hex[ch >> 4];
+            escape[5] = hex[ch & 0xF];
+            escape_len = 6;
+            break;
+        }
+        __writer_append(writer, escape, escape_len);
+    }
+    __writer_append(writer, plain, value - plain);
+    __writer_append(writer, "\"", 1);
+}
+
+/**
+ * @brief 写入一个值之前的逗号与键名。对象中的值必须有键名，数组中的值不能有键名
+ *
+ * @param [in] writer 生成器
+ * @param [in] key 键名
+ */
+static void __writer_prefix(json_writer* writer, const char* key)
+{
+    Bool    in_array = False;
+
+    if (writer->err != BLIVE_ERR_OK) {
+        return ;
+    }
+    if (!writer->depth) {
+        /*最外层只能有一个值*/
+        if (writer->len || key != NULL) {
+            writer->err = BLIVE_ERR_INVALID;
+        }
+        return ;
+    }
+
+    in_array = (writer->is_array & JSON_LEVEL_BIT(writer->depth)) ? True : False;
+    if (in_array != (key == NULL)) {
+        writer->err = BLIVE_ERR_INVALID;
+        return ;
+    }
+    if (writer->has_elem & JSON_LEVEL_BIT(writer->depth)) {
+        __writer_append(writer, ",", 1);
+    }
+    writer->has_elem |= JSON_LEVEL_BIT(writer->depth);
+    if (key != NULL) {
+        __writer_quote(writer, key);
+        __writer_append(writer, ":", 1);
+    }
+}
+
+static void __writer_begin(json_writer* writer, const char* key, Bool array)
+{
+    __writer_prefix(writer, key);
+    if (writer->err != BLIVE_ERR_OK) {
+        return ;
+    }
+    if (writer->depth == JSON_WRITER_MAX_DEPTH) {
+        writer->err = BLIVE_ERR_RESOURCE;
+        return ;
+    }
+    writer->depth++;
+    writer->has_elem &= ~JSON_LEVEL_BIT(writer->depth);
+    if (array) {
+        writer->is_array |= JSON_LEVEL_BIT(writer->depth);
+    } else {
+        writer->is_array &= ~JSON_LEVEL_BIT(writer->depth);
+    }
+    __writer_append(writer, array ? "[" : "{", 1);
+}
+
+static void __writer_end(json_writer* writer, Bool array)
+{
+    if (writer->err != BLIVE_ERR_OK) {
+        return ;
+    }
+    if (!writer->depth || ((writer->is_array & JSON_LEVEL_BIT(writer->depth)) ? True : False) != array) {
+        writer->err = BLIVE_ERR_INVALID;
+        return ;
+    }
+    writer->depth--;
+    __writer_append(writer, array ? "]" : "}", 1);
+}
+
+
+void json_writer_init(json_writer* writer)
+{
+    memset(writer, 0, sizeof(json_writer));
+}
+
+void json_writer_release(json_writer* writer)
+{
+    free(writer->data);
+    memset(writer, 0, sizeof(json_writer));
+}
+
+void json_writer_reset(json_writer* writer)
+{
+    writer->len = 0;
+    writer->depth = 0;
+    writer->has_elem = 0;
+    writer->is_array = 0;
+    writer->err = BLIVE_ERR_OK;
+    if (writer->data != NULL) {
+        writer->data[0] = '\0';
+    }
+}
+
+blive_errno_t json_writer_error(const json_writer* writer)
+{
+    if (writer->err != BLIVE_ERR_OK) {
+        return writer->err;
+    }
+    return writer->depth ? BLIVE_ERR_INVALID : BLIVE_ERR_OK;
+}
+
+char* json_writer_detach(json_writer* writer, uint32_t* len)
+{
+    char*       data = writer->data;
+
+    if (json_writer_error(writer) != BLIVE_ERR_OK || data == NULL) {
+        json_writer_release(writer);
+        return NULL;
+    }
+    if (len != NULL) {
+        *len = writer->len;
+    }
+    memset(writer, 0, sizeof(json_writer));
+
+    return data;
+}
+
+void json_writer_object_begin(json_writer* writer, const char* key)
+{
+    __writer_begin(writer, key, False);
+}
+
+void json_writer_object_end(json_writer* writer)
+{
+    __writer_end(writer, False);
+}
+
+void json_writer_array_begin(json_writer* writer, const char* key)
+{
+    __writer_begin(writer, key, True);
+}
+
+void json_writer_array_end(json_writer* writer)
+{
+    __writer_end(writer, True);
+}
+
+void json_writer_string(json_writer* writer, const char* key, const char* value)
+{
+    __writer_prefix(writer, key);
+    __writer_quote(writer, value != NULL ? value : "");
+}
+
+void json_writer_uint(json_writer* writer, const char* key, uint64_t value)
+{
+    char    number[24] = {0};
+    int     number_len = 0;
+
+    __writer_prefix(writer, key);
+    number_len = snprintf(number, sizeof(number), "%" PRIu64, value);
+    __writer_append(writer, number, number_len);
+}
+
+void json_writer_bool(json_writer* writer, const char* key, Bool value)
+{
+    __writer_prefix(writer, key);
+    if (value) {
+        __writer_append(writer, "true", 4);
+    } else {
+        __writer_append(writer, "false", 5);
+    }
+}
@@ -0,0 +1,136 @@
+/**
+ * @file json_writer.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 流式的json生成器。边遍历数据边写入文本，不需要先构建cJSON的对象树，
+ *        逗号与字符串的转义由生成器处理
+ * @attention 写入出错(内存不足、嵌套过深、结构不匹配)后之后的写入都会被忽略，
+ * 只需要在最后通过json_writer_error检查一次
+ * @version 0.1
+ * @date 2023-03-25
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_JSON_WRITER_H__
+#define __UTILS_JSON_WRITER_H__
+
+#include <stdint.h>
+#include "utils.h"
+
+
+#define JSON_WRITER_MAX_DEPTH   64      /* 对象与数组的最大嵌套层数 */
+
+typedef struct {
+    char*           data;       /* 生成的文本，以'\0'结尾 */
+    uint32_t        len;        /* 文本的长度，不含结尾的'\0' */
+    uint32_t        cap;        /* 申请的长度 */
+    uint32_t        depth;      /* 当前的嵌套层数 */
+    uint64_t        has_elem;   /* 每一层是否已经写入过元素，决定下一个元素前是否需要逗号 */
+    uint64_t        is_array;   /* 每一层是数组还是对象 */
+    blive_errno_t   err;        /* 第一次出错的原因 */
+} json_writer;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 初始化生成器，缓冲区在第一次写入时申请
+ *
+ * @param [in] writer 生成器
+ */
+void json_writer_init(json_writer* writer);
+
+/**
+ * @brief 释放生成器的缓冲区
+ *
+ * @param [in] writer 生成器
+ */
+void json_writer_release(json_writer* writer);
+
+/**
+ * @brief 清空已生成的文本与错误，保留缓冲区以便复用
+ *
+ * @param [in] writer 生成器
+ */
+void json_writer_reset(json_writer* writer);
+
+/**
+ * @brief 检查生成的结果，有错误或者对象、数组没有闭合时返回错误
+ *
+ * @param [in] writer 生成器
+ * @return blive_errno_t
+ */
+blive_errno_t json_writer_error(const json_writer* writer);
+
+/**
+ * @brief 取走生成的文本，之后由调用者free，生成器回到初始化后的状态
+ *
+ * @param [in] writer 生成器
+ * @param [out] len 传出参数，文本的长度，可以为NULL
+ * @return char* 有错误时返回NULL，并释放缓冲区
+ */
+char* json_writer_detach(json_writer* writer, uint32_t* len);
+
+/**
+ * @brief 开始一个对象
+ *
+ * @param [in] writer 生成器
+ * @param [in] key 在对象中时为键名，在数组中或者作为最外层时为NULL
+ */
+void json_writer_object_begin(json_writer* writer, const char* key);
+
+/**
+ * @brief 结束当前的对象
+ *
+ * @param [in] writer 生成器
+ */
+void json_writer_object_end(json_writer* writer);
+
+/**
+ * @brief 开始一个数组
+ *
+ * @param [in] writer 生成器
+ * @param [in] key 在对象中时为键名，在数组中或者作为最外层时为NULL
+ */
+void json_writer_array_begin(json_writer* writer, const char* key);
+
+/**
+ * @brief 结束当前的数组
+ *
+ * @param [in] writer 生成器
+ */
+void json_writer_array_end(json_writer* writer);
+
+/**
+ * @brief 写入字符串，引号、反斜杠与控制字符会被转义，其余的UTF-8字节原样写入
+ *
+ * @param [in] writer 生成器
+ * @param [in] key 在对象中时为键名，在数组中时为NULL
+ * @param [in] value 字符串
+ */
+void json_writer_string(json_writer* writer, const char* key, const char* value);
+
+/**
+ * @brief 写入无符号整数
+ *
+ * @param [in] writer 生成器
+ * @param [in] key 在对象中时为键名，在数组中时为NULL
+ * @param [in] value 整数
+ */
+void json_writer_uint(json_writer* writer, const char* key, uint64_t value);
+
+/**
+ * @brief 写入布尔值
+ *
+ * @param [in] writer 生成器
+ * @param [in] key 在对象中时为键名，在数组中时为NULL
+ * @param [in] value 布尔值
+ */
+void json_writer_bool(json_writer* writer, const char* key, Bool value);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
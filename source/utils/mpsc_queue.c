@@ -0,0 +1,67 @@
+/**
+ * @file mpsc_queue.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 侵入式的无锁MPSC队列。生产者原子地交换head再链接前驱，消费者从tail沿
+ *        next取出，哨兵节点在队列取空时重新入队，使tail永远不为NULL
+ * @version 0.1
+ * @date 2023-03-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "mpsc_queue.h"
+
+
+void mpsc_queue_init(mpsc_queue_t* queue)
+{
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+void mpsc_queue_push(mpsc_queue_t* queue, mpsc_node_t* node)
+{
+    mpsc_node_t*    prev = NULL;
+
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+
+    /* 在这一步完成之前，node对消费者不可见 */
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+mpsc_node_t* mpsc_queue_pop(mpsc_queue_t* queue)
+{
+    mpsc_node_t*    tail = queue->tail;
+    mpsc_node_t*    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    /* 跳过哨兵节点 */
+    if (tail == &queue->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        queue->tail = next;
+        tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+
+    if (next != NULL) {
+        queue->tail = next;
+        return tail;
+    }
+
+    /* tail不是最后一个节点，说明有生产者正在入队 */
+    if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+
+    /* tail是最后一个节点，放入哨兵后才能将其取出 */
+    mpsc_queue_push(queue, &queue->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+        queue->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file mpsc_queue.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 无锁的多生产者单消费者队列。节点内嵌在调用者的结构体中，入队只有一次原子
+ *        交换，不需要申请内存，也不会阻塞
+ * @attention 任意线程都可以入队，但同一时刻只能有一个线程出队
+ * @version 0.1
+ * @date 2023-03-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_MPSC_QUEUE_H__
+#define __UTILS_MPSC_QUEUE_H__
+
+#include "utils.h"
+
+
+typedef struct mpsc_node_t {
+    struct mpsc_node_t*     next;
+} mpsc_node_t;
+
+typedef struct {
+    mpsc_node_t*    head;       /* 生产者入队的位置，原子交换 */
+    mpsc_node_t*    tail;       /* 消费者出队的位置，只有消费者访问 */
+    mpsc_node_t     stub;       /* 哨兵节点，保证队列中至少有一个节点 */
+} mpsc_queue_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 初始化队列
+ *
+ * @param [in] queue 队列
+ */
+void mpsc_queue_init(mpsc_queue_t* queue);
+
+/**
+ * @brief 入队，任意线程均可调用
+ *
+ * @param [in] queue 队列
+ * @param [in] node 节点
+ */
+void mpsc_queue_push(mpsc_queue_t* queue, mpsc_node_t* node);
+
+/**
+ * @brief 出队，只能由消费者线程调用
+ * @note 生产者正在入队的过程中时，其后的节点暂时不可见，此时也会返回NULL，
+ *       入队完成后即可取出
+ *
+ * @param [in] queue 队列
+ * @return mpsc_node_t* 出队的节点，队列为空时返回NULL
+ */
+mpsc_node_t* mpsc_queue_pop(mpsc_queue_t* queue);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
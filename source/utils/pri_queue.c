@@ -16,36 +16,49 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "utils.h"
 #include "pri_queue.h"
 
 
+/* 堆元素直接存放在堆数组中，不再单独申请内存 */
 typedef struct heap_element {
+    uint64_t            key;                /* 内联的优先级键，使用键比较时才有效 */
     void*               data;               /* 堆元素保存的数据 */
 } heap_element_t;
 
 typedef struct internal_heap {
     uint32_t            cur_size;           /* 堆当前的大小 */
     uint32_t            max_size;           /* 堆最大的大小 */
-    pri_comp_func       elem_compare_cb;    /* 堆元素比较 */
-    heap_element_t      *heap_mem[0];       /* 堆内存起始指针 */
+    pri_comp_func       elem_compare_cb;    /* 堆元素比较，为NULL时比较内联的键 */
+    pri_key_func        elem_key_cb;        /* 入堆时获取数据的键 */
+    heap_element_t      heap_mem[0];        /* 堆内存起始地址 */
 } inn_heap_t;
 
 struct pri_queue {
     pthread_mutex_t     mutex;
-    pthread_cond_t      cond;
+    pthread_cond_t      cond;           /* 使用CLOCK_MONOTONIC计时 */
+    uint32_t            waiters;        /* 正在等待数据的线程数 */
     Bool           adaption;       /* 堆大小自适应 */
     inn_heap_t          *heap;
 };
 
 
-static int __queue_pop(pri_queue_t* pri_queue, void** pdata, int32_t timeout);
+static pri_queue_t* __queue_create(int32_t initial_size, Bool size_adaption, pri_comp_func comp_cb, pri_key_func key_cb);
+static int __queue_pop(pri_queue_t* pri_queue, void** pdata, const struct timespec* deadline);
+static void __queue_notify(pri_queue_t* pri_queue, uint32_t num);
+static int __queue_grow(pri_queue_t* pri_queue);
+static int __queue_reserve(pri_queue_t* pri_queue, uint32_t num);
 
 static void __heap_sort(inn_heap_t *heap, int32_t index);
+static void __heap_sink(inn_heap_t *heap, uint32_t index);
+static void __heap_build(inn_heap_t *heap);
 static void* __heap_remove(inn_heap_t *heap, int32_t index);
 static int __heap_push(inn_heap_t *heap, void* data);
+static inline Bool __heap_higher(const inn_heap_t *heap, const heap_element_t *elem1, const heap_element_t *elem2);
 static void* __heap_pop(inn_heap_t *heap);
 static void* __heap_peek(inn_heap_t *heap);
 
@@ -54,42 +67,20 @@ static void* __heap_peek(inn_heap_t *heap);
 
 pri_queue_t *pri_queue_create(int32_t initial_size, Bool size_adaption, pri_comp_func cb)
 {
-    pri_queue_t *new_queue = NULL;
-
-    if (initial_size <= 0 || cb == NULL || cb == NULL) {
-        goto _out;
-    }
-
-    new_queue = (pri_queue_t*)zero_alloc(sizeof(pri_queue_t));
-    if (new_queue == NULL) {
-        goto _out;
+    if (cb == NULL) {
+        return NULL;
     }
 
-    memset(new_queue, 0, sizeof(pri_queue_t));
-    pthread_mutex_init(&new_queue->mutex, NULL);
-    pthread_cond_init(&new_queue->cond, NULL);
+    return __queue_create(initial_size, size_adaption, cb, NULL);
+}
 
-    /* 申请堆内存大小+1是因为堆首元素不使用，这样能够进行快速的上浮、下沉排序算法 */
-    new_queue->heap = (inn_heap_t*)zero_alloc(sizeof(inn_heap_t) + ((initial_size + 1) * sizeof(heap_element_t)));
-    if (new_queue == NULL) {
-        goto _free;
+pri_queue_t *pri_queue_create_keyed(int32_t initial_size, Bool size_adaption, pri_key_func cb)
+{
+    if (cb == NULL) {
+        return NULL;
     }
-    new_queue->heap->max_size = initial_size;
-    new_queue->heap->elem_compare_cb = cb;
-    new_queue->adaption = size_adaption;
-
-_out:
-    return new_queue;
 
-_free:
-    if (new_queue != NULL) {
-        if (new_queue->heap != NULL) {
-            free(new_queue->heap);
-        }
-        free(new_queue);
-        new_queue = NULL;
-    }
-    goto _out;
+    return __queue_create(initial_size, size_adaption, NULL, cb);
 }
 
 int pri_queue_destroy(pri_queue_t *pri_queue)
@@ -101,9 +92,6 @@ int pri_queue_destroy(pri_queue_t *pri_queue)
         pthread_cond_destroy(&pri_queue->cond);
 
         if (pri_queue->heap != NULL) {
-            for (int i = 1; i <= pri_queue->heap->cur_size; i++) {
-                free(pri_queue->heap->heap_mem[i]);
-            }
             free(pri_queue->heap);
         }
         free(pri_queue);
@@ -125,10 +113,7 @@ int pri_queue_peek(pri_queue_t * pri_queue, void** pdata)
 
     pthread_mutex_lock(&pri_queue->mutex);
     if (pri_queue->heap->cur_size > 0) {
-        heap_element_t*     elem = NULL;
-
-        elem = __heap_peek(pri_queue->heap);
-        *pdata = elem->data;
+        *pdata = __heap_peek(pri_queue->heap);
         retval = BLIVE_ERR_OK;
     } else {
         *pdata = NULL;
@@ -153,19 +138,17 @@ int pri_queue_push(pri_queue_t * pri_queue, void* data)
     pthread_mutex_lock(&pri_queue->mutex);
 
     retval = __heap_push(pri_queue->heap, data);
-    if (retval == BLIVE_ERR_RESOURCE) {
+    if (retval == BLIVE_ERR_RESOURCE && pri_queue->adaption) {
         /* 资源不足，原因为队列已满，如果开启大小自适应，将会进行自动扩容 */
-        if (pri_queue->adaption) {
-            int32_t  realloc_size = 0;
-
-            /* 扩容大小为原来的2倍 */
-            realloc_size = sizeof(inn_heap_t) + (pri_queue->heap->max_size * 2) + 1;
-            pri_queue->heap = realloc(pri_queue->heap, realloc_size);
+        retval = __queue_grow(pri_queue);
+        if (retval == BLIVE_ERR_OK) {
+            retval = __heap_push(pri_queue->heap, data);   /* 重新进行一次数据入堆 */
         }
-        retval = __heap_push(pri_queue->heap, data);   /* 重新进行一次数据入堆 */
     }
 
-    pthread_cond_broadcast(&pri_queue->cond);
+    if (retval == BLIVE_ERR_OK) {
+        __queue_notify(pri_queue, 1);
+    }
     pthread_mutex_unlock(&pri_queue->mutex);
     blive_logd("push data address %p\n", data);
 
@@ -173,31 +156,126 @@ _out:
     return retval;
 }
 
+int pri_queue_push_bulk(pri_queue_t *pri_queue, void* const* data, uint32_t num)
+{
+    int             retval = BLIVE_ERR_OK;
+    inn_heap_t*     heap = NULL;
+    heap_element_t* elem = NULL;
+    uint32_t        old_size = 0;
+
+    if (pri_queue == NULL || (data == NULL && num)) {
+        return BLIVE_ERR_INVALID;
+    }
+    for (uint32_t i = 0; i < num; i++) {
+        if (data[i] == NULL) {
+            return BLIVE_ERR_INVALID;
+        }
+    }
+    if (!num) {
+        return BLIVE_ERR_OK;
+    }
+
+    pthread_mutex_lock(&pri_queue->mutex);
+
+    retval = __queue_reserve(pri_queue, num);
+    if (retval != BLIVE_ERR_OK) {
+        goto _unlock;
+    }
+
+    heap = pri_queue->heap;
+    old_size = heap->cur_size;
+    for (uint32_t i = 0; i < num; i++) {
+        elem = &heap->heap_mem[old_size + i + 1];
+        elem->data = data[i];
+        elem->key = (heap->elem_key_cb != NULL) ? heap->elem_key_cb(data[i]) : 0;
+    }
+    heap->cur_size += num;
+
+    /* 新数据不少于原有数据时，整体重新建堆O(n)比逐个上浮O(m*log(n))更快 */
+    if (num >= old_size) {
+        __heap_build(heap);
+    } else {
+        for (uint32_t i = old_size + 1; i <= heap->cur_size; i++) {
+            __heap_sort(heap, i);
+        }
+    }
+    __queue_notify(pri_queue, num);
+
+_unlock:
+    pthread_mutex_unlock(&pri_queue->mutex);
+
+    return retval;
+}
+
+int pri_queue_pop_until(pri_queue_t *pri_queue, pri_pred_func pred, void* context, void** out, uint32_t max_num, uint32_t* num)
+{
+    uint32_t        count = 0;
+
+    if (pri_queue == NULL || pred == NULL || num == NULL || (out == NULL && max_num)) {
+        return BLIVE_ERR_INVALID;
+    }
+
+    /* 堆顶是优先级最高的数据，堆顶不满足条件时其余的数据也不再检查 */
+    pthread_mutex_lock(&pri_queue->mutex);
+    while (count < max_num && pri_queue->heap->cur_size > 0) {
+        if (!pred(__heap_peek(pri_queue->heap), context)) {
+            break;
+        }
+        out[count++] = __heap_pop(pri_queue->heap);
+    }
+    pthread_mutex_unlock(&pri_queue->mutex);
+    *num = count;
+
+    return BLIVE_ERR_OK;
+}
+
 int pri_queue_pop_wait(pri_queue_t *pri_queue, void* *pdata)
 {
     if (pri_queue == NULL || pdata == NULL) {
         return BLIVE_ERR_INVALID;
     }
 
-    return __queue_pop(pri_queue, pdata, -1);
+    return __queue_pop(pri_queue, pdata, NULL);
 }
 
 int pri_queue_pop_trywait(pri_queue_t *pri_queue, void* *pdata)
 {
+    struct timespec     deadline = {0, 0};  /* 早已过去的时间点，不会等待 */
+
     if (pri_queue == NULL || pdata == NULL) {
         return BLIVE_ERR_INVALID;
     }
 
-    return __queue_pop(pri_queue, pdata, 0);
+    return __queue_pop(pri_queue, pdata, &deadline);
 }
 
 int pri_queue_pop_timedwait(pri_queue_t *pri_queue, void* *pdata, int32_t timeout)
 {
+    struct timespec     deadline;
+
     if (pri_queue == NULL || pdata == NULL || timeout < 0) {
         return BLIVE_ERR_INVALID;
     }
 
-    return __queue_pop(pri_queue, pdata, timeout);
+    /* 相对时间在这里一次性换算为绝对时间，被虚假唤醒后不会重新计时 */
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (timeout % 1000) * 1000 * 1000;
+    if (deadline.tv_nsec >= 1000 * 1000 * 1000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000 * 1000 * 1000;
+    }
+
+    return __queue_pop(pri_queue, pdata, &deadline);
+}
+
+int pri_queue_pop_deadline(pri_queue_t *pri_queue, void* *pdata, const struct timespec* deadline)
+{
+    if (pri_queue == NULL || pdata == NULL || deadline == NULL) {
+        return BLIVE_ERR_INVALID;
+    }
+
+    return __queue_pop(pri_queue, pdata, deadline);
 }
 
 
@@ -212,37 +290,139 @@ int32_t pri_queue_get_size(const pri_queue_t *pri_queue)
 
 
 /**
- * 
+ * 创建优先级队列，比较回调和取键回调只能二选一
+ * @param [in] initial_size 初始大小
+ * @param [in] size_adaption 是否允许队列大小自动扩容
+ * @param [in] comp_cb 比较回调，为NULL时使用内联的键比较
+ * @param [in] key_cb 取键回调
+ * @retval pri_queue_t* 优先级队列指针
+ */
+static pri_queue_t* __queue_create(int32_t initial_size, Bool size_adaption, pri_comp_func comp_cb, pri_key_func key_cb)
+{
+    pri_queue_t *new_queue = NULL;
+    pthread_condattr_t  cond_attr;
+
+    if (initial_size <= 0) {
+        goto _out;
+    }
+
+    new_queue = (pri_queue_t*)zero_alloc(sizeof(pri_queue_t));
+    if (new_queue == NULL) {
+        goto _out;
+    }
+
+    /* 申请堆内存大小+1是因为堆首元素不使用，这样能够进行快速的上浮、下沉排序算法 */
+    new_queue->heap = (inn_heap_t*)zero_alloc(sizeof(inn_heap_t) + ((initial_size + 1) * sizeof(heap_element_t)));
+    if (new_queue->heap == NULL) {
+        goto _free;
+    }
+    pthread_mutex_init(&new_queue->mutex, NULL);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);  /* 等待不受系统时间调整的影响 */
+    pthread_cond_init(&new_queue->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    new_queue->heap->max_size = initial_size;
+    new_queue->heap->elem_compare_cb = comp_cb;
+    new_queue->heap->elem_key_cb = key_cb;
+    new_queue->adaption = size_adaption;
+
+_out:
+    return new_queue;
+
+_free:
+    free(new_queue);
+    new_queue = NULL;
+    goto _out;
+}
+
+/**
+ * 将堆的容量扩大为原来的2倍，需要在持有锁时调用
  * @param [in] pri_queue 优先级队列
- * @param [out] pdata 二级指针，取出数据
- * @param [in] timeout 超时时间，毫秒（ms）
  * @retval int 
  */
-static int __queue_pop(pri_queue_t *pri_queue, void* *pdata, int32_t timeout)
+static int __queue_grow(pri_queue_t* pri_queue)
+{
+    inn_heap_t*     new_heap = NULL;
+    uint32_t        new_size = 0;
+
+    new_size = pri_queue->heap->max_size * 2;
+    if (new_size <= pri_queue->heap->max_size || new_size > (UINT32_MAX - sizeof(inn_heap_t)) / sizeof(heap_element_t) - 1) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+
+    new_heap = realloc(pri_queue->heap, sizeof(inn_heap_t) + (new_size + 1) * sizeof(heap_element_t));
+    if (new_heap == NULL) {
+        return BLIVE_ERR_OUTOFMEM;      /* 原来的堆依然有效 */
+    }
+    new_heap->max_size = new_size;
+    pri_queue->heap = new_heap;
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * 保证堆中还能再放入num个数据，不允许扩容时空间不足返回BLIVE_ERR_RESOURCE，
+ * 需要在持有锁时调用
+ * @param [in] pri_queue 优先级队列
+ * @param [in] num 需要放入的数据个数
+ * @retval int 
+ */
+static int __queue_reserve(pri_queue_t* pri_queue, uint32_t num)
+{
+    int     retval = BLIVE_ERR_OK;
+
+    while (pri_queue->heap->max_size - pri_queue->heap->cur_size < num) {
+        if (!pri_queue->adaption) {
+            return BLIVE_ERR_RESOURCE;
+        }
+        retval = __queue_grow(pri_queue);
+        if (retval != BLIVE_ERR_OK) {
+            return retval;
+        }
+    }
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * 取出优先级最高的数据，队列为空时等待到有数据或到达截止时间为止
+ * @param [in] pri_queue 优先级队列
+ * @param [out] pdata 二级指针，取出数据
+ * @param [in] deadline CLOCK_MONOTONIC的绝对截止时间，NULL表示一直等待
+ * @retval int 超时返回BLIVE_ERR_RESOURCE
+ */
+static int __queue_pop(pri_queue_t *pri_queue, void* *pdata, const struct timespec* deadline)
 {
     int32_t         retval = BLIVE_ERR_OK;
-    struct timespec tm;
+    int             wait_ret = 0;
 
     pthread_mutex_lock(&pri_queue->mutex);
 
-    /* 队列中没有元素，根据传入的超时时间进行等待处理 */
-    if (pri_queue->heap->cur_size == 0) {
-        if (timeout == -1) {
+    /* 被唤醒并不代表一定有数据，可能是虚假唤醒，或者数据已经被其他线程取走，需要重新检查 */
+    pri_queue->waiters++;
+    while (pri_queue->heap->cur_size == 0) {
+        if (deadline == NULL) {
             pthread_cond_wait(&pri_queue->cond, &pri_queue->mutex);
-        } else if (timeout > 0) {
-            tm.tv_sec = timeout / 1000;
-            tm.tv_nsec = (timeout % 1000) * 1000 * 1000;
-            pthread_cond_timedwait(&pri_queue->cond, &pri_queue->mutex, &tm);
-        } else {
-            retval = BLIVE_ERR_RESOURCE;
+            continue;
+        }
+
+        wait_ret = pthread_cond_timedwait(&pri_queue->cond, &pri_queue->mutex, deadline);
+        if (wait_ret == ETIMEDOUT && pri_queue->heap->cur_size == 0) {
+            break;
         }
+    }
+    pri_queue->waiters--;
 
     /* 队列中有元素，取出 */
-    } else if (pri_queue->heap->cur_size > 0) {
+    if (pri_queue->heap->cur_size > 0) {
         *pdata = __heap_pop(pri_queue->heap);
+        /* 本线程取走之后还有剩余，而本线程可能消耗了一次本应唤醒其他线程的信号，补发一次 */
+        if (pri_queue->heap->cur_size > 0) {
+            __queue_notify(pri_queue, 1);
+        }
     } else {
         *pdata = NULL;
-        retval = BLIVE_ERR_UNKNOWN;
+        retval = BLIVE_ERR_RESOURCE;
     }
 
     pthread_mutex_unlock(&pri_queue->mutex);
@@ -250,6 +430,27 @@ static int __queue_pop(pri_queue_t *pri_queue, void* *pdata, int32_t timeout)
     return retval;
 }
 
+/**
+ * 有新数据时唤醒等待的线程，只唤醒与数据个数相同数量的线程，避免所有等待线程一起
+ * 醒来争抢。需要在持有锁时调用
+ * @param [in] pri_queue 优先级队列
+ * @param [in] num 新放入的数据个数
+ */
+static void __queue_notify(pri_queue_t* pri_queue, uint32_t num)
+{
+    if (!pri_queue->waiters) {
+        return ;
+    }
+
+    if (num >= pri_queue->waiters) {
+        pthread_cond_broadcast(&pri_queue->cond);
+    } else {
+        for (uint32_t i = 0; i < num; i++) {
+            pthread_cond_signal(&pri_queue->cond);
+        }
+    }
+}
+
 /**
  * 将数据存入堆中
  * @param [in] heap 堆指针
@@ -258,29 +459,35 @@ static int __queue_pop(pri_queue_t *pri_queue, void* *pdata, int32_t timeout)
  */
 static int __heap_push(inn_heap_t *heap, void* data)
 {
-    int     retval = BLIVE_ERR_OK;
-    heap_element_t  *new_elem = NULL;
+    heap_element_t* new_elem = NULL;
 
     if (heap->cur_size >= heap->max_size) {
-        retval = BLIVE_ERR_RESOURCE;
-        goto _out;
+        return BLIVE_ERR_RESOURCE;
     }
 
     /* 将数据放入堆，只能放在堆的底部。第0个不使用 */
-    new_elem = zero_alloc(sizeof(heap_element_t));
-    if (new_elem == NULL) {
-        retval = BLIVE_ERR_OUTOFMEM;
-        goto _out;
-    }
-    new_elem->data = data;
     heap->cur_size++;   /* 先让堆当前大小+1保证首个元素不使用 */
-    heap->heap_mem[heap->cur_size] = new_elem;  /* 将新增的元素放在堆底部 */
+    new_elem = &heap->heap_mem[heap->cur_size];
+    new_elem->data = data;
+    new_elem->key = (heap->elem_key_cb != NULL) ? heap->elem_key_cb(data) : 0;
 
     /* 对新放入在堆底部的元素进行上浮排序 */
     __heap_sort(heap, heap->cur_size);
 
-_out:
-    return retval;
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * 比较两个堆元素的优先级，没有比较回调时直接比较内联的键，键越小优先级越高
+ * @param [in] heap 堆指针
+ * @retval Bool True表示elem1的优先级更高
+ */
+static inline Bool __heap_higher(const inn_heap_t *heap, const heap_element_t *elem1, const heap_element_t *elem2)
+{
+    if (heap->elem_compare_cb == NULL) {
+        return elem1->key < elem2->key;
+    }
+    return heap->elem_compare_cb(elem1->data, elem2->data);
 }
 
 /**
@@ -290,7 +497,7 @@ _out:
  */
 static void* __heap_peek(inn_heap_t *heap)
 {
-    return heap->heap_mem[1];
+    return heap->heap_mem[1].data;
 }
 
 /**
@@ -313,8 +520,7 @@ static void* __heap_pop(inn_heap_t *heap)
 static void* __heap_remove(inn_heap_t *heap, int32_t index)
 {
     void*        data = NULL;
-    heap_element_t  *removed_elem = NULL;   /* 要被移除掉的元素 */
-    heap_element_t  *tail_elem = NULL;      /* 尾部的元素 */
+    heap_element_t  tail_elem;              /* 尾部的元素 */
     int32_t      cur_pos_index = 0;      /* 当前节点的序号 */
     int32_t      tail_parent_index = 0;  /* 尾部元素的父节点的序号 */
     int32_t      left_child_index = 0;   /* 左子节点的序号 */
@@ -325,10 +531,9 @@ static void* __heap_remove(inn_heap_t *heap, int32_t index)
         goto _out;
     }
 
-    removed_elem = heap->heap_mem[index];       /* 保存记录堆中指定序号的元素 */
+    data = heap->heap_mem[index].data;          /* 取出数据 */
     tail_elem = heap->heap_mem[heap->cur_size]; /* 保存记录堆中最后一个元素 */
-    heap->heap_mem[heap->cur_size] = NULL;      /* 删除堆中最后一个元素 */
-    heap->cur_size--;
+    heap->cur_size--;                           /* 删除堆中最后一个元素 */
     tail_parent_index = heap->cur_size / 2;
     cur_pos_index = index;
 
@@ -341,13 +546,13 @@ static void* __heap_remove(inn_heap_t *heap, int32_t index)
         winner_index = left_child_index;
         if (left_child_index != heap->cur_size) {   /* 检查左子节点是不是堆中的最后一个 */
             /* 左子节点不是堆中的最后一个，那么右子节点一定存在，比较两者大小 */
-            if (heap->elem_compare_cb(heap->heap_mem[right_child_index]->data, heap->heap_mem[left_child_index]->data)) {
+            if (__heap_higher(heap, &heap->heap_mem[right_child_index], &heap->heap_mem[left_child_index])) {
                 winner_index = right_child_index;
             }
         }
 
         /* 将左右子节点中的大者与堆尾元素进行比较大小，如果大者并不比堆尾元素大，那就说明此时左右子节点已经是完全二叉树的最后一层，退出 */
-        if (heap->elem_compare_cb(tail_elem->data, heap->heap_mem[winner_index]->data)) {
+        if (__heap_higher(heap, &tail_elem, &heap->heap_mem[winner_index])) {
             break;
         }
 
@@ -360,16 +565,50 @@ static void* __heap_remove(inn_heap_t *heap, int32_t index)
     }
 
     /* 此时需要删除的节点已经下沉到最末端的节点相同/相邻的层，已经不需要再进行下沉操作了，此时将尾部节点存入当前下沉到的位置 */
-    heap->heap_mem[cur_pos_index] = tail_elem;
-    __heap_sort(heap, cur_pos_index);   /* 对存入的节点进行一次上浮排序 */
-
-    data = removed_elem->data;  /* 取出数据 */
-    free(removed_elem);      /* 释放内存！！该内存是在push的时候申请的！！ */
+    if (cur_pos_index <= heap->cur_size) {
+        heap->heap_mem[cur_pos_index] = tail_elem;
+        __heap_sort(heap, cur_pos_index);   /* 对存入的节点进行一次上浮排序 */
+    }
 
 _out:
     return data;
 }
 
+/**
+ * 对堆中index位置的数据进行下沉，直到其子节点的优先级都不比它高为止
+ * @param [in] heap 堆指针
+ * @param [in] index 数据在堆中的序号
+ */
+static void __heap_sink(inn_heap_t *heap, uint32_t index)
+{
+    heap_element_t  tmp_element;
+    uint32_t        child_index = 0;
+
+    tmp_element = heap->heap_mem[index];
+    while ((child_index = index * 2) <= heap->cur_size) {
+        if (child_index < heap->cur_size && __heap_higher(heap, &heap->heap_mem[child_index + 1], &heap->heap_mem[child_index])) {
+            child_index++;
+        }
+        if (!__heap_higher(heap, &heap->heap_mem[child_index], &tmp_element)) {
+            break;
+        }
+        heap->heap_mem[index] = heap->heap_mem[child_index];
+        index = child_index;
+    }
+    heap->heap_mem[index] = tmp_element;
+}
+
+/**
+ * Floyd建堆，从最后一个非叶子节点开始依次下沉，整体复杂度为O(n)
+ * @param [in] heap 堆指针
+ */
+static void __heap_build(inn_heap_t *heap)
+{
+    for (uint32_t index = heap->cur_size / 2; index >= 1; index--) {
+        __heap_sink(heap, index);
+    }
+}
+
 /**
  * 对堆中index位置的数据进行一次上浮排序，直到不能上浮或上浮到根节点为止
  * @param [in] heap 堆指针
@@ -379,14 +618,14 @@ _out:
 static void __heap_sort(inn_heap_t *heap, int32_t index)
 {
     int32_t      parent_index = 0;
-    heap_element_t* tmp_element = NULL;
+    heap_element_t  tmp_element;
 
     tmp_element = heap->heap_mem[index];    /* 保存当前节点信息 */
 
     /* 上浮排序，比较第index节点和其父节点的大小，如果index节点大于其父节点，交换两者位置，循环进行直到根节点或index小于其父节点 */
     while (index > 1) {
         parent_index = index / 2;
-        if (heap->elem_compare_cb(heap->heap_mem[parent_index]->data, heap->heap_mem[index]->data)) {
+        if (!__heap_higher(heap, &tmp_element, &heap->heap_mem[parent_index])) {
             break;    /* index元素小于父节点元素，排序停止 */
         }
 
@@ -16,6 +16,7 @@
 #ifndef __UTILS_PRI_QUEUE_H__
 #define __UTILS_PRI_QUEUE_H__
 
+#include <time.h>
 #include "blive_api/blive_def.h"
 
 /* 基本优先级队列类型 */
@@ -24,6 +25,13 @@ typedef struct pri_queue pri_queue_t;
 /* 比较输入两个保存的数据的优先级，true表示elem1的优先级更高，false反之 */
 typedef Bool (*pri_comp_func)(void* elem1, void* elem2);
 
+/* 获取数据的优先级键，键越小优先级越高。只在入队时调用一次，键与数据一起保存在堆中，
+   比较时不再访问数据本身 */
+typedef uint64_t (*pri_key_func)(const void* elem);
+
+/* 判断数据是否满足出队的条件，context为调用pri_queue_pop_until时传入的参数 */
+typedef Bool (*pri_pred_func)(void* elem, void* context);
+
 typedef struct {
     pri_comp_func    priority_compare;   /* 优先级比较的回调函数 */
 } pri_queue_cb_t;
@@ -44,6 +52,15 @@ extern "C" {
  */
 pri_queue_t *pri_queue_create(int32_t initial_size, Bool size_adaption, pri_comp_func cb);
 
+/**
+ * 创建一个使用内联键比较的优先级队列，数据入队后键不能再改变
+ * @param [in] initial_size 初始大小
+ * @param [in] size_adaption 是否允许队列大小自动扩容
+ * @param [in] cb 获取数据的优先级键的回调函数
+ * @retval pri_queue_t* 优先级队列指针
+ */
+pri_queue_t *pri_queue_create_keyed(int32_t initial_size, Bool size_adaption, pri_key_func cb);
+
 /**
  * 销毁一个优先级队列
  * @param [in] pri_queue 优先级队列指针优先级队列指针
@@ -67,6 +84,29 @@ int pri_queue_peek(pri_queue_t * pri_queue, void** pdata);
  */
 int pri_queue_push(pri_queue_t * pri_queue, void* data);
 
+/**
+ * 将一批数据存入优先级队列，只加锁一次。新数据不少于队列中已有的数据时整体重新建堆，
+ * 否则逐个上浮。空间不足且不允许扩容时一个也不存入
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] data 数据指针数组
+ * @param [in] num 数据个数
+ * @retval int BLIVE_ERR_OK : 成功, 其他失败
+ */
+int pri_queue_push_bulk(pri_queue_t *pri_queue, void* const* data, uint32_t num);
+
+/**
+ * 在一次加锁内，按优先级顺序取出所有满足条件的数据，遇到第一个不满足条件的数据或
+ * 取满max_num个时停止，不阻塞
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] pred 出队条件
+ * @param [in] context 传给pred的参数
+ * @param [out] out 保存取出的数据指针的数组
+ * @param [in] max_num 数组的大小
+ * @param [out] num 实际取出的个数
+ * @retval int BLIVE_ERR_OK : 成功, 其他失败
+ */
+int pri_queue_pop_until(pri_queue_t *pri_queue, pri_pred_func pred, void* context, void** out, uint32_t max_num, uint32_t* num);
+
 /**
  * 取出优先级队列的首个数据，如果不存在数据，阻塞等待
  * @param [in] pri_queue 优先级队列指针
@@ -87,11 +127,21 @@ int pri_queue_pop_trywait(pri_queue_t *pri_queue, void* *pdata);
  * 取出优先级队列的首个数据，如果不存在数据，阻塞等待指定时间
  * @param [in] pri_queue 优先级队列指针
  * @param [in] pdata 保存数据指针的指针
- * @param [in] timeout 阻塞等待的时间
- * @retval int BLIVE_ERR_OK : 成功, 其他失败
+ * @param [in] timeout 阻塞等待的时间，毫秒（ms）
+ * @retval int BLIVE_ERR_OK : 成功, BLIVE_ERR_RESOURCE : 超时, 其他失败
  */
 int pri_queue_pop_timedwait(pri_queue_t *pri_queue, void* *pdata, int32_t timeout);
 
+/**
+ * 取出优先级队列的首个数据，如果不存在数据，阻塞等待到截止时间为止。多个线程
+ * 共用同一个截止时间时不会因为被唤醒而延长等待
+ * @param [in] pri_queue 优先级队列指针
+ * @param [in] pdata 保存数据指针的指针
+ * @param [in] deadline 截止时间，为CLOCK_MONOTONIC时钟的绝对时间
+ * @retval int BLIVE_ERR_OK : 成功, BLIVE_ERR_RESOURCE : 超时, 其他失败
+ */
+int pri_queue_pop_deadline(pri_queue_t *pri_queue, void* *pdata, const struct timespec* deadline);
+
 /**
  * 获取一个优先级队列内还有多少个数据
  * @param [in] pri_queue 优先级队列指针
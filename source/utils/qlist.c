@@ -29,9 +29,12 @@ typedef struct {
 
 struct blive_qlist {
     uint32_t        elem_num;       /*qlist中的单元数量*/
+    uint64_t        version;        /*每次修改后加一，持有锁时修改，读取时不加锁*/
     pthread_mutex_t lock;           /*多线程下安全锁*/
     list            list_head;      /*存储单元的环形链表*/
     qlist_unit*     tmp_unit;       /*暂存的单元*/
+    qlist_change_cb change_cb;      /*队列变化的监听者*/
+    void*           change_ctx;
 };
 
 
@@ -65,6 +68,39 @@ static qlist_unit* qlist_search(blive_qlist* qlist, uint32_t anchorage)
     return NULL;
 }
 
+/**
+ * @brief 计算单元在队列中的位置，队首为0。队列按权重从大到小排列，只能从头遍历
+ * 
+ * @param [in] qlist 权重值实时排队队列实体
+ * @param [in] unit 队列中的单元
+ * @return uint32_t 
+ */
+static uint32_t qlist_rank(blive_qlist* qlist, const qlist_unit* unit)
+{
+    list*       list_ptr = qlist->list_head.next;
+    uint32_t    rank = 0;
+
+    while (list_ptr != &unit->list_node) {
+        list_ptr = list_ptr->next;
+        rank++;
+    }
+    return rank;
+}
+
+/**
+ * @brief 版本号加一，并通知监听者，需要持有锁时调用
+ * 
+ * @param [in] qlist 权重值实时排队队列实体
+ * @param [in] change 变化的内容，版本号在这里填入
+ */
+static void qlist_changed(blive_qlist* qlist, qlist_change* change)
+{
+    change->version = __atomic_add_fetch(&qlist->version, 1, __ATOMIC_RELEASE);
+    if (qlist->change_cb != NULL) {
+        qlist->change_cb(change, qlist->change_ctx);
+    }
+}
+
 static blive_errno_t qlist_append(blive_qlist* qlist, qlist_unit* append_unit)
 {
     qlist_unit* tail_unit = NULL;
@@ -117,8 +153,8 @@ static blive_errno_t qlist_append(blive_qlist* qlist, qlist_unit* append_unit)
         search_unit = GET_PREV_UNIT(search_unit);
     }
     
-    /*如果在[begin_unit, end_unit)的区间内未找到可以插入的点，检测是否可以插入end_unit后方*/
-    if (end_unit->data.weight > append_unit->data.weight) {
+    /*如果在[begin_unit, end_unit)的区间内未找到可以插入的点，检测是否可以插入end_unit后方，权重相同时排在后面*/
+    if (end_unit->data.weight >= append_unit->data.weight) {
         UNIT_APPEND_REAR(end_unit, append_unit);
         return BLIVE_ERR_OK;
     }
@@ -178,6 +214,7 @@ Bool qlist_anchorage_existence(blive_qlist* qlist, uint32_t anchorage)
 blive_errno_t qlist_append_update(blive_qlist* qlist, uint32_t anchorage, const qlist_unit_data* data)
 {
     qlist_unit*     unit = NULL;
+    qlist_change    change = {.anchorage = anchorage};
     blive_errno_t   retval = BLIVE_ERR_UNKNOWN;
 
     pthread_mutex_lock(&qlist->lock);
@@ -185,7 +222,34 @@ blive_errno_t qlist_append_update(blive_qlist* qlist, uint32_t anchorage, const
     /*链表中已存在锚定值对应的单元，则更新他的数据*/
     if (unit != NULL) {
         blive_logi("update qlist anchorage %u's weight from %u to %u", anchorage, unit->data.weight, data->weight);
-        memcpy(&unit->data, data, sizeof(qlist_unit_data));
+        change.type = QLIST_CHANGE_UPDATE;
+        if (qlist->change_cb != NULL) {
+            change.old_rank = qlist_rank(qlist, unit);
+        }
+        /*权重变化时先取出再按新的权重重新插入，保证队列始终按权重排列*/
+        if (unit->data.weight != data->weight) {
+            UNIT_SUBTRACT(unit);
+            if (qlist->tmp_unit == unit) {
+                qlist->tmp_unit = NULL;
+            }
+            qlist->elem_num--;
+            memcpy(&unit->data, data, sizeof(qlist_unit_data));
+            if (qlist_append(qlist, unit) != BLIVE_ERR_OK) {
+                blive_loge("unknown error, append anchorage %u to the rear", anchorage);
+                LIST_APPEND_AHEAD(&qlist->list_head, &unit->list_node);
+            }
+            qlist->elem_num++;
+        } else {
+            memcpy(&unit->data, data, sizeof(qlist_unit_data));
+        }
+        if (qlist->change_cb != NULL) {
+            change.rank = qlist_rank(qlist, unit);
+            if (change.rank != change.old_rank) {
+                change.type = QLIST_CHANGE_MOVE;
+            }
+        }
+        change.data = &unit->data;
+        qlist_changed(qlist, &change);
         retval = BLIVE_ERR_OK;
     /*链表中不存在锚定值对应的单元，则创建一个新单元用于存储*/
     } else {
@@ -201,8 +265,13 @@ blive_errno_t qlist_append_update(blive_qlist* qlist, uint32_t anchorage, const
             retval = qlist_append(qlist, unit);
             if (!retval) {
                 qlist->elem_num++;
+                change.type = QLIST_CHANGE_INSERT;
+                change.rank = qlist->change_cb != NULL ? qlist_rank(qlist, unit) : 0;
+                change.data = &unit->data;
+                qlist_changed(qlist, &change);
             } else {
                 blive_loge("unknown error");
+                free(unit);
             }
         }
     }
@@ -214,6 +283,7 @@ blive_errno_t qlist_append_update(blive_qlist* qlist, uint32_t anchorage, const
 blive_errno_t qlist_subtract(blive_qlist* qlist, uint32_t anchorage)
 {
     qlist_unit*     unit = NULL;
+    qlist_change    change = {.type = QLIST_CHANGE_REMOVE, .anchorage = anchorage};
 
     pthread_mutex_lock(&qlist->lock);
     unit = qlist_search(qlist, anchorage);
@@ -222,11 +292,15 @@ blive_errno_t qlist_subtract(blive_qlist* qlist, uint32_t anchorage)
         blive_logi("subtract failed: not found anchorage %u", anchorage);
         return BLIVE_ERR_RESOURCE;
     }
+    if (qlist->change_cb != NULL) {
+        change.rank = qlist_rank(qlist, unit);
+    }
     UNIT_SUBTRACT(unit);
     if (qlist->tmp_unit == unit) {
         qlist->tmp_unit = NULL;
     }
     qlist->elem_num--;
+    qlist_changed(qlist, &change);
     blive_logi("subtract unit: anchorage %u", anchorage);
     free(unit);
     pthread_mutex_unlock(&qlist->lock);
@@ -236,16 +310,27 @@ blive_errno_t qlist_subtract(blive_qlist* qlist, uint32_t anchorage)
 
 blive_errno_t qlist_foreach(blive_qlist* qlist, Bool invert_seq, qlist_foreach_cb cb, void* context)
 {
-    list*       list_ptr = &qlist->list_head;
-    qlist_unit* each_unit = NULL;
+    return qlist_foreach_version(qlist, invert_seq, cb, context, NULL);
+}
+
+blive_errno_t qlist_foreach_version(blive_qlist* qlist, Bool invert_seq, qlist_foreach_cb cb, void* context, uint64_t* version)
+{
+    list*           list_ptr = NULL;
+    qlist_unit*     each_unit = NULL;
+    blive_errno_t   retval = BLIVE_ERR_OK;
 
     if (qlist == NULL || cb == NULL) {
         return BLIVE_ERR_NULLPTR;
     }
+    list_ptr = &qlist->list_head;
+    pthread_mutex_lock(&qlist->lock);
+    if (version != NULL) {
+        *version = qlist->version;
+    }
     if (!qlist->elem_num) {
+        pthread_mutex_unlock(&qlist->lock);
         return BLIVE_ERR_RESOURCE;
     }
-    pthread_mutex_lock(&qlist->lock);
 
     /*qlist不为空，遍历链表查找锚定值是否有相同的，如果有返回找到的单元*/
     for (int count = 0; count < qlist->elem_num; count++) {
@@ -256,11 +341,32 @@ blive_errno_t qlist_foreach(blive_qlist* qlist, Bool invert_seq, qlist_foreach_c
         }
         each_unit = list_entry(list_ptr, qlist_unit, list_node);
         if (cb(each_unit->anchorage, &each_unit->data, context) == False) {
-            pthread_mutex_unlock(&qlist->lock);
-            return BLIVE_ERR_TERMINATE;
+            retval = BLIVE_ERR_TERMINATE;
+            break;
         }
     }
 
+    pthread_mutex_unlock(&qlist->lock);
+    return retval;
+}
+
+blive_errno_t qlist_observe(blive_qlist* qlist, qlist_change_cb cb, void* context)
+{
+    if (qlist == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    pthread_mutex_lock(&qlist->lock);
+    qlist->change_cb = cb;
+    qlist->change_ctx = context;
     pthread_mutex_unlock(&qlist->lock);
     return BLIVE_ERR_OK;
 }
+
+uint64_t qlist_version(blive_qlist* qlist)
+{
+    if (qlist == NULL) {
+        return 0;
+    }
+    return __atomic_load_n(&qlist->version, __ATOMIC_ACQUIRE);
+}
@@ -40,7 +40,24 @@ typedef struct {
     char                fans_price_name[DEFAULT_NAME_LEN];      /*粉丝牌名称*/
 } qlist_unit_data;
 
+typedef enum {
+    QLIST_CHANGE_INSERT,        /*新单元插入到rank*/
+    QLIST_CHANGE_REMOVE,        /*rank处的单元被移除*/
+    QLIST_CHANGE_MOVE,          /*单元从old_rank移动到rank，数据同时更新*/
+    QLIST_CHANGE_UPDATE,        /*rank处的单元数据更新，位置不变*/
+} qlist_change_type;
+
+typedef struct {
+    qlist_change_type       type;
+    uint32_t                anchorage;  /*锚定值*/
+    uint32_t                rank;       /*变化后所在的位置，从队首的0开始；移除时为移除前的位置*/
+    uint32_t                old_rank;   /*移动前的位置，只在QLIST_CHANGE_MOVE时有效*/
+    uint64_t                version;    /*这次变化之后的版本号*/
+    const qlist_unit_data*  data;       /*变化后的数据，移除时为NULL*/
+} qlist_change;
+
 typedef Bool (*qlist_foreach_cb)(uint32_t anchorage, const qlist_unit_data* data, void* context);
+typedef void (*qlist_change_cb)(const qlist_change* change, void* context);
 
 typedef struct blive_qlist blive_qlist;
 
@@ -104,6 +121,39 @@ blive_errno_t qlist_subtract(blive_qlist* qlist, uint32_t anchorage);
  */
 blive_errno_t qlist_foreach(blive_qlist* qlist, Bool invert_seq, qlist_foreach_cb cb, void* context);
 
+/**
+ * @brief qlist遍历处理，同时传出遍历时的版本号。遍历期间持有锁，遍历到的内容与版本号
+ *        一致，可用于生成快照，之后版本号更大的变化都不包含在快照中
+ * 
+ * @param [in] qlist 权重值实时排队队列实体 
+ * @param [in] invert_seq 是否倒序遍历
+ * @param [in] cb 回调函数
+ * @param [in] context 回调函数的上下文
+ * @param [out] version 传出参数，遍历时的版本号，队列为空时也会传出
+ * @return blive_errno_t 队列为空时返回BLIVE_ERR_RESOURCE
+ */
+blive_errno_t qlist_foreach_version(blive_qlist* qlist, Bool invert_seq, qlist_foreach_cb cb, void* context, uint64_t* version);
+
+/**
+ * @brief 设置队列变化的监听者，每次插入、移除、移动、更新单元后回调一次。回调在修改
+ *        队列的线程中、持有锁时调用，按版本号的顺序依次发生，回调中不能再操作该队列
+ * 
+ * @param [in] qlist 权重值实时排队队列实体 
+ * @param [in] cb 回调函数，为NULL时取消监听
+ * @param [in] context 回调函数的上下文
+ * @return blive_errno_t 
+ */
+blive_errno_t qlist_observe(blive_qlist* qlist, qlist_change_cb cb, void* context);
+
+/**
+ * @brief 获取qlist的版本号，每次插入、更新、移除单元后加一，版本号不变说明内容没有变化。
+ *        任意线程均可调用
+ * 
+ * @param [in] qlist 权重值实时排队队列实体 
+ * @return uint64_t 
+ */
+uint64_t qlist_version(blive_qlist* qlist);
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,7 +9,7 @@
  * 
  */
 #include <unistd.h>
-#include <sys/time.h>
+#include <time.h>
 #include <pthread.h>
 #include <errno.h>
 #include <stdio.h>
@@ -20,61 +20,164 @@
 #else
 #include <sys/ioctl.h>
 #endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
-#include "hash.h"
-#include "pri_queue.h"
+#include "timer_wheel.h"
+#include "mpsc_queue.h"
+#include "histogram.h"
 #include "select.h"
+#include "engine_backend.h"
 #include "bliveq_internal.h"
 
 
-#define PRI_QUEUE_SIZE      50
+#define TIMER_BUDGET_DEFAULT    64  /* 每轮循环默认最多执行的定时器回调数量 */
+#define NS_PER_US               1000ULL
+#define NS_PER_TICK             (1000ULL * 1000)    /* 时间轮的一个刻度为1毫秒 */
+#define FD_SLOT_MIN_NUM         64  /* fd槽数组的初始长度 */
+#define STATS_SITE_MAX          32  /* 分别统计耗时的回调函数的最大数量，超出的合并统计 */
+
+/* 句柄的高32位为事件的gen，低32位为事件的序号+1，保证有效的句柄不为0 */
+#define SELECT_TIMER_HANDLE(event)  (((select_timer_t)(event)->gen << 32) | ((event)->id + 1))
 
 
+/**
+ * @brief fd的监视信息，直接以fd作为下标存放在槽数组中
+ *
+ */
+typedef struct {
+    select_fd_cb        cb;             /* 只关心可读的回调，与io_cb二选一 */
+    select_io_cb        io_cb;          /* 带有就绪事件的回调 */
+    uint32_t            interest;       /* 监视的事件，SELECT_EVENT_* */
+    Bool                temporary;
+    void*               context;
+    int32_t             active_index;   /* 在活跃fd列表中的位置，-1表示没有被监视 */
+} engine_fd_t;
+
 typedef enum {
-    ENGINE_EVENT_RESTART,
-    ENGINE_EVENT_STOP,
-} engine_manage_event_t;
+    ENGINE_CMD_FD_ADD,
+    ENGINE_CMD_FD_MOD,
+    ENGINE_CMD_FD_DEL,
+    ENGINE_CMD_TASK,        /* 在引擎线程中执行一次回调 */
+} engine_cmd_type_t;
 
+/**
+ * @brief 其他线程提交给引擎线程执行的命令
+ *
+ */
 typedef struct {
+    mpsc_node_t         node;
+    uint64_t            seq;        /* 提交的序号，用于限定每轮执行的命令 */
+    engine_cmd_type_t   type;
+    fd_t                fd;
+    engine_fd_t         watch;      /* 添加时的监视信息，修改时只使用interest */
+    select_schedule_cb  task;
+    void*               task_context;
+} engine_cmd_t;
+
+typedef enum {
+    EVENT_STATE_IDLE,       /* 在空闲池中 */
+    EVENT_STATE_PENDING,    /* 在时间轮中等待到期 */
+    EVENT_STATE_EXPIRED,    /* 已经到期，等待执行回调 */
+    EVENT_STATE_RUNNING,    /* 正在执行回调 */
+} engine_event_state_t;
+
+typedef struct {
+    timer_wheel_node_t  node;       /* 时间轮节点，一个刻度为1毫秒 */
     select_schedule_cb  cb;
     void*               context;
-    struct timeval      time;
+    uint32_t            id;         /* 在事件表中的序号 */
+    uint32_t            gen;        /* 每次回收都会递增，用来使旧的句柄失效 */
+    engine_event_state_t    state;
+    uint64_t            deadline;   /* 设定的到期时间(ns)，未经取整与合并，用于统计延迟 */
 } engine_event_t;
 
+/**
+ * @brief 事件引擎的运行统计，开启统计时才申请，此后直到引擎销毁都不会释放，
+ *        其他线程可以随时读取。只有引擎线程写入，各个计数均为原子操作
+ *
+ */
 typedef struct {
-    fd_t                fd;
-    select_fd_cb        cb;
-    Bool                temporary;
-    void*               context;
-} engine_fd_t;
+    histogram_t         loop_time;      /* 每轮循环处理事件的耗时(ns)，不含等待 */
+    histogram_t         timer_lateness; /* 定时器实际执行与设定时间之差(ns) */
+    histogram_t         ready_fds;      /* 每次唤醒就绪的fd数量 */
+    struct {
+        const void*     site;           /* 回调函数的地址，NULL表示空位 */
+        histogram_t     exec_time;      /* 回调的执行耗时(ns) */
+    } callbacks[STATS_SITE_MAX + 1];    /* 最后一个用于合并统计超出数量的回调 */
+} engine_stats_t;
+
 
 struct select_engine_t {
-    pri_queue_t*        event_queue;
-    hash_t*             fd_poll;
-    fd_set              read_fds;
-    fd_t                max_fd;
+    timer_wheel_t       timers;         /* 定时器事件 */
+    list                expired;        /* 已经到期但尚未执行的定时器事件 */
+    uint32_t            timer_budget;   /* 每轮循环最多执行的定时器回调数量，0表示不限制 */
+    engine_event_t**    event_table;    /* 所有申请过的定时器事件，句柄通过序号索引 */
+    uint32_t            event_num;
+    uint32_t            event_max_num;
+    list                event_pool;     /* 空闲的定时器事件，避免每次添加都申请内存 */
+    uint64_t            timer_slack;    /* 定时器允许推迟的刻度数，用于合并相近的定时器，0表示不合并 */
+    uint64_t            wait_until;     /* 引擎阻塞等待到的刻度，0表示没有在等待 */
+    pthread_mutex_t     timer_lock;     /* 保护以上定时器相关的成员 */
+    uint64_t            now;            /* 每轮循环缓存一次的单调时钟(ns)，只在引擎线程中使用 */
+    pthread_t           loop_thread;    /* 执行select_engine_perform的线程 */
+    Bool                in_loop;
+    mpsc_queue_t        cmd_queue;      /* 其他线程提交的命令，由引擎线程在每轮循环开始时执行 */
+    uint64_t            cmd_seq;        /* 最后分配的命令序号 */
+    engine_cmd_t*       cmd_deferred;   /* 上一轮取出但超出范围的命令，本轮最先执行 */
+    int                 wake_pending;   /* 已经唤醒过引擎但引擎尚未响应，期间的唤醒合并为一次 */
+    fd_t                wake_fd[2];     /* 唤醒引擎用的fd，Linux下两端是同一个eventfd */
+    /* 以下fd相关的成员只在引擎线程中访问 */
+    engine_fd_t*        fd_slots;       /* 以fd为下标的监视信息，按需扩容 */
+    int32_t             fd_slot_num;
+    fd_t*               fd_active;      /* 所有正在监视的fd，紧凑排列，用于遍历 */
+    int32_t             fd_active_num;
+    int32_t             fd_active_max_num;
+    const engine_backend_ops*   backend;    /* IO多路复用后端 */
+    void*               backend_ctx;
+    engine_ready_t      ready[ENGINE_BACKEND_MAX_READY];
     Bool                need_continue;
-    Bool                has_reset;
-    pthread_mutex_t     running_flag;   /* 是否在运行的标志位 */
-    fd_t                manage_pipe[2];
+    engine_stats_t*     stats;          /* 运行统计，NULL表示从未开启过 */
+    Bool                stats_enabled;
 };
 
 
 static void __engine_destroy(select_engine_t* engine);
-static uint32_t __fd_poll_hash_func(const char *key);
-static Bool __event_queue_pri_comp(void* event1, void* event2);
-static Bool __fd_set_foreach(const char *key, const void* value, void* context);
-static Bool __fd_isset_foreach(const char *key, const void* value, void* context);
-static void __manage_fd_callback(fd_t manage_fd, void* context);
-static void __engine_reload(select_engine_t* engine);
-static int __engine_fd_add(select_engine_t* engine, fd_t fd, select_fd_cb callback, void* context, Bool temporary);
-int __engine_fd_del(select_engine_t* engine, fd_t fd);
+static inline uint64_t __engine_stats_begin(select_engine_t* engine);
+static void __engine_stats_callback(select_engine_t* engine, const void* site, uint64_t begin);
+static void __engine_stats_summary(const histogram_t* hist, select_stats_summary_t* summary);
+static uint64_t __engine_clock_ns(void);
+static uint64_t __engine_now_ns(select_engine_t* engine);
+static void __engine_timer_expire(select_engine_t* engine);
+static engine_event_t* __engine_event_alloc(select_engine_t* engine);
+static engine_event_t* __engine_event_lookup(select_engine_t* engine, select_timer_t handle);
+static void __engine_event_recycle(select_engine_t* engine, engine_event_t* event);
+static void __engine_event_arm(select_engine_t* engine, engine_event_t* event, int64_t timeous);
+static blive_errno_t __engine_backend_init(select_engine_t* engine, select_backend_t backend);
+static void __engine_fd_dispatch(select_engine_t* engine, fd_t fd, uint32_t events);
+static Bool __engine_in_loop(select_engine_t* engine);
+static blive_errno_t __engine_wake_init(select_engine_t* engine);
+static void __engine_wakeup(select_engine_t* engine);
+static void __engine_wake_callback(fd_t wake_fd, void* context);
+static blive_errno_t __engine_cmd_submit(select_engine_t* engine, const engine_cmd_t* request);
+static blive_errno_t __engine_cmd_apply(select_engine_t* engine, const engine_cmd_t* cmd);
+static void __engine_cmd_drain(select_engine_t* engine);
+static blive_errno_t __engine_fd_add(select_engine_t* engine, fd_t fd, const engine_fd_t* watch);
+static blive_errno_t __engine_fd_mod(select_engine_t* engine, fd_t fd, uint32_t interest);
+static blive_errno_t __engine_fd_del(select_engine_t* engine, fd_t fd);
 
 
 blive_errno_t select_engine_create(select_engine_t **engine)
+{
+    return select_engine_create_with_backend(engine, SELECT_BACKEND_AUTO);
+}
+
+blive_errno_t select_engine_create_with_backend(select_engine_t **engine, select_backend_t backend)
 {
     int          retval = BLIVE_ERR_OK;
     select_engine_t  *new_engine = NULL;
+    engine_fd_t     wake_watch = {0};
 
     if (engine == NULL) {
         retval = BLIVE_ERR_INVALID;
@@ -88,26 +191,38 @@ blive_errno_t select_engine_create(select_engine_t **engine)
     }
     memset(new_engine, 0, sizeof(select_engine_t));
 
-
-    /* 创建优先级队列作为事件队列 */
-    new_engine->event_queue = pri_queue_create(PRI_QUEUE_SIZE, True, __event_queue_pri_comp);
-    if (new_engine->event_queue == NULL) {
-        retval = BLIVE_ERR_UNKNOWN;
-        goto _destroy;
+    /* 创建命令队列和唤醒引擎用的fd */
+    mpsc_queue_init(&new_engine->cmd_queue);
+    retval = __engine_wake_init(new_engine);
+    if (retval != BLIVE_ERR_OK) {
+        free(new_engine);
+        goto _out;
     }
 
-    /* 创建哈希表作为fd池 */
-    retval = hash_create(&new_engine->fd_poll, 100, __fd_poll_hash_func);
+    /* 创建时间轮作为事件队列 */
+    new_engine->now = __engine_clock_ns();
+    timer_wheel_init(&new_engine->timers, new_engine->now / NS_PER_TICK);
+    LIST_NODE_INIT(&new_engine->expired);
+    LIST_NODE_INIT(&new_engine->event_pool);
+    new_engine->timer_budget = TIMER_BUDGET_DEFAULT;
+    pthread_mutex_init(&new_engine->timer_lock, NULL);
+
+    /* 选择IO多路复用后端 */
+    retval = __engine_backend_init(new_engine, backend);
     if (retval != BLIVE_ERR_OK) {
         goto _destroy;
     }
 
     new_engine->need_continue = True;
-    pthread_mutex_init(&new_engine->running_flag, NULL);
 
-    _socketpair(new_engine->manage_pipe);
-    blive_logd("[%d, %d]", RD_FD(new_engine->manage_pipe), WR_FD(new_engine->manage_pipe));
-    __engine_fd_add(new_engine, RD_FD(new_engine->manage_pipe), __manage_fd_callback, new_engine, False);
+    /* 引擎尚未运行，直接注册 */
+    wake_watch.cb = __engine_wake_callback;
+    wake_watch.interest = SELECT_EVENT_READ;
+    wake_watch.context = new_engine;
+    retval = __engine_fd_add(new_engine, RD_FD(new_engine->wake_fd), &wake_watch);
+    if (retval != BLIVE_ERR_OK) {
+        goto _destroy;
+    }
 
     *engine = new_engine;
 _out:
@@ -118,6 +233,14 @@ _destroy:
     goto _out;
 }
 
+const char* select_engine_backend_name(const select_engine_t* engine)
+{
+    if (engine == NULL || engine->backend == NULL) {
+        return NULL;
+    }
+    return engine->backend->name;
+}
+
 blive_errno_t select_engine_fd_add_forever(select_engine_t* engine, fd_t fd, select_fd_cb callback, void* context)
 {
     int              retval = BLIVE_ERR_OK;
@@ -127,8 +250,10 @@ blive_errno_t select_engine_fd_add_forever(select_engine_t* engine, fd_t fd, sel
         goto _out;
     }
     blive_logd("select engine add a fd=%d", fd);
-    retval = __engine_fd_add(engine, fd, callback, context, False);
-    __engine_reload(engine);    /* 通知engine重新进行select */
+    retval = __engine_cmd_submit(engine, &(engine_cmd_t){
+        .type = ENGINE_CMD_FD_ADD, .fd = fd,
+        .watch = {.cb = callback, .interest = SELECT_EVENT_READ, .context = context},
+    });
 
 _out:
     return retval;
@@ -142,8 +267,10 @@ blive_errno_t select_engine_fd_add_once(select_engine_t* engine, fd_t fd, select
         retval = BLIVE_ERR_INVALID;
         goto _out;
     }
-    retval = __engine_fd_add(engine, fd, callback, context, True);
-    __engine_reload(engine);    /* 通知engine重新进行select */
+    retval = __engine_cmd_submit(engine, &(engine_cmd_t){
+        .type = ENGINE_CMD_FD_ADD, .fd = fd,
+        .watch = {.cb = callback, .interest = SELECT_EVENT_READ, .temporary = True, .context = context},
+    });
 
 _out:
     return retval;
@@ -158,14 +285,61 @@ blive_errno_t select_engine_fd_del(select_engine_t* engine, fd_t fd)
         goto _out;
     }
 
-    __engine_fd_del(engine, fd);
-    __engine_reload(engine);    /* 通知engine重新进行select */
+    retval = __engine_cmd_submit(engine, &(engine_cmd_t){.type = ENGINE_CMD_FD_DEL, .fd = fd});
 
 _out:
     return retval;
 }
 
-blive_errno_t select_engine_schedule_add(select_engine_t* engine, select_schedule_cb callback, void* context, int64_t timeous)
+blive_errno_t select_engine_fd_watch(select_engine_t* engine, fd_t fd, uint32_t events, select_io_cb callback, void* context)
+{
+    if (engine == NULL || callback == NULL || fd < 0 || (events & ~SELECT_EVENT_MASK)) {
+        return BLIVE_ERR_INVALID;
+    }
+
+    return __engine_cmd_submit(engine, &(engine_cmd_t){
+        .type = ENGINE_CMD_FD_ADD, .fd = fd,
+        .watch = {.io_cb = callback, .interest = events, .context = context},
+    });
+}
+
+blive_errno_t select_engine_fd_modify(select_engine_t* engine, fd_t fd, uint32_t events)
+{
+    if (engine == NULL || fd < 0 || (events & ~SELECT_EVENT_MASK)) {
+        return BLIVE_ERR_INVALID;
+    }
+
+    return __engine_cmd_submit(engine, &(engine_cmd_t){
+        .type = ENGINE_CMD_FD_MOD, .fd = fd,
+        .watch = {.interest = events},
+    });
+}
+
+blive_errno_t select_engine_post(select_engine_t* engine, select_schedule_cb callback, void* context)
+{
+    engine_cmd_t*   cmd = NULL;
+
+    if (engine == NULL || callback == NULL) {
+        return BLIVE_ERR_INVALID;
+    }
+
+    cmd = zero_alloc(sizeof(engine_cmd_t));
+    if (cmd == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    cmd->type = ENGINE_CMD_TASK;
+    cmd->task = callback;
+    cmd->task_context = context;
+    cmd->seq = __atomic_add_fetch(&engine->cmd_seq, 1, __ATOMIC_ACQ_REL);
+
+    /* 即使在引擎线程中也放入队列，在下一轮循环开始时执行，不会在调用者的栈上重入 */
+    mpsc_queue_push(&engine->cmd_queue, &cmd->node);
+    __engine_wakeup(engine);
+
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t select_engine_schedule_add(select_engine_t* engine, select_schedule_cb callback, void* context, int64_t timeous, select_timer_t* handle)
 {
     int      retval = BLIVE_ERR_OK;
     engine_event_t  *event = NULL;
@@ -175,105 +349,279 @@ blive_errno_t select_engine_schedule_add(select_engine_t* engine, select_schedul
         goto _out;
     }
 
-    event = zero_alloc(sizeof(engine_event_t));
+    pthread_mutex_lock(&engine->timer_lock);
+    event = __engine_event_alloc(engine);
+    if (event == NULL) {
+        pthread_mutex_unlock(&engine->timer_lock);
+        retval = BLIVE_ERR_OUTOFMEM;
+        goto _out;
+    }
     event->cb = callback;
     event->context = context;
-    gettimeofday(&event->time, NULL);
-    blive_logd("current time:  %lds:%ldus", event->time.tv_sec, event->time.tv_usec);
-
-    event->time.tv_sec += timeous / (1000 * 1000);
-    event->time.tv_usec += timeous % (1000 * 1000);
-    if (event->time.tv_usec < 0) {
-        event->time.tv_usec += 1000 * 1000;
-        event->time.tv_sec -= 1;
-    }
-    if (event->time.tv_sec < 0) {
-        event->time.tv_sec = 0;
-        event->time.tv_usec = 0;
+    if (handle != NULL) {
+        *handle = SELECT_TIMER_HANDLE(event);
     }
 
-    blive_logd("set timeout event %lds:%ldus", event->time.tv_sec, event->time.tv_usec);;
-    pri_queue_push(engine->event_queue, event);
-    __engine_reload(engine);    /* 通知engine重新进行select */
+    /* 调用后会释放timer_lock */
+    __engine_event_arm(engine, event, timeous);
 
 _out:
     return retval;
 }
 
-blive_errno_t select_engine_perform(select_engine_t* engine)
+blive_errno_t select_engine_schedule_cancel(select_engine_t* engine, select_timer_t handle)
 {
-    struct timeval  tm_wait;
-    struct timeval* select_tm = NULL;
+    blive_errno_t   retval = BLIVE_ERR_OK;
     engine_event_t* event = NULL;
+
+    if (engine == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    pthread_mutex_lock(&engine->timer_lock);
+    event = __engine_event_lookup(engine, handle);
+    if (event == NULL) {
+        retval = BLIVE_ERR_NOTEXSIT;
+    } else if (event->state == EVENT_STATE_RUNNING) {
+        /* 回调正在执行，执行结束后自然回收 */
+        retval = BLIVE_ERR_NOTEXSIT;
+    } else {
+        if (event->state == EVENT_STATE_PENDING) {
+            timer_wheel_del(&engine->timers, &event->node);
+        } else {
+            LIST_SUBTRACT(&event->node.link);
+        }
+        __engine_event_recycle(engine, event);
+    }
+    pthread_mutex_unlock(&engine->timer_lock);
+
+    return retval;
+}
+
+blive_errno_t select_engine_schedule_reschedule(select_engine_t* engine, select_timer_t handle, int64_t timeous)
+{
+    engine_event_t* event = NULL;
+
+    if (engine == NULL || timeous < 0) {
+        return BLIVE_ERR_INVALID;
+    }
+
+    pthread_mutex_lock(&engine->timer_lock);
+    event = __engine_event_lookup(engine, handle);
+    if (event == NULL) {
+        pthread_mutex_unlock(&engine->timer_lock);
+        return BLIVE_ERR_NOTEXSIT;
+    }
+
+    /* 已经到期等待执行的，先从到期链表中摘下；正在执行回调的，执行结束后不再回收 */
+    if (event->state == EVENT_STATE_EXPIRED) {
+        LIST_SUBTRACT(&event->node.link);
+        timer_wheel_node_init(&event->node);
+    }
+
+    /* 调用后会释放timer_lock */
+    __engine_event_arm(engine, event, timeous);
+
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t select_engine_set_timer_budget(select_engine_t* engine, uint32_t budget)
+{
+    if (engine == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    engine->timer_budget = budget;
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t select_engine_set_timer_slack(select_engine_t* engine, int64_t slack_us)
+{
+    if (engine == NULL || slack_us < 0) {
+        return BLIVE_ERR_INVALID;
+    }
+
+    pthread_mutex_lock(&engine->timer_lock);
+    engine->timer_slack = (uint64_t)slack_us * NS_PER_US / NS_PER_TICK;
+    pthread_mutex_unlock(&engine->timer_lock);
+    return BLIVE_ERR_OK;
+}
+
+uint64_t select_engine_now(select_engine_t* engine)
+{
+    if (engine == NULL) {
+        return 0;
+    }
+    return __engine_now_ns(engine);
+}
+
+blive_errno_t select_engine_stats_enable(select_engine_t* engine, Bool enable)
+{
+    engine_stats_t*     stats = NULL;
+    engine_stats_t*     expected = NULL;
+
+    if (engine == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    if (enable && __atomic_load_n(&engine->stats, __ATOMIC_ACQUIRE) == NULL) {
+        stats = zero_alloc(sizeof(engine_stats_t));
+        if (stats == NULL) {
+            return BLIVE_ERR_OUTOFMEM;
+        }
+        /* 多个线程同时开启时，只保留先发布的那一份 */
+        if (!__atomic_compare_exchange_n(&engine->stats, &expected, stats, False, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            free(stats);
+        }
+    }
+    __atomic_store_n(&engine->stats_enabled, enable, __ATOMIC_RELEASE);
+
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t select_engine_stats_reset(select_engine_t* engine)
+{
+    engine_stats_t*     stats = NULL;
+
+    if (engine == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    /* 只清空计数，已经登记的回调保留，不影响引擎线程同时写入 */
+    stats = __atomic_load_n(&engine->stats, __ATOMIC_ACQUIRE);
+    if (stats != NULL) {
+        histogram_reset(&stats->loop_time);
+        histogram_reset(&stats->timer_lateness);
+        histogram_reset(&stats->ready_fds);
+        for (uint32_t i = 0; i <= STATS_SITE_MAX; i++) {
+            histogram_reset(&stats->callbacks[i].exec_time);
+        }
+    }
+
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t select_engine_stats_get(select_engine_t* engine, select_engine_stats_t* result)
+{
+    engine_stats_t*     stats = NULL;
+
+    if (engine == NULL || result == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    memset(result, 0, sizeof(select_engine_stats_t));
+    stats = __atomic_load_n(&engine->stats, __ATOMIC_ACQUIRE);
+    if (stats == NULL) {
+        return BLIVE_ERR_NOTEXSIT;
+    }
+
+    __engine_stats_summary(&stats->loop_time, &result->loop_time);
+    __engine_stats_summary(&stats->timer_lateness, &result->timer_lateness);
+    __engine_stats_summary(&stats->ready_fds, &result->ready_fds);
+
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t select_engine_stats_callbacks(select_engine_t* engine, select_callback_stats_t* result, uint32_t max_num, uint32_t* num)
+{
+    engine_stats_t*     stats = NULL;
+    const void*         site = NULL;
+    uint32_t            count = 0;
+
+    if (engine == NULL || num == NULL || (result == NULL && max_num)) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    *num = 0;
+    stats = __atomic_load_n(&engine->stats, __ATOMIC_ACQUIRE);
+    if (stats == NULL) {
+        return BLIVE_ERR_NOTEXSIT;
+    }
+
+    for (uint32_t i = 0; i <= STATS_SITE_MAX && count < max_num; i++) {
+        site = __atomic_load_n(&stats->callbacks[i].site, __ATOMIC_ACQUIRE);
+        if (site == NULL && !histogram_count(&stats->callbacks[i].exec_time)) {
+            continue;
+        }
+        result[count].site = site;
+        __engine_stats_summary(&stats->callbacks[i].exec_time, &result[count].exec_time);
+        count++;
+    }
+    *num = count;
+
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t select_engine_perform(select_engine_t* engine)
+{
+    int64_t         timeout_us = -1;
+    int64_t         next_expire = 0;
     int             retval = BLIVE_ERR_OK;
-    int32_t         select_ret = 0;
+    int32_t         ready_num = 0;
 
     if (engine == NULL) {
         retval = BLIVE_ERR_INVALID;
         goto _out;
     }
 
-    while (engine->need_continue) {
-        /*
-            上锁的目的只是为了标志此时select引擎正在运行。此时任何调整select引擎的动作都
-            必须进行引擎的reload，以保证该调整会立即生效
-         */
-        pthread_mutex_lock(&engine->running_flag);
-
-        /* 初始化需要监听的文件描述符 */
-        FD_ZERO(&engine->read_fds);
-        hash_foreach(engine->fd_poll, __fd_set_foreach, engine);
+    engine->loop_thread = pthread_self();
+    __atomic_store_n(&engine->in_loop, True, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&engine->need_continue, __ATOMIC_ACQUIRE)) {
+        /* 先执行其他线程提交的命令 */
+        __engine_cmd_drain(engine);
 
         /* 获取等待的时间 */
-        retval = pri_queue_peek(engine->event_queue, (void**)&event);
-        if (retval == BLIVE_ERR_RESOURCE) {   /* 说明此时没有事件需要处理 */
-            select_tm = NULL;
+        engine->now = __engine_clock_ns();
+        pthread_mutex_lock(&engine->timer_lock);
+        next_expire = timer_wheel_next_expire(&engine->timers);
+        if (engine->expired.next != &engine->expired || engine->cmd_deferred != NULL) {
+            timeout_us = 0;                 /* 上一轮超出预算未执行完的定时器或命令，只检查fd不等待 */
+            engine->wait_until = 0;
+        } else if (next_expire < 0) {       /* 说明此时没有事件需要处理 */
+            timeout_us = -1;
+            engine->wait_until = UINT64_MAX;
             blive_logd("no need to wait.");
-        } else if (retval != BLIVE_ERR_OK) {
-            retval = BLIVE_ERR_UNKNOWN;       /* 出错了 */
-            blive_logd("error occured!");
-            goto _out;
         } else {                            /* 说明此时有事件需要处理 */
-            gettimeofday(&tm_wait, NULL);
-            blive_logd("current time:  %lds:%ldus", tm_wait.tv_sec, tm_wait.tv_usec);
-            blive_logd("event time:  %lds:%ldus", event->time.tv_sec, event->time.tv_usec);
-            tm_wait.tv_sec = event->time.tv_sec - tm_wait.tv_sec;
-            tm_wait.tv_usec = event->time.tv_usec - tm_wait.tv_usec;
-            if (tm_wait.tv_usec < 0) {
-                tm_wait.tv_usec += 1000 * 1000;
-                tm_wait.tv_sec -= 1;
-            }
-            if (tm_wait.tv_sec < 0) {
-                tm_wait.tv_sec = 0;
-                tm_wait.tv_usec = 0;
-            }
-            blive_logd("waiting for timeout...%lds:%ldus", tm_wait.tv_sec, tm_wait.tv_usec);
-            select_tm = &tm_wait;
+            timeout_us = (uint64_t)next_expire * NS_PER_TICK > engine->now ?
+                ((uint64_t)next_expire * NS_PER_TICK - engine->now + NS_PER_US - 1) / NS_PER_US : 0;
+            engine->wait_until = next_expire;
+            blive_logd("waiting for timeout...%ldus", (long)timeout_us);
+        }
+        pthread_mutex_unlock(&engine->timer_lock);
+
+        /* 其他线程提交命令或添加更早的定时器时，会通过wake_fd唤醒 */
+        ready_num = engine->backend->wait(engine->backend_ctx, timeout_us, engine->ready, ENGINE_BACKEND_MAX_READY);
+        blive_logd("%s ready_num=%d", engine->backend->name, ready_num);
+
+        /* 等待结束后刷新一次时钟，本轮的回调和新添加的定时器都以此为准 */
+        engine->now = __engine_clock_ns();
+        pthread_mutex_lock(&engine->timer_lock);
+        engine->wait_until = 0;
+        pthread_mutex_unlock(&engine->timer_lock);
+        if (ready_num >= 0 && __atomic_load_n(&engine->stats_enabled, __ATOMIC_ACQUIRE)) {
+            histogram_record(&engine->stats->ready_fds, (uint64_t)ready_num);
         }
 
-        select_ret = select(engine->max_fd + 1, &engine->read_fds, NULL, NULL, select_tm);
-        blive_logd("select_ret=%d", select_ret);
-
-        /* 解锁，此后将会执行回调函数。此时调整select引擎，则不需要进行reload */
-        pthread_mutex_unlock(&engine->running_flag);
-
-        /* 定时器事件处理 */
-        if (!select_ret) {  
-            event->cb(event->context);
-            retval = pri_queue_pop_trywait(engine->event_queue, (void**)&event);
-            if (retval != BLIVE_ERR_OK) {
-                break;
-            }
         /* fd可读 */
-        } else if (select_ret > 0) {
-            hash_foreach(engine->fd_poll, __fd_isset_foreach, engine);
+        if (ready_num > 0) {
+            for (int32_t i = 0; i < ready_num; i++) {
+                __engine_fd_dispatch(engine, engine->ready[i].fd, engine->ready[i].events);
+            }
         /* 被中断程序打断 */
-        } else {
+        } else if (ready_num < 0) {
             blive_logd("select has been interrupted by system call.(%s)", strerror(errno));
         }
+
+        /* 定时器事件处理，无论本轮是否有fd就绪，都执行所有已经到期的定时器 */
+        __engine_timer_expire(engine);
+
+        if (__atomic_load_n(&engine->stats_enabled, __ATOMIC_ACQUIRE)) {
+            histogram_record(&engine->stats->loop_time, __engine_clock_ns() - engine->now);
+        }
     }
 
-    engine->need_continue = True;
+    __atomic_store_n(&engine->in_loop, False, __ATOMIC_RELEASE);
+    __atomic_store_n(&engine->need_continue, True, __ATOMIC_RELEASE);
 _out:
     return retval;
 }
@@ -281,14 +629,14 @@ _out:
 blive_errno_t select_engine_stop(select_engine_t* engine)
 {
     int              retval = BLIVE_ERR_OK;
-    engine_manage_event_t   event = ENGINE_EVENT_STOP;
 
     if (engine == NULL) {
         retval = BLIVE_ERR_NULLPTR;
         goto _out;
     }
 
-    fd_write(WR_FD(engine->manage_pipe), &event, sizeof(engine_manage_event_t));
+    __atomic_store_n(&engine->need_continue, False, __ATOMIC_RELEASE);
+    __engine_wakeup(engine);
 
 _out:
     return retval;
@@ -303,7 +651,8 @@ blive_errno_t select_engine_destroy(select_engine_t* engine)
         goto _out;
     }
 
-    if (engine->need_continue) {
+    /* 引擎仍在运行时不能销毁。perform退出时会重置need_continue，不能用它判断 */
+    if (__atomic_load_n(&engine->in_loop, __ATOMIC_ACQUIRE)) {
         retval = BLIVE_ERR_INVALID;
         goto _out;
     }
@@ -317,100 +666,579 @@ _out:
 
 
 
-static void __engine_reload(select_engine_t* engine)
+static inline Bool __engine_in_loop(select_engine_t* engine)
 {
-    engine_manage_event_t   mgt_event = ENGINE_EVENT_RESTART;
+    return __atomic_load_n(&engine->in_loop, __ATOMIC_ACQUIRE) && pthread_equal(engine->loop_thread, pthread_self());
+}
 
-    if (!pthread_mutex_trylock(&engine->running_flag)) {
-        /* 如果能拿到锁，这说明此时程序不在运行，解锁 */
-        pthread_mutex_unlock(&engine->running_flag);
-    } else {
-        /* 如果拿不到锁，这说明此时程序正在运行，通知engine重新进行select */
-        fd_write(WR_FD(engine->manage_pipe), &mgt_event, sizeof(engine_manage_event_t));
+/**
+ * @brief 创建唤醒引擎用的fd，Linux下使用eventfd，其他平台使用socketpair
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @return blive_errno_t 
+ */
+static blive_errno_t __engine_wake_init(select_engine_t* engine)
+{
+#ifdef __linux__
+    int     event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (event_fd < 0) {
+        blive_loge("eventfd failed(%s)", strerror(errno));
+        return BLIVE_ERR_RESOURCE;
+    }
+    RD_FD(engine->wake_fd) = event_fd;
+    WR_FD(engine->wake_fd) = event_fd;
+#else
+    if (_socketpair(engine->wake_fd)) {
+        return BLIVE_ERR_RESOURCE;
     }
+#endif
+    return BLIVE_ERR_OK;
+}
 
-    return ;
+static void __engine_wake_close(select_engine_t* engine)
+{
+#ifdef WIN32
+    closesocket(RD_FD(engine->wake_fd));
+    closesocket(WR_FD(engine->wake_fd));
+#else
+    close(RD_FD(engine->wake_fd));
+    if (WR_FD(engine->wake_fd) != RD_FD(engine->wake_fd)) {
+        close(WR_FD(engine->wake_fd));
+    }
+#endif
 }
 
-static blive_errno_t __engine_fd_add(select_engine_t* engine, fd_t fd, select_fd_cb callback, void* context, Bool temporary)
+/**
+ * @brief 唤醒引擎线程。引擎响应之前的多次唤醒只会写一次fd
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ */
+static void __engine_wakeup(select_engine_t* engine)
 {
-    blive_errno_t         retval = BLIVE_ERR_OK;
-    char            buffer[32] = {0};
-    engine_fd_t*    engine_fd = NULL;
+    if (__atomic_exchange_n(&engine->wake_pending, 1, __ATOMIC_ACQ_REL)) {
+        return ;
+    }
 
-    engine_fd = zero_alloc(sizeof(engine_fd_t));
-    if (engine_fd == NULL) {
-        retval = BLIVE_ERR_OUTOFMEM;
-        goto _out;
+#ifdef __linux__
+    uint64_t    value = 1;
+
+    if (write(WR_FD(engine->wake_fd), &value, sizeof(value)) < 0) {
+        blive_loge("wake engine failed(%s)", strerror(errno));
     }
+#else
+    char        value = 0;
+
+    fd_write(WR_FD(engine->wake_fd), &value, sizeof(value));
+#endif
+}
+
+static void __engine_wake_callback(fd_t wake_fd, void* context)
+{
+    select_engine_t*    engine = (select_engine_t*)context;
 
-    engine_fd->fd = fd;
-    engine_fd->cb = callback;
-    engine_fd->temporary = temporary;
-    engine_fd->context = context;
+#ifdef __linux__
+    uint64_t    value = 0;
 
-#ifdef WIN32 
-    snprintf(buffer, 31, "%I64d", fd);
+    if (read(wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        blive_loge("read wake fd failed(%s)", strerror(errno));
+    }
 #else
-    snprintf(buffer, 31, "%d", fd);
+    char        buffer[64];
+
+    while (fd_readable(wake_fd)) {
+        fd_read(wake_fd, buffer, sizeof(buffer));
+    }
 #endif
-    hash_push(engine->fd_poll, buffer, engine_fd);
+
+    /* 必须先清除标志再执行命令，否则清除前入队的命令可能既不被执行也不再唤醒 */
+    __atomic_store_n(&engine->wake_pending, 0, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief 提交fd相关的命令。在引擎线程中直接执行，其他线程中复制一份放入命令队列并唤醒引擎
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] request 命令
+ * @return blive_errno_t 放入队列的命令总是返回BLIVE_ERR_OK，执行的结果只记录日志
+ */
+static blive_errno_t __engine_cmd_submit(select_engine_t* engine, const engine_cmd_t* request)
+{
+    engine_cmd_t*   cmd = NULL;
+
+    if (__engine_in_loop(engine)) {
+        return __engine_cmd_apply(engine, request);
+    }
+
+    cmd = zero_alloc(sizeof(engine_cmd_t));
+    if (cmd == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    memcpy(cmd, request, sizeof(engine_cmd_t));
+    cmd->seq = __atomic_add_fetch(&engine->cmd_seq, 1, __ATOMIC_ACQ_REL);
+
+    mpsc_queue_push(&engine->cmd_queue, &cmd->node);
+    __engine_wakeup(engine);
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 执行一条命令，只能在引擎线程中调用
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] cmd 命令
+ * @return blive_errno_t 
+ */
+static blive_errno_t __engine_cmd_apply(select_engine_t* engine, const engine_cmd_t* cmd)
+{
+    switch (cmd->type) {
+        case ENGINE_CMD_FD_ADD:
+            return __engine_fd_add(engine, cmd->fd, &cmd->watch);
+        case ENGINE_CMD_FD_MOD:
+            return __engine_fd_mod(engine, cmd->fd, cmd->watch.interest);
+        case ENGINE_CMD_FD_DEL:
+            return __engine_fd_del(engine, cmd->fd);
+        case ENGINE_CMD_TASK:
+        default: {
+            uint64_t    begin = __engine_stats_begin(engine);
+
+            cmd->task(cmd->task_context);
+            __engine_stats_callback(engine, (const void*)cmd->task, begin);
+            return BLIVE_ERR_OK;
+        }
+    }
+}
+
+/**
+ * @brief 按提交的顺序执行命令队列中所有的命令，只能在引擎线程中调用
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ */
+static void __engine_cmd_drain(select_engine_t* engine)
+{
+    mpsc_node_t*    node = NULL;
+    engine_cmd_t*   cmd = engine->cmd_deferred;
+    uint64_t        last = 0;
+    blive_errno_t   retval = BLIVE_ERR_OK;
+
+    /* 只执行开始时已经分配序号的命令，任务中再投递的任务留到下一轮，避免饿死fd。
+     * 不能以队列的head判断，出队最后一个节点时哨兵节点会重新入队，head可能暂时指向哨兵 */
+    last = __atomic_load_n(&engine->cmd_seq, __ATOMIC_ACQUIRE);
+    engine->cmd_deferred = NULL;
+    while (cmd != NULL || (node = mpsc_queue_pop(&engine->cmd_queue)) != NULL) {
+        if (cmd == NULL) {
+            cmd = container_of(node, engine_cmd_t, node);
+        }
+        if (cmd->seq > last) {
+            engine->cmd_deferred = cmd;
+            break;
+        }
+        retval = __engine_cmd_apply(engine, cmd);
+        if (retval != BLIVE_ERR_OK && retval != BLIVE_ERR_NOTEXSIT) {
+            blive_loge("select engine command %d on fd=%d failed(%d)", cmd->type, cmd->fd, retval);
+        }
+        free(cmd);
+        cmd = NULL;
+    }
+}
+
+/**
+ * @brief 扩容fd槽数组，使其能够容纳fd。只能在引擎线程中调用
+ *
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] fd 文件描述符
+ * @return blive_errno_t
+ */
+static blive_errno_t __engine_fd_reserve(select_engine_t* engine, fd_t fd)
+{
+    int32_t         new_num = engine->fd_slot_num ? engine->fd_slot_num : FD_SLOT_MIN_NUM;
+    engine_fd_t*    new_slots = NULL;
+
+    if (fd < engine->fd_slot_num) {
+        return BLIVE_ERR_OK;
+    }
+
+    while (new_num <= fd) {
+        new_num *= 2;
+    }
+    new_slots = realloc(engine->fd_slots, new_num * sizeof(engine_fd_t));
+    if (new_slots == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    memset(new_slots + engine->fd_slot_num, 0, (new_num - engine->fd_slot_num) * sizeof(engine_fd_t));
+    for (int32_t i = engine->fd_slot_num; i < new_num; i++) {
+        new_slots[i].active_index = -1;
+    }
+    engine->fd_slots = new_slots;
+    engine->fd_slot_num = new_num;
+
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 将fd加入活跃列表。只能在引擎线程中调用
+ *
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] fd 文件描述符，对应的槽已存在且不在列表中
+ * @return blive_errno_t
+ */
+static blive_errno_t __engine_fd_activate(select_engine_t* engine, fd_t fd)
+{
+    if (engine->fd_active_num == engine->fd_active_max_num) {
+        int32_t     new_max = engine->fd_active_max_num ? engine->fd_active_max_num * 2 : FD_SLOT_MIN_NUM;
+        fd_t*       new_active = realloc(engine->fd_active, new_max * sizeof(fd_t));
+
+        if (new_active == NULL) {
+            return BLIVE_ERR_OUTOFMEM;
+        }
+        engine->fd_active = new_active;
+        engine->fd_active_max_num = new_max;
+    }
+
+    engine->fd_slots[fd].active_index = engine->fd_active_num;
+    engine->fd_active[engine->fd_active_num++] = fd;
+    return BLIVE_ERR_OK;
+}
+
+/**
+ * @brief 将fd从活跃列表中移除，用列表末尾的fd填补空位。只能在引擎线程中调用
+ *
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] fd 文件描述符，必须在列表中
+ */
+static void __engine_fd_deactivate(select_engine_t* engine, fd_t fd)
+{
+    int32_t     index = engine->fd_slots[fd].active_index;
+    fd_t        last = engine->fd_active[--engine->fd_active_num];
+
+    engine->fd_active[index] = last;
+    engine->fd_slots[last].active_index = index;
+    memset(&engine->fd_slots[fd], 0, sizeof(engine_fd_t));
+    engine->fd_slots[fd].active_index = -1;
+}
+
+static blive_errno_t __engine_fd_add(select_engine_t* engine, fd_t fd, const engine_fd_t* watch)
+{
+    blive_errno_t   retval = BLIVE_ERR_OK;
+    engine_fd_t*    engine_fd = NULL;
+
+    retval = __engine_fd_reserve(engine, fd);
+    if (retval != BLIVE_ERR_OK) {
+        goto _out;
+    }
+
+    /* 重复添加时直接替换掉原先的监视，监视的事件不同时通知后端修改 */
+    engine_fd = &engine->fd_slots[fd];
+    if (engine_fd->active_index >= 0) {
+        if (engine_fd->interest != watch->interest) {
+            retval = engine->backend->fd_mod(engine->backend_ctx, fd, watch->interest);
+            if (retval != BLIVE_ERR_OK) {
+                goto _out;
+            }
+        }
+    } else {
+        retval = engine->backend->fd_add(engine->backend_ctx, fd, watch->interest);
+        if (retval != BLIVE_ERR_OK) {
+            goto _out;
+        }
+        retval = __engine_fd_activate(engine, fd);
+        if (retval != BLIVE_ERR_OK) {
+            engine->backend->fd_del(engine->backend_ctx, fd);
+            goto _out;
+        }
+    }
+    engine_fd->cb = watch->cb;
+    engine_fd->io_cb = watch->io_cb;
+    engine_fd->interest = watch->interest;
+    engine_fd->temporary = watch->temporary;
+    engine_fd->context = watch->context;
 
 _out:
     return retval;
 }
 
-blive_errno_t __engine_fd_del(select_engine_t* engine, fd_t fd)
+static blive_errno_t __engine_fd_mod(select_engine_t* engine, fd_t fd, uint32_t interest)
 {
-    blive_errno_t                 retval = BLIVE_ERR_OK;
-    char                    buffer[32] = {0};
+    engine_fd_t*    engine_fd = NULL;
+    blive_errno_t   retval = BLIVE_ERR_OK;
 
-#ifdef WIN32 
-    snprintf(buffer, 31, "%I64d", fd);
-#else
-    snprintf(buffer, 31, "%d", fd); 
-#endif
+    if (fd >= engine->fd_slot_num || engine->fd_slots[fd].active_index < 0) {
+        return BLIVE_ERR_NOTEXSIT;
+    }
+
+    engine_fd = &engine->fd_slots[fd];
+    if (engine_fd->interest == interest) {
+        return BLIVE_ERR_OK;
+    }
+    retval = engine->backend->fd_mod(engine->backend_ctx, fd, interest);
+    if (retval == BLIVE_ERR_OK) {
+        engine_fd->interest = interest;
+    }
+
+    return retval;
+}
 
-    if (hash_pop(engine->fd_poll, buffer) == NULL) {
+static blive_errno_t __engine_fd_del(select_engine_t* engine, fd_t fd)
+{
+    blive_errno_t   retval = BLIVE_ERR_OK;
+
+    if (fd >= engine->fd_slot_num || engine->fd_slots[fd].active_index < 0) {
         retval = BLIVE_ERR_NOTEXSIT;
+    } else {
+        engine->backend->fd_del(engine->backend_ctx, fd);
+        __engine_fd_deactivate(engine, fd);
     }
 
     return retval;
 }
 
+/**
+ * @brief 按照优先级依次尝试创建后端：io_uring、epoll、select
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] backend 指定的后端，SELECT_BACKEND_AUTO表示自动选择
+ * @return blive_errno_t 
+ */
+static blive_errno_t __engine_backend_init(select_engine_t* engine, select_backend_t backend)
+{
+    static const struct {
+        select_backend_t            type;
+        const engine_backend_ops*   ops;
+    } backend_list[] = {
+#ifdef ENGINE_HAVE_URING
+        {SELECT_BACKEND_URING,  &engine_backend_uring},
+#endif
+#ifdef ENGINE_HAVE_EPOLL
+        {SELECT_BACKEND_EPOLL,  &engine_backend_epoll},
+#endif
+        {SELECT_BACKEND_SELECT, &engine_backend_select},
+    };
+
+    for (int i = 0; i < sizeof(backend_list) / sizeof(backend_list[0]); i++) {
+        if (backend != SELECT_BACKEND_AUTO && backend != backend_list[i].type) {
+            continue;
+        }
+        if (backend_list[i].ops->create(&engine->backend_ctx) == BLIVE_ERR_OK) {
+            engine->backend = backend_list[i].ops;
+            blive_logi("select engine using %s backend", engine->backend->name);
+            return BLIVE_ERR_OK;
+        }
+    }
+
+    return backend == SELECT_BACKEND_AUTO ? BLIVE_ERR_UNKNOWN : BLIVE_ERR_INVALID;
+}
+
 static inline void __engine_destroy(select_engine_t* engine)
 {
     if (engine != NULL) {
-        if (engine->event_queue != NULL) {
-            pri_queue_destroy(engine->event_queue);
-            engine->event_queue = NULL;
+        /* 所有的定时器事件都记录在事件表中，无论处于什么状态 */
+        for (uint32_t i = 0; i < engine->event_num; i++) {
+            free(engine->event_table[i]);
         }
-        if (engine->fd_poll != NULL) {
-            hash_destroy(engine->fd_poll);
+        free(engine->event_table);
+        pthread_mutex_destroy(&engine->timer_lock);
+        free(engine->fd_slots);
+        free(engine->fd_active);
+        free(engine->stats);
+        free(engine->cmd_deferred);
+        for (mpsc_node_t* node; (node = mpsc_queue_pop(&engine->cmd_queue)) != NULL; ) {
+            free(container_of(node, engine_cmd_t, node));
         }
-        pthread_mutex_destroy(&engine->running_flag);
+        if (engine->backend != NULL) {
+            engine->backend->destroy(engine->backend_ctx);
+        }
+        __engine_wake_close(engine);
         free(engine);
     }
 }
 
-static Bool __event_queue_pri_comp(void* event1, void* event2)
+/**
+ * @brief 读取单调时钟，不受系统时间调整的影响
+ * 
+ * @return uint64_t 纳秒ns
+ */
+static uint64_t __engine_clock_ns(void)
 {
-    int64_t    tmp_s = 0;
-    int64_t    tmp_us = 0;
+    struct timespec ts;
 
-    tmp_s = ((engine_event_t*)event1)->time.tv_sec - ((engine_event_t*)event2)->time.tv_sec;
-    tmp_us = ((engine_event_t*)event1)->time.tv_usec - ((engine_event_t*)event2)->time.tv_usec;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
 
-    if ((tmp_s < 0) || (!tmp_s && tmp_us <= 0)) {
-        return True;
-    } else {
-        return False;
+/**
+ * @brief 获取引擎的当前时间。引擎线程中直接使用本轮缓存的时钟，避免每个定时器都读取
+ *        一次时钟；其他线程中读取实际的时钟
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @return uint64_t 纳秒ns
+ */
+static uint64_t __engine_now_ns(select_engine_t* engine)
+{
+    if (__engine_in_loop(engine)) {
+        return engine->now;
+    }
+    return __engine_clock_ns();
+}
+
+/**
+ * @brief 申请一个定时器事件，优先使用空闲池中的。需持有timer_lock
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @return engine_event_t* 
+ */
+static engine_event_t* __engine_event_alloc(select_engine_t* engine)
+{
+    engine_event_t*     event = NULL;
+
+    if (engine->event_pool.next != &engine->event_pool) {
+        event = list_entry(engine->event_pool.next, engine_event_t, node.link);
+        LIST_SUBTRACT(&event->node.link);
+        timer_wheel_node_init(&event->node);
+        return event;
+    }
+
+    if (engine->event_num == engine->event_max_num) {
+        uint32_t            new_max = engine->event_max_num ? engine->event_max_num * 2 : 64;
+        engine_event_t**    new_table = realloc(engine->event_table, new_max * sizeof(engine_event_t*));
+
+        if (new_table == NULL) {
+            return NULL;
+        }
+        engine->event_table = new_table;
+        engine->event_max_num = new_max;
+    }
+
+    event = zero_alloc(sizeof(engine_event_t));
+    if (event == NULL) {
+        return NULL;
+    }
+    timer_wheel_node_init(&event->node);
+    event->id = engine->event_num;
+    event->gen = 1;
+    engine->event_table[engine->event_num++] = event;
+
+    return event;
+}
+
+/**
+ * @brief 通过句柄查找尚未回收的定时器事件。需持有timer_lock
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] handle 定时器句柄
+ * @return engine_event_t* 句柄已失效时返回NULL
+ */
+static engine_event_t* __engine_event_lookup(select_engine_t* engine, select_timer_t handle)
+{
+    uint32_t            id = (uint32_t)handle - 1;
+    engine_event_t*     event = NULL;
+
+    if (handle == SELECT_TIMER_INVALID || id >= engine->event_num) {
+        return NULL;
+    }
+
+    event = engine->event_table[id];
+    if (event->gen != (uint32_t)(handle >> 32) || event->state == EVENT_STATE_IDLE) {
+        return NULL;
+    }
+    return event;
+}
+
+/**
+ * @brief 回收定时器事件，使其所有的句柄失效。需持有timer_lock
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] event 不在任何链表中的定时器事件
+ */
+static void __engine_event_recycle(select_engine_t* engine, engine_event_t* event)
+{
+    event->gen = (event->gen + 1) ? (event->gen + 1) : 1;
+    event->state = EVENT_STATE_IDLE;
+    event->cb = NULL;
+    event->context = NULL;
+    LIST_APPEND_AHEAD(&engine->event_pool, &event->node.link);
+}
+
+/**
+ * @brief 将定时器事件放入时间轮，必要时唤醒引擎。需持有timer_lock，返回时释放
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] event 定时器事件
+ * @param [in] timeous 定时器时长，单位微秒us
+ */
+static void __engine_event_arm(select_engine_t* engine, engine_event_t* event, int64_t timeous)
+{
+    uint64_t        expire = 0;
+    Bool            need_wakeup = False;
+
+    /* 到期时间向上取整到刻度，保证定时器不会提前触发 */
+    event->deadline = __engine_now_ns(engine) + (uint64_t)timeous * NS_PER_US;
+    expire = (event->deadline + NS_PER_TICK - 1) / NS_PER_TICK;
+
+    /* 再向上对齐到slack的整数倍，相近的定时器落入同一个槽，一次唤醒一起执行 */
+    if (engine->timer_slack > 1) {
+        expire = (expire + engine->timer_slack - 1) / engine->timer_slack * engine->timer_slack;
+    }
+    timer_wheel_add(&engine->timers, &event->node, expire);
+    event->state = EVENT_STATE_PENDING;
+
+    /* 只有新的定时器早于引擎当前的等待时间，才需要唤醒引擎 */
+    need_wakeup = expire < engine->wait_until;
+    pthread_mutex_unlock(&engine->timer_lock);
+    blive_logd("set timeout event %lums", (unsigned long)expire);
+
+    if (need_wakeup) {
+        __engine_wakeup(engine);
     }
 }
 
-static uint32_t __fd_poll_hash_func(const char *key)
+/**
+ * @brief 取出时间轮中所有到期的定时器并执行回调，同一个槽中的定时器一起到期。
+ *        每轮最多执行timer_budget个，超出的留到下一轮，避免长时间不处理fd
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ */
+static void __engine_timer_expire(select_engine_t* engine)
 {
-    return (uint32_t)atoi(key);
+    engine_event_t*     event = NULL;
+    list*               list_first = NULL;
+    uint32_t            budget = engine->timer_budget;
+    uint64_t            begin = 0;
+
+    pthread_mutex_lock(&engine->timer_lock);
+    list_first = engine->expired.prev;
+    timer_wheel_advance(&engine->timers, engine->now / NS_PER_TICK, &engine->expired);
+    for (list* link = list_first->next; link != &engine->expired; link = link->next) {
+        list_entry(link, engine_event_t, node.link)->state = EVENT_STATE_EXPIRED;
+    }
+    pthread_mutex_unlock(&engine->timer_lock);
+
+    for (uint32_t count = 0; !budget || count < budget; count++) {
+        pthread_mutex_lock(&engine->timer_lock);
+        if (engine->expired.next == &engine->expired) {
+            pthread_mutex_unlock(&engine->timer_lock);
+            break;
+        }
+        event = list_entry(engine->expired.next, engine_event_t, node.link);
+        LIST_SUBTRACT(&event->node.link);
+        timer_wheel_node_init(&event->node);
+        event->state = EVENT_STATE_RUNNING;
+        pthread_mutex_unlock(&engine->timer_lock);
+
+        begin = __engine_stats_begin(engine);
+        if (begin) {
+            histogram_record(&engine->stats->timer_lateness, begin > event->deadline ? begin - event->deadline : 0);
+        }
+        event->cb(event->context);
+        __engine_stats_callback(engine, (const void*)event->cb, begin);
+
+        /* 回收事件，放回空闲池。如果回调中重新设置了该定时器，则不回收 */
+        pthread_mutex_lock(&engine->timer_lock);
+        if (event->state == EVENT_STATE_RUNNING) {
+            __engine_event_recycle(engine, event);
+        }
+        pthread_mutex_unlock(&engine->timer_lock);
+    }
 }
 
 int32_t fd_readable(fd_t fd)
@@ -426,72 +1254,99 @@ int32_t fd_readable(fd_t fd)
     return (int32_t)read_len;
 }
 
-static Bool __fd_set_foreach(const char *key, const void* value, void* context)
-{
-    Bool               retval = True;
-    select_engine_t*     engine = (select_engine_t*)context;
-    engine_fd_t*            engine_fd = (engine_fd_t*)value;
 
-    if (context == NULL || value == NULL) {
-        retval = False;
-        goto _out;
+static void __engine_fd_dispatch(select_engine_t* engine, fd_t fd, uint32_t events)
+{
+    engine_fd_t*    engine_fd = NULL;
+    select_fd_cb    callback = NULL;
+    select_io_cb    io_callback = NULL;
+    void*           context = NULL;
+    uint64_t        begin = 0;
+
+    /* 同一轮中前面的回调可能已经删除了该fd，或者修改了监视的事件 */
+    if (fd < 0 || fd >= engine->fd_slot_num || engine->fd_slots[fd].active_index < 0) {
+        return ;
+    }
+    engine_fd = &engine->fd_slots[fd];
+    events &= (engine_fd->interest | SELECT_EVENT_ERROR) & ~SELECT_EVENT_EDGE;
+    if (!events) {
+        return ;
     }
 
-#ifndef WIN32
-    engine->max_fd = max(engine->max_fd, engine_fd->fd);
-#endif
-    FD_SET(engine_fd->fd, &engine->read_fds);
+    callback = engine_fd->cb;
+    io_callback = engine_fd->io_cb;
+    context = engine_fd->context;
+    if (engine_fd->temporary) {             /* 如果fd是只执行一次的，则移除监视 */
+        engine->backend->fd_del(engine->backend_ctx, fd);
+        __engine_fd_deactivate(engine, fd);
+    }
 
-_out:
-    return retval;
+    begin = __engine_stats_begin(engine);
+    if (io_callback != NULL) {
+        io_callback(fd, events, context);
+        __engine_stats_callback(engine, (const void*)io_callback, begin);
+    } else {
+        callback(fd, context);              /* 只关心可读的回调，出错时也调用，由读取的结果判断 */
+        __engine_stats_callback(engine, (const void*)callback, begin);
+    }
 }
 
-static void __manage_fd_callback(fd_t manage_fd, void* context)
+/**
+ * @brief 开启统计时获取回调开始执行的时间，未开启时只有一次判断
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @return uint64_t 开始时间(ns)，未开启统计时返回0
+ */
+static inline uint64_t __engine_stats_begin(select_engine_t* engine)
 {
-    engine_manage_event_t       event;
-    select_engine_t*         engine = (select_engine_t*)context;
-
-    while (fd_readable(manage_fd)) {
-        fd_read(manage_fd, &event, sizeof(engine_manage_event_t));
-        blive_logd("process manage message %d", event);
-        switch (event) {
-            case ENGINE_EVENT_STOP:
-                engine->need_continue = False;
-                break;
-            case ENGINE_EVENT_RESTART:
-            default:
-                break;
-        }
+    if (!__atomic_load_n(&engine->stats_enabled, __ATOMIC_ACQUIRE)) {
+        return 0;
     }
-    return ;
+    return __engine_clock_ns();
 }
 
-static Bool __fd_isset_foreach(const char *key, const void* value, void* context)
+/**
+ * @brief 记录回调的执行耗时。按回调函数的地址登记，只有引擎线程会登记，
+ *        登记后才发布地址，读取的线程看到地址时直方图已经可用
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] site 回调函数的地址
+ * @param [in] begin __engine_stats_begin的返回值，为0时不记录
+ */
+static void __engine_stats_callback(select_engine_t* engine, const void* site, uint64_t begin)
 {
-    Bool               retval = True;
-    select_engine_t*     engine = (select_engine_t*)context;
-    engine_fd_t*            engine_fd = (engine_fd_t*)value;
+    engine_stats_t*     stats = engine->stats;
+    uint32_t            start = 0;
+    uint32_t            index = 0;
+    const void*         cur = NULL;
 
-    if (context == NULL || value == NULL) {
-        retval = False;
-        goto _out;
+    if (!begin) {
+        return ;
     }
 
-    if (FD_ISSET(engine_fd->fd, &engine->read_fds)) {
-        if (engine_fd->temporary) {             /* 如果fd是只执行一次的，则从哈希表中移除 */
-            char            buffer[32] = {0};
-
-#ifdef WIN32 
-            snprintf(buffer, 31, "%I64d", engine_fd->fd);
-#else
-            snprintf(buffer, 31, "%d", engine_fd->fd);
-#endif
-            hash_pop(engine->fd_poll, buffer);
+    start = (uint32_t)(((uintptr_t)site >> 4) * 2654435761U) % STATS_SITE_MAX;
+    for (uint32_t i = 0; i < STATS_SITE_MAX; i++) {
+        index = (start + i) % STATS_SITE_MAX;
+        cur = __atomic_load_n(&stats->callbacks[index].site, __ATOMIC_RELAXED);
+        if (cur == site) {
+            break;
         }
-
-        engine_fd->cb(engine_fd->fd, engine_fd->context);   /* 如果fd可读，则执行回调 */
+        if (cur == NULL) {
+            __atomic_store_n(&stats->callbacks[index].site, site, __ATOMIC_RELEASE);
+            break;
+        }
+        index = STATS_SITE_MAX;         /* 已满，合并到最后一个 */
     }
 
-_out:
-    return retval;
+    histogram_record(&stats->callbacks[index].exec_time, __engine_clock_ns() - begin);
+}
+
+static void __engine_stats_summary(const histogram_t* hist, select_stats_summary_t* summary)
+{
+    summary->count = histogram_count(hist);
+    summary->mean = histogram_mean(hist);
+    summary->p50 = histogram_percentile(hist, 50);
+    summary->p90 = histogram_percentile(hist, 90);
+    summary->p99 = histogram_percentile(hist, 99);
+    summary->max = histogram_max(hist);
 }
@@ -25,6 +25,68 @@
 
 typedef struct select_engine_t select_engine_t;
 
+/**
+ * @brief 定时器句柄，用于取消或重新设置定时器。定时器执行完毕或被取消后句柄即失效，
+ *        失效的句柄不会误操作到其他定时器
+ * 
+ */
+typedef uint64_t select_timer_t;
+
+#define SELECT_TIMER_INVALID    ((select_timer_t)0)
+
+/* fd监视的事件，注册时可以组合使用，回调时传入实际就绪的事件 */
+#define SELECT_EVENT_READ       (1U << 0)   /* 可读 */
+#define SELECT_EVENT_WRITE      (1U << 1)   /* 可写 */
+#define SELECT_EVENT_ERROR      (1U << 2)   /* 出错或对端挂断，无论是否注册都会上报。select后端只能在
+                                               监视了可读或可写时，通过读写的结果发现 */
+#define SELECT_EVENT_EDGE       (1U << 3)   /* 边缘触发，只用于注册。仅epoll后端原生支持，
+                                               其他后端退化为水平触发，因此回调中应当读写到EAGAIN为止，
+                                               没有数据要写时应当取消可写的监视 */
+#define SELECT_EVENT_MASK       (SELECT_EVENT_READ | SELECT_EVENT_WRITE | SELECT_EVENT_ERROR | SELECT_EVENT_EDGE)
+
+/**
+ * @brief 直方图的摘要，时间的单位均为纳秒ns
+ * 
+ */
+typedef struct {
+    uint64_t    count;      /* 记录的次数 */
+    uint64_t    mean;
+    uint64_t    p50;
+    uint64_t    p90;
+    uint64_t    p99;
+    uint64_t    max;
+} select_stats_summary_t;
+
+/**
+ * @brief 事件引擎的运行统计
+ * 
+ */
+typedef struct {
+    select_stats_summary_t  loop_time;      /* 每轮循环处理事件的耗时，不含等待 */
+    select_stats_summary_t  timer_lateness; /* 定时器实际执行时间减去设定的到期时间 */
+    select_stats_summary_t  ready_fds;      /* 每次唤醒就绪的fd数量，单位为个 */
+} select_engine_stats_t;
+
+/**
+ * @brief 单个回调函数的执行耗时统计
+ * 
+ */
+typedef struct {
+    const void*             site;           /* 回调函数的地址，NULL表示超出登记数量后合并统计的其他回调 */
+    select_stats_summary_t  exec_time;
+} select_callback_stats_t;
+
+/**
+ * @brief 事件引擎使用的IO多路复用后端
+ * 
+ */
+typedef enum {
+    SELECT_BACKEND_AUTO = 0,    /* 自动选择，依次尝试io_uring、epoll、select */
+    SELECT_BACKEND_URING,       /* io_uring，仅Linux 5.11及以上 */
+    SELECT_BACKEND_EPOLL,       /* epoll，仅Linux */
+    SELECT_BACKEND_SELECT,      /* select，所有平台 */
+} select_backend_t;
+
 /**
  * @brief 定时器事件的回调函数
  * 
@@ -39,6 +101,15 @@ typedef void (*select_schedule_cb)(void* context);
  */
 typedef void (*select_fd_cb)(fd_t fd, void* context);
 
+/**
+ * @brief 文件描述符读写监视的回调函数
+ * 
+ * @param [in] fd 文件描述符
+ * @param [in] events 就绪的事件，SELECT_EVENT_READ/WRITE/ERROR的组合
+ * @param [in] context 回调者的上下文
+ */
+typedef void (*select_io_cb)(fd_t fd, uint32_t events, void* context);
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -53,6 +124,23 @@ extern "C" {
  */
 int select_engine_create(select_engine_t **engine);
 
+/**
+ * @brief 使用指定的IO多路复用后端创建事件引擎
+ * 
+ * @param [out] engine 传出参数，select事件引擎描述结构体
+ * @param [in] backend 指定的后端，指定的后端不可用时返回BLIVE_ERR_INVALID
+ * @return int 
+ */
+int select_engine_create_with_backend(select_engine_t **engine, select_backend_t backend);
+
+/**
+ * @brief 获取事件引擎实际使用的后端名称
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @return const char* 后端名称，如"io_uring"、"epoll"、"select"
+ */
+const char* select_engine_backend_name(const select_engine_t* engine);
+
 /**
  * @brief 销毁select事件引擎
  * 
@@ -85,12 +173,114 @@ int select_engine_stop(select_engine_t* engine);
  * @param [in] callback 定时器到期后，触发的回调函数
  * @param [in] context 传递给回调函数的上下文
  * @param [in] timeous 定时器时长，单位微秒us
+ * @param [out] handle 传出参数，定时器句柄，不需要时可传入NULL
+ * @return int 
+ */
+int select_engine_schedule_add(select_engine_t* engine, select_schedule_cb callback, void* context, int64_t timeous, select_timer_t* handle);
+
+/**
+ * @brief 将一个任务投递到引擎线程中执行，任意线程均可调用。任务按投递的顺序在下一轮
+ *        循环开始时执行，在引擎线程中投递时也不会立即执行
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] callback 在引擎线程中执行的回调函数
+ * @param [in] context 传递给回调函数的上下文
+ * @return int 
+ */
+int select_engine_post(select_engine_t* engine, select_schedule_cb callback, void* context);
+
+/**
+ * @brief 取消一个尚未执行的定时器事件，O(1)
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] handle 定时器句柄
+ * @return int 定时器已执行、正在执行或已被取消时返回BLIVE_ERR_NOTEXSIT
+ */
+int select_engine_schedule_cancel(select_engine_t* engine, select_timer_t handle);
+
+/**
+ * @brief 重新设置定时器的时长，从调用时开始计算，O(1)。也可以在定时器自己的回调
+ *        中调用，使其再次触发，句柄保持不变
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] handle 定时器句柄
+ * @param [in] timeous 新的定时器时长，单位微秒us
+ * @return int 定时器已执行或已被取消时返回BLIVE_ERR_NOTEXSIT
+ */
+int select_engine_schedule_reschedule(select_engine_t* engine, select_timer_t handle, int64_t timeous);
+
+/**
+ * @brief 设置每轮循环最多执行的定时器回调数量。所有已到期的定时器会在同一轮中
+ *        依次执行，超出数量的留到下一轮，以保证fd就绪能够得到及时处理
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] budget 最多执行的数量，0表示不限制，默认为64
  * @return int 
  */
-int select_engine_schedule_add(select_engine_t* engine, select_schedule_cb callback, void* context, int64_t timeous);
+int select_engine_set_timer_budget(select_engine_t* engine, uint32_t budget);
+
+/**
+ * @brief 设置定时器的合并窗口。此后添加的定时器，到期时间会被向上对齐到slack的
+ *        整数倍，窗口内的定时器一起触发，以减少空闲时的唤醒次数。定时器可能因此
+ *        最多推迟slack，但不会提前
+ *
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] slack_us 合并窗口，单位微秒us，小于1毫秒时不合并，默认为0
+ * @return int
+ */
+int select_engine_set_timer_slack(select_engine_t* engine, int64_t slack_us);
+
+/**
+ * @brief 获取事件引擎的当前时间，基于单调时钟，不受系统时间调整的影响。在引擎线程
+ *        中返回本轮循环缓存的时间，定时器时长也从这个时间开始计算
+ *
+ * @param [in] engine select事件引擎描述结构体
+ * @return uint64_t 单调时间，单位纳秒ns
+ */
+uint64_t select_engine_now(select_engine_t* engine);
+
+/**
+ * @brief 开启或关闭运行统计，默认关闭。关闭时每个回调只多一次判断，开启时每个回调
+ *        多两次读取时钟。关闭后已有的统计保留，可以继续读取
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] enable 是否开启
+ * @return int 
+ */
+int select_engine_stats_enable(select_engine_t* engine, Bool enable);
+
+/**
+ * @brief 清空运行统计
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @return int 
+ */
+int select_engine_stats_reset(select_engine_t* engine);
+
+/**
+ * @brief 读取运行统计，任意线程均可调用
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [out] stats 传出参数，运行统计
+ * @return int 从未开启过统计时返回BLIVE_ERR_NOTEXSIT
+ */
+int select_engine_stats_get(select_engine_t* engine, select_engine_stats_t* stats);
+
+/**
+ * @brief 读取各个回调函数的执行耗时，按回调函数的地址区分，任意线程均可调用
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [out] stats 传出参数，回调的统计数组
+ * @param [in] max_num 数组的大小
+ * @param [out] num 传出参数，实际填入的数量
+ * @return int 从未开启过统计时返回BLIVE_ERR_NOTEXSIT
+ */
+int select_engine_stats_callbacks(select_engine_t* engine, select_callback_stats_t* stats, uint32_t max_num, uint32_t* num);
 
 /**
  * @brief 设置一个一次性的文件描述符监视，在该文件描述符可读一次之后，就删除
+ * @note 在引擎线程之外调用时，操作放入命令队列，由引擎线程在下一轮循环开始时按顺序执行，
+ *       执行失败只记录日志。以下fd相关的接口均是如此
  * 
  * @param [in] engine select事件引擎描述结构体
  * @param [in] fd 文件描述符
@@ -111,8 +301,32 @@ int select_engine_fd_add_once(select_engine_t* engine, fd_t fd, select_fd_cb cal
  */
 int select_engine_fd_add_forever(select_engine_t* engine, fd_t fd, select_fd_cb callback, void* context);
 
+/**
+ * @brief 设置一个永久性的文件描述符监视，可以同时监视可读、可写，重复设置时替换原先的监视
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] fd 文件描述符
+ * @param [in] events 监视的事件，SELECT_EVENT_READ/WRITE/EDGE的组合，ERROR总是会监视
+ * @param [in] callback 事件就绪时调用的回调函数
+ * @param [in] context 传递给回调函数的上下文
+ * @return int 
+ */
+int select_engine_fd_watch(select_engine_t* engine, fd_t fd, uint32_t events, select_io_cb callback, void* context);
+
+/**
+ * @brief 修改已经在监视的文件描述符的事件，回调和上下文保持不变。如非阻塞写时，
+ *        在发送缓冲区满时加上SELECT_EVENT_WRITE，写完后再去掉
+ * 
+ * @param [in] engine select事件引擎描述结构体
+ * @param [in] fd 文件描述符
+ * @param [in] events 新的监视事件
+ * @return int fd不在监视中时返回BLIVE_ERR_NOTEXSIT，在其他线程中调用时该错误只记录日志
+ */
+int select_engine_fd_modify(select_engine_t* engine, fd_t fd, uint32_t events);
+
 /**
  * @brief 将之前放入select事件引擎监视的文件描述符删除
+ * @note 在引擎线程之外调用时，删除生效之前回调仍可能被执行一次
  * 
  * @param [in] engine select事件引擎描述结构体
  * @param [in] fd 文件描述符
@@ -0,0 +1,256 @@
+/**
+ * @file select_group.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 事件引擎组，每个引擎独占一个线程。引擎之间不共享任何状态，跨引擎的操作
+ *        都通过select_engine_post投递到目标引擎的线程中执行
+ * @version 0.1
+ * @date 2023-03-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#endif
+#include <pthread.h>
+#include <unistd.h>
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include "select_group.h"
+
+
+typedef struct {
+    select_engine_t*    engine;
+    pthread_t           thread;
+    uint32_t            load;       /* 通过最小负载策略分配到该引擎的数量，原子操作 */
+    int32_t             cpu;        /* 绑定的CPU核心，-1表示不绑定 */
+    Bool                running;
+} group_loop_t;
+
+struct select_engine_group_t {
+    group_loop_t*       loops;
+    uint32_t            loop_num;
+};
+
+
+static uint32_t __group_cpu_num(void)
+{
+#ifdef WIN32
+    SYSTEM_INFO     info;
+
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    long            cpu_num = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cpu_num > 0 ? (uint32_t)cpu_num : 1;
+#endif
+}
+
+/**
+ * @brief 将key打散，避免连续的直播间ID、fd集中在少数引擎上
+ */
+static inline uint64_t __group_hash_mix(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static void* __group_loop_thread(void* arg)
+{
+    group_loop_t*   loop = (group_loop_t*)arg;
+
+#ifdef __linux__
+    if (loop->cpu >= 0) {
+        cpu_set_t   cpu_set;
+
+        CPU_ZERO(&cpu_set);
+        CPU_SET(loop->cpu, &cpu_set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set)) {
+            blive_loge("bind engine thread to cpu %d failed", loop->cpu);
+        }
+    }
+#endif
+
+    select_engine_perform(loop->engine);
+    blive_logi("engine group loop end");
+    return NULL;
+}
+
+
+blive_errno_t select_engine_group_create(select_engine_group_t** group, uint32_t loop_num, select_backend_t backend)
+{
+    blive_errno_t           retval = BLIVE_ERR_OK;
+    select_engine_group_t*  new_group = NULL;
+
+    if (group == NULL) {
+        retval = BLIVE_ERR_INVALID;
+        goto _out;
+    }
+
+    new_group = zero_alloc(sizeof(select_engine_group_t));
+    if (new_group == NULL) {
+        retval = BLIVE_ERR_OUTOFMEM;
+        goto _out;
+    }
+
+    new_group->loop_num = loop_num ? loop_num : __group_cpu_num();
+    new_group->loops = zero_alloc(new_group->loop_num * sizeof(group_loop_t));
+    if (new_group->loops == NULL) {
+        retval = BLIVE_ERR_OUTOFMEM;
+        goto _destroy;
+    }
+
+    for (uint32_t i = 0; i < new_group->loop_num; i++) {
+        retval = select_engine_create_with_backend(&new_group->loops[i].engine, backend);
+        if (retval != BLIVE_ERR_OK) {
+            goto _destroy;
+        }
+        new_group->loops[i].cpu = -1;
+    }
+
+    *group = new_group;
+_out:
+    return retval;
+
+_destroy:
+    select_engine_group_destroy(new_group);
+    goto _out;
+}
+
+blive_errno_t select_engine_group_start(select_engine_group_t* group, Bool pin_cpu)
+{
+    uint32_t        cpu_num = __group_cpu_num();
+    group_loop_t*   loop = NULL;
+
+    if (group == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    for (uint32_t i = 0; i < group->loop_num; i++) {
+        loop = &group->loops[i];
+        if (loop->running) {
+            continue;
+        }
+        loop->cpu = pin_cpu ? (int32_t)(i % cpu_num) : -1;
+        if (pthread_create(&loop->thread, NULL, __group_loop_thread, loop)) {
+            blive_loge("create engine thread %u failed", i);
+            select_engine_group_stop(group);
+            return BLIVE_ERR_RESOURCE;
+        }
+        loop->running = True;
+    }
+
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t select_engine_group_stop(select_engine_group_t* group)
+{
+    if (group == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    /* 先通知所有的引擎停止，再逐个等待，使它们并行地退出 */
+    for (uint32_t i = 0; i < group->loop_num; i++) {
+        if (group->loops[i].running) {
+            select_engine_stop(group->loops[i].engine);
+        }
+    }
+    for (uint32_t i = 0; i < group->loop_num; i++) {
+        if (group->loops[i].running) {
+            pthread_join(group->loops[i].thread, NULL);
+            group->loops[i].running = False;
+        }
+    }
+
+    return BLIVE_ERR_OK;
+}
+
+blive_errno_t select_engine_group_destroy(select_engine_group_t* group)
+{
+    if (group == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    if (group->loops != NULL) {
+        for (uint32_t i = 0; i < group->loop_num; i++) {
+            if (group->loops[i].running) {
+                return BLIVE_ERR_INVALID;
+            }
+        }
+        for (uint32_t i = 0; i < group->loop_num; i++) {
+            if (group->loops[i].engine != NULL) {
+                select_engine_destroy(group->loops[i].engine);
+            }
+        }
+        free(group->loops);
+    }
+    free(group);
+
+    return BLIVE_ERR_OK;
+}
+
+uint32_t select_engine_group_size(const select_engine_group_t* group)
+{
+    return group != NULL ? group->loop_num : 0;
+}
+
+select_engine_t* select_engine_group_get(const select_engine_group_t* group, uint32_t index)
+{
+    if (group == NULL || index >= group->loop_num) {
+        return NULL;
+    }
+    return group->loops[index].engine;
+}
+
+select_engine_t* select_engine_group_pick(select_engine_group_t* group, select_group_policy_t policy, uint64_t key)
+{
+    group_loop_t*   best = NULL;
+    uint32_t        best_load = UINT32_MAX;
+    uint32_t        load = 0;
+
+    if (group == NULL) {
+        return NULL;
+    }
+
+    if (policy == SELECT_GROUP_HASH) {
+        return group->loops[__group_hash_mix(key) % group->loop_num].engine;
+    }
+
+    /* 负载只是近似值，并发选择时可能选到同一个引擎，不影响正确性 */
+    for (uint32_t i = 0; i < group->loop_num; i++) {
+        load = __atomic_load_n(&group->loops[i].load, __ATOMIC_RELAXED);
+        if (load < best_load) {
+            best_load = load;
+            best = &group->loops[i];
+        }
+    }
+    __atomic_add_fetch(&best->load, 1, __ATOMIC_RELAXED);
+
+    return best->engine;
+}
+
+blive_errno_t select_engine_group_release(select_engine_group_t* group, select_engine_t* engine)
+{
+    if (group == NULL || engine == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    for (uint32_t i = 0; i < group->loop_num; i++) {
+        if (group->loops[i].engine == engine) {
+            __atomic_sub_fetch(&group->loops[i].load, 1, __ATOMIC_RELAXED);
+            return BLIVE_ERR_OK;
+        }
+    }
+
+    return BLIVE_ERR_NOTEXSIT;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file select_group.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 事件引擎组。每个事件引擎运行在单独的线程中，可以绑定到不同的CPU核心，
+ *        直播间、HTTP连接等按照哈希或最小负载分配到其中一个引擎上，使CPU的
+ *        使用随核心数扩展，而不需要为每个socket创建一个线程
+ * @version 0.1
+ * @date 2023-03-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_SELECT_GROUP_H__
+#define __UTILS_SELECT_GROUP_H__
+
+#include "select.h"
+
+
+typedef struct select_engine_group_t select_engine_group_t;
+
+/**
+ * @brief 从引擎组中选择引擎的策略
+ *
+ */
+typedef enum {
+    SELECT_GROUP_HASH = 0,      /* 按照key哈希，相同的key总是分配到同一个引擎 */
+    SELECT_GROUP_LEAST_LOAD,    /* 分配到当前负载最小的引擎，使用结束后需要释放 */
+} select_group_policy_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 创建事件引擎组，此时引擎尚未运行
+ *
+ * @param [out] group 传出参数，事件引擎组
+ * @param [in] loop_num 引擎的数量，0表示与在线的CPU核心数相同
+ * @param [in] backend 所有引擎使用的IO多路复用后端
+ * @return int
+ */
+int select_engine_group_create(select_engine_group_t** group, uint32_t loop_num, select_backend_t backend);
+
+/**
+ * @brief 为每个引擎创建一个线程并开始运行
+ *
+ * @param [in] group 事件引擎组
+ * @param [in] pin_cpu 是否将第i个引擎的线程绑定到第i个CPU核心，仅Linux有效
+ * @return int
+ */
+int select_engine_group_start(select_engine_group_t* group, Bool pin_cpu);
+
+/**
+ * @brief 停止所有的引擎，并等待其线程退出
+ *
+ * @param [in] group 事件引擎组
+ * @return int
+ */
+int select_engine_group_stop(select_engine_group_t* group);
+
+/**
+ * @brief 销毁事件引擎组，需要先停止
+ *
+ * @param [in] group 事件引擎组
+ * @return int
+ */
+int select_engine_group_destroy(select_engine_group_t* group);
+
+/**
+ * @brief 获取引擎组中引擎的数量
+ *
+ * @param [in] group 事件引擎组
+ * @return uint32_t
+ */
+uint32_t select_engine_group_size(const select_engine_group_t* group);
+
+/**
+ * @brief 获取引擎组中的第index个引擎
+ *
+ * @param [in] group 事件引擎组
+ * @param [in] index 序号
+ * @return select_engine_t* 序号越界时返回NULL
+ */
+select_engine_t* select_engine_group_get(const select_engine_group_t* group, uint32_t index);
+
+/**
+ * @brief 按照策略从引擎组中选择一个引擎，线程安全
+ *
+ * @param [in] group 事件引擎组
+ * @param [in] policy 选择的策略
+ * @param [in] key 哈希策略使用的key，如直播间ID、连接的fd，最小负载策略不使用
+ * @return select_engine_t*
+ */
+select_engine_t* select_engine_group_pick(select_engine_group_t* group, select_group_policy_t policy, uint64_t key);
+
+/**
+ * @brief 释放通过最小负载策略选择的引擎，使其负载减一
+ *
+ * @param [in] group 事件引擎组
+ * @param [in] engine 选择到的引擎
+ * @return int 引擎不属于该组时返回BLIVE_ERR_NOTEXSIT
+ */
+int select_engine_group_release(select_engine_group_t* group, select_engine_t* engine);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
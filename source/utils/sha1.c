@@ -0,0 +1,172 @@
+/**
+ * @file sha1.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief SHA-1摘要与base64编码的实现，按字节处理，与主机的字节序无关
+ * @version 0.1
+ * @date 2023-03-25
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "sha1.h"
+
+
+#define SHA1_ROL(value, bits)   (((value) << (bits)) | ((value) >> (32 - (bits))))
+
+
+/**
+ * @brief 处理一个64字节的分组
+ *
+ * @param [in] state 摘要的中间状态
+ * @param [in] block 分组
+ */
+static void __sha1_transform(uint32_t state[5], const uint8_t block[SHA1_BLOCK_SIZE])
+{
+    uint32_t    w[80];
+    uint32_t    a = state[0];
+    uint32_t    b = state[1];
+    uint32_t    c = state[2];
+    uint32_t    d = state[3];
+    uint32_t    e = state[4];
+    uint32_t    f = 0;
+    uint32_t    k = 0;
+    uint32_t    temp = 0;
+
+    /*分组按大端序分为16个字，再扩展为80个字*/
+    for (int index = 0; index < 16; index++) {
+        w[index] = ((uint32_t)block[index * 4] << 24) | ((uint32_t)block[index * 4 + 1] << 16) |
+                   ((uint32_t)block[index * 4 + 2] << 8) | (uint32_t)block[index * 4 + 3];
+    }
+    for (int index = 16; index < 80; index++) {
+        w[index] = SHA1_ROL(w[index - 3] ^ w[index - 8] ^ w[index - 14] ^ w[index - 16], 1);
+    }
+
+    for (int index = 0; index < 80; index++) {
+        if (index < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (index < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (index < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        temp = SHA1_ROL(a, 5) + f + e + k + w[index];
+        e = d;
+        d = c;
+        c = SHA1_ROL(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void sha1_init(sha1_ctx_t* ctx)
+{
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xEFCDAB89;
+    ctx->state[2] = 0x98BADCFE;
+    ctx->state[3] = 0x10325476;
+    ctx->state[4] = 0xC3D2E1F0;
+    ctx->total = 0;
+}
+
+void sha1_update(sha1_ctx_t* ctx, const void* data, size_t len)
+{
+    const uint8_t*  input = (const uint8_t*)data;
+    uint32_t        used = ctx->total % SHA1_BLOCK_SIZE;
+    uint32_t        fill = 0;
+
+    ctx->total += len;
+
+    /*先补齐上一次剩下的分组*/
+    if (used) {
+        fill = min((size_t)(SHA1_BLOCK_SIZE - used), len);
+        memcpy(ctx->block + used, input, fill);
+        input += fill;
+        len -= fill;
+        if (used + fill < SHA1_BLOCK_SIZE) {
+            return ;
+        }
+        __sha1_transform(ctx->state, ctx->block);
+    }
+    while (len >= SHA1_BLOCK_SIZE) {
+        __sha1_transform(ctx->state, input);
+        input += SHA1_BLOCK_SIZE;
+        len -= SHA1_BLOCK_SIZE;
+    }
+    if (len) {
+        memcpy(ctx->block, input, len);
+    }
+}
+
+void sha1_final(sha1_ctx_t* ctx, uint8_t digest[SHA1_DIGEST_SIZE])
+{
+    uint64_t    bits = ctx->total * 8;
+    uint32_t    used = ctx->total % SHA1_BLOCK_SIZE;
+
+    /*填充一个0x80，再填充0直到分组剩下8字节，最后是大端序的总位数*/
+    ctx->block[used++] = 0x80;
+    if (used > SHA1_BLOCK_SIZE - 8) {
+        memset(ctx->block + used, 0, SHA1_BLOCK_SIZE - used);
+        __sha1_transform(ctx->state, ctx->block);
+        used = 0;
+    }
+    memset(ctx->block + used, 0, SHA1_BLOCK_SIZE - 8 - used);
+    for (int index = 0; index < 8; index++) {
+        ctx->block[SHA1_BLOCK_SIZE - 1 - index] = (uint8_t)(bits >> (index * 8));
+    }
+    __sha1_transform(ctx->state, ctx->block);
+
+    for (int index = 0; index < SHA1_DIGEST_SIZE; index++) {
+        digest[index] = (uint8_t)(ctx->state[index / 4] >> (24 - (index % 4) * 8));
+    }
+}
+
+void sha1_digest(const void* data, size_t len, uint8_t digest[SHA1_DIGEST_SIZE])
+{
+    sha1_ctx_t  ctx;
+
+    sha1_init(&ctx);
+    sha1_update(&ctx, data, len);
+    sha1_final(&ctx, digest);
+}
+
+size_t base64_encode(const void* data, size_t len, char* dst)
+{
+    static const char   table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const uint8_t*      input = (const uint8_t*)data;
+    char*               output = dst;
+    uint32_t            group = 0;
+
+    /*每3个字节编码为4个字符，不足3个字节时以'='补齐*/
+    for (; len >= 3; len -= 3, input += 3) {
+        group = ((uint32_t)input[0] << 16) | ((uint32_t)input[1] << 8) | input[2];
+        *output++ = table[(group >> 18) & 0x3F];
+        *output++ = table[(group >> 12) & 0x3F];
+        *output++ = table[(group >> 6) & 0x3F];
+        *output++ = table[group & 0x3F];
+    }
+    if (len) {
+        group = (uint32_t)input[0] << 16;
+        if (len == 2) {
+            group |= (uint32_t)input[1] << 8;
+        }
+        *output++ = table[(group >> 18) & 0x3F];
+        *output++ = table[(group >> 12) & 0x3F];
+        *output++ = len == 2 ? table[(group >> 6) & 0x3F] : '=';
+        *output++ = '=';
+    }
+    *output = '\0';
+
+    return output - dst;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file sha1.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief SHA-1摘要(RFC 3174)与base64编码(RFC 4648)，用于WebSocket的握手
+ * @attention SHA-1已不再适合用于安全相关的场景，这里只用来计算Sec-WebSocket-Accept
+ * @version 0.1
+ * @date 2023-03-25
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_SHA1_H__
+#define __UTILS_SHA1_H__
+
+#include <stdint.h>
+#include "utils.h"
+
+
+#define SHA1_DIGEST_SIZE        20
+#define SHA1_BLOCK_SIZE         64
+#define BASE64_ENCODED_SIZE(n)  ((((n) + 2) / 3) * 4 + 1)   /* 编码n字节所需的长度，含结尾的'\0' */
+
+typedef struct {
+    uint32_t    state[5];
+    uint64_t    total;                      /* 已输入的总字节数 */
+    uint8_t     block[SHA1_BLOCK_SIZE];     /* 尚未凑满一个分组的输入 */
+} sha1_ctx_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 初始化摘要的计算
+ *
+ * @param [in] ctx 摘要上下文
+ */
+void sha1_init(sha1_ctx_t* ctx);
+
+/**
+ * @brief 输入数据，可以多次调用
+ *
+ * @param [in] ctx 摘要上下文
+ * @param [in] data 数据
+ * @param [in] len 数据的长度
+ */
+void sha1_update(sha1_ctx_t* ctx, const void* data, size_t len);
+
+/**
+ * @brief 结束计算，输出摘要，之后需要重新初始化才能再次使用
+ *
+ * @param [in] ctx 摘要上下文
+ * @param [out] digest 传出参数，20字节的摘要
+ */
+void sha1_final(sha1_ctx_t* ctx, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+/**
+ * @brief 计算一段数据的摘要
+ *
+ * @param [in] data 数据
+ * @param [in] len 数据的长度
+ * @param [out] digest 传出参数，20字节的摘要
+ */
+void sha1_digest(const void* data, size_t len, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+/**
+ * @brief base64编码，结果以'\0'结尾
+ *
+ * @param [in] data 数据
+ * @param [in] len 数据的长度
+ * @param [out] dst 传出参数，长度至少为BASE64_ENCODED_SIZE(len)
+ * @return size_t 编码结果的长度，不含结尾的'\0'
+ */
+size_t base64_encode(const void* data, size_t len, char* dst);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,271 @@
+/**
+ * @file timer_wheel.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 分层时间轮。第0层的每个槽对应一个刻度，第n层的每个槽对应第n-1层
+ *        转一圈的时长。定时器按照距离到期的时长放入对应的层，当低层转完一圈
+ *        时，将高层对应槽中的定时器级联下放到低层。
+ * @version 0.1
+ * @date 2023-03-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include "timer_wheel.h"
+
+
+#define SLOT_MASK           (TIMER_WHEEL_SLOTS - 1)
+#define LEVEL_SHIFT(level)  ((level) * TIMER_WHEEL_SLOT_BITS)
+
+
+/**
+ * @brief 在位图中从start开始循环查找第一个置位的位置
+ *
+ * @return int32_t 与start的距离，没有置位时返回-1
+ */
+static inline int32_t __bitmap_next(uint64_t bitmap, uint32_t start)
+{
+    uint64_t    rotated = 0;
+
+    if (!bitmap) {
+        return -1;
+    }
+    rotated = start ? ((bitmap >> start) | (bitmap << (TIMER_WHEEL_SLOTS - start))) : bitmap;
+    return __builtin_ctzll(rotated);
+}
+
+static inline void __slot_append(timer_wheel_t* wheel, uint32_t level, uint32_t index, timer_wheel_node_t* node)
+{
+    LIST_APPEND_AHEAD(&wheel->slots[level][index], &node->link);
+    wheel->bitmap[level] |= (1ULL << index);
+}
+
+/**
+ * @brief 根据到期时间将节点放入对应的层和槽
+ *
+ * @param [in] cascading 是否在级联过程中。级联时当前刻度的槽尚未取出，到期时间
+ *             等于当前刻度的节点仍可以放入第0层
+ */
+static void __wheel_place(timer_wheel_t* wheel, timer_wheel_node_t* node, Bool cascading)
+{
+    uint64_t    expire = node->expire;
+    uint64_t    delta = 0;
+    uint32_t    level = 0;
+
+    if (expire < wheel->cur || (expire == wheel->cur && !cascading)) {
+        LIST_APPEND_AHEAD(&wheel->due, &node->link);
+        return ;
+    }
+
+    delta = expire - wheel->cur;
+    if (delta >= TIMER_WHEEL_MAX_SPAN) {
+        /* 超出时间轮的范围，先放在最高层的最远处，级联时再重新计算 */
+        expire = wheel->cur + TIMER_WHEEL_MAX_SPAN - 1;
+        delta = TIMER_WHEEL_MAX_SPAN - 1;
+    }
+    while (delta >= ((uint64_t)1 << LEVEL_SHIFT(level + 1))) {
+        level++;
+    }
+
+    __slot_append(wheel, level, (expire >> LEVEL_SHIFT(level)) & SLOT_MASK, node);
+}
+
+/**
+ * @brief 将src链表中的全部节点整体拼接到out的尾部，src变为空链表
+ */
+static void __list_splice(list* src, list* out)
+{
+    if (src->next == src) {
+        return ;
+    }
+
+    src->next->prev = out->prev;
+    out->prev->next = src->next;
+    src->prev->next = out;
+    out->prev = src->prev;
+    LIST_NODE_INIT(src);
+}
+
+/**
+ * @brief 将某层某个槽中的全部节点摘出
+ *
+ * @param [out] out 已初始化的链表头
+ */
+static inline void __slot_take(timer_wheel_t* wheel, uint32_t level, uint32_t index, list* out)
+{
+    __list_splice(&wheel->slots[level][index], out);
+    wheel->bitmap[level] &= ~(1ULL << index);
+}
+
+/**
+ * @brief 当前刻度处于第0层一圈的起点，将高层对应槽中的节点下放
+ */
+static void __wheel_cascade(timer_wheel_t* wheel)
+{
+    list        cascade_list;
+    uint32_t    index = 0;
+
+    for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        index = (wheel->cur >> LEVEL_SHIFT(level)) & SLOT_MASK;
+
+        LIST_NODE_INIT(&cascade_list);
+        __slot_take(wheel, level, index, &cascade_list);
+        while (cascade_list.next != &cascade_list) {
+            list*   link = cascade_list.next;
+
+            LIST_SUBTRACT(link);
+            __wheel_place(wheel, list_entry(link, timer_wheel_node_t, link), True);
+        }
+
+        /* 只有本层也转完一圈时，才需要继续级联更高的一层 */
+        if (index) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief 获取当前刻度之后，第一个需要处理的槽的刻度
+ *
+ * @return uint64_t 刻度，没有非空的槽时返回UINT64_MAX
+ */
+static uint64_t __wheel_next(const timer_wheel_t* wheel)
+{
+    uint64_t    best = UINT64_MAX;
+    uint64_t    block = 0;
+    int32_t     distance = 0;
+
+    /* 第0层中的节点都在当前一圈内，槽的刻度就是准确的到期时间 */
+    distance = __bitmap_next(wheel->bitmap[0], (wheel->cur + 1) & SLOT_MASK);
+    if (distance >= 0) {
+        best = wheel->cur + 1 + distance;
+    }
+
+    /* 高层的节点以级联下放的刻度作为下界 */
+    for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        block = wheel->cur >> LEVEL_SHIFT(level);
+        distance = __bitmap_next(wheel->bitmap[level], (block + 1) & SLOT_MASK);
+        if (distance >= 0) {
+            best = min(best, (block + 1 + distance) << LEVEL_SHIFT(level));
+        }
+    }
+
+    return best;
+}
+
+
+void timer_wheel_init(timer_wheel_t* wheel, uint64_t now)
+{
+    memset(wheel, 0, sizeof(timer_wheel_t));
+    wheel->cur = now;
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (uint32_t index = 0; index < TIMER_WHEEL_SLOTS; index++) {
+            LIST_NODE_INIT(&wheel->slots[level][index]);
+        }
+    }
+    LIST_NODE_INIT(&wheel->due);
+}
+
+void timer_wheel_node_init(timer_wheel_node_t* node)
+{
+    LIST_NODE_INIT(&node->link);
+    node->expire = 0;
+    node->pending = False;
+}
+
+uint32_t timer_wheel_clear(timer_wheel_t* wheel, list* out)
+{
+    list*       first = out->prev;
+    uint32_t    count = wheel->count;
+
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (uint32_t index = 0; index < TIMER_WHEEL_SLOTS; index++) {
+            __slot_take(wheel, level, index, out);
+        }
+    }
+    __list_splice(&wheel->due, out);
+    for (list* link = first->next; link != out; link = link->next) {
+        list_entry(link, timer_wheel_node_t, link)->pending = False;
+    }
+    wheel->count = 0;
+
+    return count;
+}
+
+void timer_wheel_add(timer_wheel_t* wheel, timer_wheel_node_t* node, uint64_t expire)
+{
+    timer_wheel_del(wheel, node);
+
+    node->expire = expire;
+    node->pending = True;
+    __wheel_place(wheel, node, False);
+    wheel->count++;
+}
+
+void timer_wheel_del(timer_wheel_t* wheel, timer_wheel_node_t* node)
+{
+    list*   slot = NULL;
+
+    if (!node->pending) {
+        return ;
+    }
+
+    /* 如果节点是槽中的最后一个，需要清除位图中的标记 */
+    slot = node->link.next;
+    LIST_SUBTRACT(&node->link);
+    if (slot->next == slot && slot->prev == slot) {
+        for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+            if (slot >= wheel->slots[level] && slot < wheel->slots[level] + TIMER_WHEEL_SLOTS) {
+                wheel->bitmap[level] &= ~(1ULL << (slot - wheel->slots[level]));
+                break;
+            }
+        }
+    }
+    LIST_NODE_INIT(&node->link);
+    node->pending = False;
+    wheel->count--;
+}
+
+uint32_t timer_wheel_advance(timer_wheel_t* wheel, uint64_t now, list* expired)
+{
+    list*       first = expired->prev;
+    uint32_t    count = 0;
+    uint64_t    next = 0;
+
+    /* 加入时就已经到期的节点 */
+    __list_splice(&wheel->due, expired);
+
+    /* 直接跳到下一个非空的槽，空槽的级联什么也不做，可以跳过 */
+    while (wheel->cur < now) {
+        next = __wheel_next(wheel);
+        if (next > now) {
+            wheel->cur = now;
+            break;
+        }
+
+        wheel->cur = next;
+        if (!(wheel->cur & SLOT_MASK)) {
+            __wheel_cascade(wheel);
+        }
+        __slot_take(wheel, 0, wheel->cur & SLOT_MASK, expired);
+    }
+
+    /* 统计数量并标记为不在时间轮中 */
+    for (list* link = first->next; link != expired; link = link->next) {
+        list_entry(link, timer_wheel_node_t, link)->pending = False;
+        count++;
+    }
+    wheel->count -= count;
+
+    return count;
+}
+
+int64_t timer_wheel_next_expire(const timer_wheel_t* wheel)
+{
+    if (!wheel->count) {
+        return -1;
+    }
+    if (wheel->due.next != &wheel->due) {
+        return (int64_t)wheel->cur;
+    }
+    return (int64_t)__wheel_next(wheel);
+}
@@ -0,0 +1,114 @@
+/**
+ * @file timer_wheel.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 分层时间轮。定时器节点内嵌在调用者的结构体中，插入、删除均为O(1)，
+ *        到期时以槽为单位整体取出，不需要逐个比较。
+ * @attention 时间轮本身不加锁，也不读取时钟，时间由调用者传入，单位为一个
+ * 刻度（tick），事件引擎中一个刻度为1毫秒。
+ * @version 0.1
+ * @date 2023-03-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_TIMER_WHEEL_H__
+#define __UTILS_TIMER_WHEEL_H__
+
+#include "utils.h"
+
+
+#define TIMER_WHEEL_LEVELS      4       /* 层数 */
+#define TIMER_WHEEL_SLOT_BITS   6
+#define TIMER_WHEEL_SLOTS       (1 << TIMER_WHEEL_SLOT_BITS)    /* 每层的槽数 */
+
+/* 时间轮能直接表示的最大时长，超出的定时器先放在最高层，随级联逐步下放 */
+#define TIMER_WHEEL_MAX_SPAN    ((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS))
+
+
+/**
+ * @brief 定时器节点，内嵌到调用者的结构体中，通过container_of取回
+ *
+ */
+typedef struct {
+    list        link;       /* 所在槽的链表节点 */
+    uint64_t    expire;     /* 到期的刻度 */
+    Bool        pending;    /* 是否在时间轮中 */
+} timer_wheel_node_t;
+
+typedef struct {
+    uint64_t    cur;                                            /* 当前刻度 */
+    uint64_t    bitmap[TIMER_WHEEL_LEVELS];                     /* 各层非空槽的位图 */
+    list        slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];   /* 各层的槽 */
+    list        due;                                            /* 加入时就已经到期的定时器 */
+    uint32_t    count;                                          /* 时间轮中的定时器数量 */
+} timer_wheel_t;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 初始化时间轮
+ *
+ * @param [in] wheel 时间轮
+ * @param [in] now 当前刻度
+ */
+void timer_wheel_init(timer_wheel_t* wheel, uint64_t now);
+
+/**
+ * @brief 初始化定时器节点
+ *
+ * @param [in] node 定时器节点
+ */
+void timer_wheel_node_init(timer_wheel_node_t* node);
+
+/**
+ * @brief 清空时间轮，将其中所有的定时器移入out链表，通常在销毁前使用
+ *
+ * @param [in] wheel 时间轮
+ * @param [out] out 已初始化的链表头，节点通过link挂在其尾部
+ * @return uint32_t 移出的定时器数量
+ */
+uint32_t timer_wheel_clear(timer_wheel_t* wheel, list* out);
+
+/**
+ * @brief 向时间轮中加入定时器，如果节点已经在时间轮中，则重新设置到期时间
+ *
+ * @param [in] wheel 时间轮
+ * @param [in] node 定时器节点
+ * @param [in] expire 到期的刻度，不大于当前刻度时在下一次推进时立即到期
+ */
+void timer_wheel_add(timer_wheel_t* wheel, timer_wheel_node_t* node, uint64_t expire);
+
+/**
+ * @brief 从时间轮中删除定时器，节点不在时间轮中时什么也不做
+ *
+ * @param [in] wheel 时间轮
+ * @param [in] node 定时器节点
+ */
+void timer_wheel_del(timer_wheel_t* wheel, timer_wheel_node_t* node);
+
+/**
+ * @brief 将时间轮推进到指定刻度，并将所有到期的定时器移入expired链表
+ *
+ * @param [in] wheel 时间轮
+ * @param [in] now 当前刻度
+ * @param [out] expired 已初始化的链表头，到期的节点通过link挂在其尾部
+ * @return uint32_t 到期的定时器数量
+ */
+uint32_t timer_wheel_advance(timer_wheel_t* wheel, uint64_t now, list* expired);
+
+/**
+ * @brief 获取下一次需要推进时间轮的刻度。该刻度不晚于最早的定时器的到期时间，
+ *        但可能是高层的槽需要级联下放的时间
+ *
+ * @param [in] wheel 时间轮
+ * @return int64_t 刻度，时间轮为空时返回-1
+ */
+int64_t timer_wheel_next_expire(const timer_wheel_t* wheel);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,362 @@
+/**
+ * @file uid_map.c
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief uid并发哈希表。bucket中的链表只通过原子的指针写入修改，读者沿着链表读取时
+ *        总能看到一个完整的链表。替换值时插入新的节点代替旧节点，旧节点连同旧值交给
+ *        epoch回收；扩容时复制全部节点到新的bucket数组再整体发布，旧的数组和节点同样
+ *        延迟回收，正在读取旧数组的读者不受影响。
+ * @version 0.1
+ * @date 2023-03-26
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#include <pthread.h>
+#include "uid_map.h"
+#include "epoch.h"
+
+
+#define UID_MAP_STRIPES         64      /* 写锁的分段数，必须是2的幂，同时是bucket数量的下限 */
+#define UID_MAP_LOAD            2       /* 平均每个bucket的元素超过该值时扩容 */
+
+typedef struct uid_node {
+    epoch_entry_t       entry;
+    struct uid_node*    next;           /* 原子操作 */
+    uint32_t            uid;
+    Bool                own_value;      /* 回收时是否同时释放值，扩容时复制出的节点共用值 */
+    void*               value;
+    uid_map_t*          map;
+} uid_node_t;
+
+typedef struct {
+    epoch_entry_t       entry;
+    uint32_t            mask;           /* bucket数量-1 */
+    uid_node_t*         buckets[0];     /* 原子操作 */
+} uid_table_t;
+
+struct uid_map {
+    uid_table_t*        table;          /* 原子操作，扩容时整体替换 */
+    pthread_mutex_t     stripes[UID_MAP_STRIPES];
+    uint32_t            count;          /* 原子操作 */
+    uid_map_free_func   free_cb;
+    epoch_domain_t*     domain;
+};
+
+
+static inline uint32_t __uid_hash(uint32_t uid);
+static uid_table_t* __uid_table_alloc(uint32_t bucket_num);
+static void __uid_node_free(epoch_entry_t* entry);
+static void __uid_table_free(epoch_entry_t* entry);
+static void __uid_map_expand(uid_map_t* map);
+
+
+int uid_map_create(uid_map_t** map, uint32_t size, uid_map_free_func free_cb)
+{
+    blive_errno_t   retval = BLIVE_ERR_OK;
+    uid_map_t*      new_map = NULL;
+    uint32_t        bucket_num = UID_MAP_STRIPES;
+
+    if (map == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    new_map = zero_alloc(sizeof(uid_map_t));
+    if (new_map == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+
+    while (bucket_num * UID_MAP_LOAD < size && bucket_num < (1U << 30)) {
+        bucket_num <<= 1;
+    }
+    new_map->table = __uid_table_alloc(bucket_num);
+    if (new_map->table == NULL) {
+        retval = BLIVE_ERR_OUTOFMEM;
+        goto _free;
+    }
+    retval = epoch_domain_create(&new_map->domain);
+    if (retval != BLIVE_ERR_OK) {
+        goto _free;
+    }
+    for (uint32_t i = 0; i < UID_MAP_STRIPES; i++) {
+        pthread_mutex_init(&new_map->stripes[i], NULL);
+    }
+    new_map->free_cb = free_cb;
+    *map = new_map;
+
+_out:
+    return retval;
+
+_free:
+    free(new_map->table);
+    free(new_map);
+    goto _out;
+}
+
+int uid_map_destroy(uid_map_t* map)
+{
+    uid_node_t*     node = NULL;
+    uid_node_t*     next = NULL;
+
+    if (map == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    /* 先释放延迟回收的节点，回调中会用到map */
+    epoch_domain_destroy(map->domain);
+    for (uint32_t i = 0; i <= map->table->mask; i++) {
+        for (node = map->table->buckets[i]; node != NULL; node = next) {
+            next = node->next;
+            __uid_node_free(&node->entry);
+        }
+    }
+    for (uint32_t i = 0; i < UID_MAP_STRIPES; i++) {
+        pthread_mutex_destroy(&map->stripes[i]);
+    }
+    free(map->table);
+    free(map);
+
+    return BLIVE_ERR_OK;
+}
+
+void uid_map_read_begin(uid_map_t* map)
+{
+    epoch_enter(map->domain);
+}
+
+void uid_map_read_end(uid_map_t* map)
+{
+    epoch_exit(map->domain);
+}
+
+void* uid_map_peek(uid_map_t* map, uint32_t uid)
+{
+    uid_table_t*    table = NULL;
+    uid_node_t*     node = NULL;
+
+    if (map == NULL) {
+        return NULL;
+    }
+
+    table = __atomic_load_n(&map->table, __ATOMIC_ACQUIRE);
+    node = __atomic_load_n(&table->buckets[__uid_hash(uid) & table->mask], __ATOMIC_ACQUIRE);
+    for (; node != NULL; node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) {
+        if (node->uid == uid) {
+            return node->value;
+        }
+    }
+
+    return NULL;
+}
+
+int uid_map_push(uid_map_t* map, uint32_t uid, void* value)
+{
+    uint32_t        hash = __uid_hash(uid);
+    pthread_mutex_t* stripe = NULL;
+    uid_table_t*    table = NULL;
+    uid_node_t**    link = NULL;
+    uid_node_t*     node = NULL;
+    uid_node_t*     old_node = NULL;
+    Bool            expand = False;
+
+    if (map == NULL || value == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    node = zero_alloc(sizeof(uid_node_t));
+    if (node == NULL) {
+        return BLIVE_ERR_OUTOFMEM;
+    }
+    node->uid = uid;
+    node->value = value;
+    node->own_value = True;
+    node->map = map;
+
+    /* 段由哈希值的低位决定，bucket数量不小于段数，扩容前后同一个uid总是属于同一段 */
+    stripe = &map->stripes[hash & (UID_MAP_STRIPES - 1)];
+    pthread_mutex_lock(stripe);
+    table = map->table;
+    link = &table->buckets[hash & table->mask];
+    for (old_node = *link; old_node != NULL; link = &old_node->next, old_node = *link) {
+        if (old_node->uid == uid) {
+            break;
+        }
+    }
+
+    if (old_node != NULL) {
+        /* 新节点代替旧节点，读者要么看到旧值，要么看到新值 */
+        node->next = old_node->next;
+        __atomic_store_n(link, node, __ATOMIC_RELEASE);
+    } else {
+        node->next = table->buckets[hash & table->mask];
+        __atomic_store_n(&table->buckets[hash & table->mask], node, __ATOMIC_RELEASE);
+        expand = (__atomic_add_fetch(&map->count, 1, __ATOMIC_RELAXED) > (table->mask + 1) * UID_MAP_LOAD);
+    }
+    pthread_mutex_unlock(stripe);
+
+    if (old_node != NULL) {
+        epoch_retire(map->domain, &old_node->entry, __uid_node_free);
+    }
+    if (expand) {
+        __uid_map_expand(map);
+    }
+
+    return BLIVE_ERR_OK;
+}
+
+int uid_map_pop(uid_map_t* map, uint32_t uid)
+{
+    uint32_t        hash = __uid_hash(uid);
+    pthread_mutex_t* stripe = NULL;
+    uid_table_t*    table = NULL;
+    uid_node_t**    link = NULL;
+    uid_node_t*     node = NULL;
+
+    if (map == NULL) {
+        return BLIVE_ERR_NULLPTR;
+    }
+
+    stripe = &map->stripes[hash & (UID_MAP_STRIPES - 1)];
+    pthread_mutex_lock(stripe);
+    table = map->table;
+    link = &table->buckets[hash & table->mask];
+    for (node = *link; node != NULL; link = &node->next, node = *link) {
+        if (node->uid == uid) {
+            /* 摘除后节点的next保持不变，正在读取它的读者仍然可以继续向后遍历 */
+            __atomic_store_n(link, node->next, __ATOMIC_RELEASE);
+            __atomic_sub_fetch(&map->count, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    pthread_mutex_unlock(stripe);
+
+    if (node == NULL) {
+        return BLIVE_ERR_NOTEXSIT;
+    }
+    epoch_retire(map->domain, &node->entry, __uid_node_free);
+
+    return BLIVE_ERR_OK;
+}
+
+uint32_t uid_map_count(const uid_map_t* map)
+{
+    if (map == NULL) {
+        return 0;
+    }
+
+    return __atomic_load_n(&map->count, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * @brief uid的混合函数，连续的uid也能均匀分布到各个bucket和段
+ */
+static inline uint32_t __uid_hash(uint32_t uid)
+{
+    uid ^= uid >> 16;
+    uid *= 0x85ebca6bU;
+    uid ^= uid >> 13;
+    uid *= 0xc2b2ae35U;
+    uid ^= uid >> 16;
+    return uid;
+}
+
+static uid_table_t* __uid_table_alloc(uint32_t bucket_num)
+{
+    uid_table_t*    table = NULL;
+
+    table = zero_alloc(sizeof(uid_table_t) + sizeof(uid_node_t*) * bucket_num);
+    if (table != NULL) {
+        table->mask = bucket_num - 1;
+    }
+
+    return table;
+}
+
+static void __uid_node_free(epoch_entry_t* entry)
+{
+    uid_node_t*     node = list_entry(entry, uid_node_t, entry);
+
+    if (node->own_value && node->map->free_cb != NULL) {
+        node->map->free_cb(node->value);
+    }
+    free(node);
+}
+
+static void __uid_table_free(epoch_entry_t* entry)
+{
+    free(list_entry(entry, uid_table_t, entry));
+}
+
+/**
+ * @brief 扩容为原来的2倍。持有全部段锁，复制全部节点后整体发布新的bucket数组，
+ *        读者在此期间继续读取旧的数组
+ *
+ * @param [in] map 哈希表
+ */
+static void __uid_map_expand(uid_map_t* map)
+{
+    uid_table_t*    old_table = NULL;
+    uid_table_t*    new_table = NULL;
+    uid_node_t*     node = NULL;
+    uid_node_t*     next = NULL;
+    uid_node_t*     copy = NULL;
+    uint32_t        index = 0;
+
+    for (uint32_t i = 0; i < UID_MAP_STRIPES; i++) {
+        pthread_mutex_lock(&map->stripes[i]);
+    }
+
+    old_table = map->table;
+    if (__atomic_load_n(&map->count, __ATOMIC_RELAXED) <= (old_table->mask + 1) * UID_MAP_LOAD || old_table->mask >= (1U << 30) - 1) {
+        goto _unlock;       /* 其他线程已经完成了扩容 */
+    }
+
+    new_table = __uid_table_alloc((old_table->mask + 1) * 2);
+    if (new_table == NULL) {
+        goto _unlock;       /* 扩容失败只影响性能 */
+    }
+    for (uint32_t i = 0; i <= old_table->mask; i++) {
+        for (node = old_table->buckets[i]; node != NULL; node = node->next) {
+            copy = malloc(sizeof(uid_node_t));
+            if (copy == NULL) {
+                goto _abort;
+            }
+            memcpy(copy, node, sizeof(uid_node_t));
+            index = __uid_hash(node->uid) & new_table->mask;
+            copy->next = new_table->buckets[index];
+            new_table->buckets[index] = copy;
+        }
+    }
+    __atomic_store_n(&map->table, new_table, __ATOMIC_RELEASE);
+    for (uint32_t i = UID_MAP_STRIPES; i > 0; i--) {
+        pthread_mutex_unlock(&map->stripes[i - 1]);
+    }
+
+    /* 发布之后写者只会修改新的数组，旧的数组可以在锁外回收。值已经转移给复制出的
+       节点，旧节点只释放自身 */
+    for (uint32_t i = 0; i <= old_table->mask; i++) {
+        for (node = old_table->buckets[i]; node != NULL; node = next) {
+            next = node->next;
+            node->own_value = False;
+            epoch_retire(map->domain, &node->entry, __uid_node_free);
+        }
+    }
+    epoch_retire(map->domain, &old_table->entry, __uid_table_free);
+    return ;
+
+_unlock:
+    for (uint32_t i = UID_MAP_STRIPES; i > 0; i--) {
+        pthread_mutex_unlock(&map->stripes[i - 1]);
+    }
+    return ;
+
+_abort:
+    for (uint32_t i = 0; i <= new_table->mask; i++) {
+        for (node = new_table->buckets[i]; node != NULL; node = next) {
+            next = node->next;
+            free(node);
+        }
+    }
+    free(new_table);
+    goto _unlock;
+}
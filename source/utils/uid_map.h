@@ -0,0 +1,104 @@
+/**
+ * @file uid_map.h
+ * @author Zhong Qiaoning (691365572@qq.com)
+ * @brief 以uid为键的并发哈希表，用于在blive线程、引擎线程、HTTP线程之间共享每个
+ *        用户的状态。读者不加锁也不会被写者阻塞；写者按bucket分段加锁，不同段的
+ *        写入可以并行。被替换或删除的值在所有读者离开临界区之后才释放。
+ * @attention uid_map_peek返回的值只在uid_map_read_begin/uid_map_read_end之间有效，
+ * 并且只能读取。需要修改时应当构造新的值，通过uid_map_push整体替换。
+ * @version 0.1
+ * @date 2023-03-26
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+#ifndef __UTILS_UID_MAP_H__
+#define __UTILS_UID_MAP_H__
+
+#include "utils.h"
+
+
+typedef struct uid_map uid_map_t;
+
+/**
+ * @brief 释放值的回调函数，值被替换、删除或哈希表销毁时调用
+ */
+typedef void (*uid_map_free_func)(void* value);
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 创建并发哈希表
+ *
+ * @param [out] map 传出参数
+ * @param [in] size 预计保存的元素数量，为0时使用默认大小
+ * @param [in] free_cb 释放值的回调函数，为NULL时不释放
+ * @return int
+ */
+int uid_map_create(uid_map_t** map, uint32_t size, uid_map_free_func free_cb);
+
+/**
+ * @brief 销毁并发哈希表，调用者需要保证已经没有其他线程在使用
+ *
+ * @param [in] map 哈希表
+ * @return int
+ */
+int uid_map_destroy(uid_map_t* map);
+
+/**
+ * @brief 进入读临界区，不会阻塞，可以嵌套
+ *
+ * @param [in] map 哈希表
+ */
+void uid_map_read_begin(uid_map_t* map);
+
+/**
+ * @brief 离开读临界区，此后不能再访问临界区内取得的值
+ *
+ * @param [in] map 哈希表
+ */
+void uid_map_read_end(uid_map_t* map);
+
+/**
+ * @brief 获取uid对应的值，必须在读临界区内调用
+ *
+ * @param [in] map 哈希表
+ * @param [in] uid 用户uid
+ * @return void* uid对应的值，不存在时返回NULL
+ */
+void* uid_map_peek(uid_map_t* map, uint32_t uid);
+
+/**
+ * @brief 插入或替换uid对应的值，被替换的值延迟释放
+ *
+ * @param [in] map 哈希表
+ * @param [in] uid 用户uid
+ * @param [in] value 值，不能为NULL，此后由哈希表负责释放
+ * @return int
+ */
+int uid_map_push(uid_map_t* map, uint32_t uid, void* value);
+
+/**
+ * @brief 删除uid对应的值，被删除的值延迟释放
+ *
+ * @param [in] map 哈希表
+ * @param [in] uid 用户uid
+ * @return int uid不存在时返回BLIVE_ERR_NOTEXSIT
+ */
+int uid_map_pop(uid_map_t* map, uint32_t uid);
+
+/**
+ * @brief 获取哈希表中元素的数量，并发时只是一个近似值
+ *
+ * @param [in] map 哈希表
+ * @return uint32_t 元素的数量
+ */
+uint32_t uid_map_count(const uid_map_t* map);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -25,6 +25,15 @@
     _a > _b ? _a : _b;\
 })
 
+#ifdef min
+#undef min
+#endif
+#define min(a, b) ({ \
+    __typeof(a) _a = a;\
+    __typeof(b) _b = b;\
+    _a < _b ? _a : _b;\
+})
+
 #define WR_FD(pair_fd)              ((pair_fd)[1])
 #define RD_FD(pair_fd)              ((pair_fd)[0])
 #ifdef WIN32